@@ -14,4 +14,8 @@ glslc shaders/uipanel.vert -o shaders/uipanel.vert.spv
 glslc shaders/uipanel.frag -o shaders/uipanel.frag.spv
 
 glslc shaders/uilabel.vert -o shaders/uilabel.vert.spv
-glslc shaders/uilabel.frag -o shaders/uilabel.frag.spv
\ No newline at end of file
+glslc shaders/uilabel.frag -o shaders/uilabel.frag.spv
+
+glslc shaders/uilabelsdf.frag -o shaders/uilabelsdf.frag.spv
+
+glslc shaders/lightingbindless.frag -o shaders/lightingbindless.frag.spv
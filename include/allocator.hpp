@@ -0,0 +1,112 @@
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Slots handed out by the size-class pools go from 256 bytes to 4 MiB, in powers of two.
+ * Anything bigger than the largest class gets its own VkDeviceMemory. */
+#define ALLOCATOR_MIN_SLOT_SIZE_LOG2 8
+#define ALLOCATOR_MAX_SLOT_SIZE_LOG2 22
+#define ALLOCATOR_SIZE_CLASS_COUNT (ALLOCATOR_MAX_SLOT_SIZE_LOG2 - ALLOCATOR_MIN_SLOT_SIZE_LOG2 + 1)
+
+/* Every page is one vkAllocateMemory call, we try to fit this many slots in one. */
+#define ALLOCATOR_SLOTS_PER_PAGE 16
+#define ALLOCATOR_MIN_PAGE_SIZE (1ull << 20)
+#define ALLOCATOR_MAX_PAGE_SIZE (32ull << 20)
+
+struct MemoryPage;
+
+/* A range of device memory handed out by the MemoryAllocator, resources should be bound at (deviceMemory, offset). */
+struct MemoryAllocation {
+    VkDeviceMemory deviceMemory = nullptr;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    /* Only set if the memory type is host-visible, already points to the start of this allocation. */
+    void *mappedData = nullptr;
+
+    /* nullptr if this is a dedicated allocation. */
+    MemoryPage *page = nullptr;
+    Uint32 slot = 0;
+};
+
+struct MemoryAllocatorStatistics {
+    /* Bytes we got from the driver through vkAllocateMemory. */
+    VkDeviceSize bytesAllocated = 0;
+
+    /* Bytes that were actually requested by resources. */
+    VkDeviceSize bytesUsed = 0;
+
+    Uint32 deviceAllocationCount = 0;
+    Uint32 dedicatedAllocationCount = 0;
+    Uint32 allocationCount = 0;
+};
+
+/* Called by Defragment for every allocation it wants to move.
+ * The callee should copy the resource to newAllocation and rebind it, then return true. Returning false leaves the allocation where it is. */
+typedef std::function<bool(const MemoryAllocation &oldAllocation, const MemoryAllocation &newAllocation)> DefragmentationCallback;
+
+struct MemoryPage {
+    VkDeviceMemory deviceMemory = nullptr;
+    VkDeviceSize size = 0;
+    void *mappedData = nullptr;
+
+    Uint32 memoryTypeIndex;
+    bool isLinear;
+    Uint32 sizeClass;
+
+    VkDeviceSize slotSize;
+
+    /* Requested size of the allocation in every slot, 0 if the slot is free. */
+    std::vector<VkDeviceSize> slotUsage;
+    std::vector<Uint32> freeSlots;
+};
+
+/* Sub-allocates buffers and images out of big VkDeviceMemory pages instead of calling vkAllocateMemory for every single resource.
+ * Pages are split by memory type, by linear/optimal tiling (so we never have to care about bufferImageGranularity) and by size class.
+ * This class is thread-safe. */
+class MemoryAllocator {
+public:
+    MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+    ~MemoryAllocator();
+
+    /* isLinear should be true for buffers and linear images, false for optimal images. Throws std::runtime_error on failure. */
+    MemoryAllocation Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool isLinear);
+
+    /* Resets allocation once it's freed, freeing an empty allocation does nothing. */
+    void Free(MemoryAllocation &allocation);
+
+    /* Packs allocations from sparse pages into denser ones through callback (if there is one), then gives every empty page back to the driver. */
+    void Defragment(const DefragmentationCallback &callback = nullptr);
+
+    MemoryAllocatorStatistics GetStatistics();
+    void PrintStatistics();
+private:
+    typedef std::vector<std::unique_ptr<MemoryPage>> MemoryPool;
+
+    Uint32 FindMemoryType(Uint32 typeFilter, VkMemoryPropertyFlags properties);
+    MemoryPool &GetPool(Uint32 memoryTypeIndex, bool isLinear, Uint32 sizeClass);
+
+    /* Both of these expect m_Mutex to be held. */
+    MemoryPage *CreatePage(Uint32 memoryTypeIndex, bool isLinear, Uint32 sizeClass);
+    MemoryAllocation AllocateFromPage(MemoryPage *page, VkDeviceSize size);
+
+    VkDevice m_Device;
+    VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+    Uint32 m_MaxDeviceAllocationCount;
+
+    /* [memoryTypeIndex][isLinear][sizeClass] */
+    std::array<std::array<std::array<MemoryPool, ALLOCATOR_SIZE_CLASS_COUNT>, 2>, VK_MAX_MEMORY_TYPES> m_Pools;
+
+    MemoryAllocatorStatistics m_Statistics;
+
+    std::mutex m_Mutex;
+};
+
+#endif
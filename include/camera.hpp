@@ -10,6 +10,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <atomic>
 #include <vector>
 
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
@@ -101,7 +102,8 @@ private:
 
     Object *m_ObjectAttachment = nullptr;
 
-    static int HighestCameraID;
+    /* Scenes can be imported on a background thread, so cameras can be created on several threads at once. */
+    static std::atomic<int> HighestCameraID;
 };
 
 #endif
@@ -1,9 +1,14 @@
 #ifndef COMMON_HPP
 #define COMMON_HPP
 
+#include "allocator.hpp"
+#include "deletion.hpp"
 #include "error.hpp"
+#include "fontmanager.hpp"
+#include "glyphatlas.hpp"
 #include "model.hpp"
 #include "settings.hpp"
+#include "upload.hpp"
 
 #include <glm/ext/vector_float3.hpp>
 #include <mutex>
@@ -17,13 +22,13 @@ class Renderer;
 
 struct BufferAndMemory {
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    MemoryAllocation memory;
     void *mappedData = nullptr;
 };
 
 struct ImageAndMemory {
     VkImage image;
-    VkDeviceMemory memory;
+    MemoryAllocation memory;
 };
 
 struct TextureBufferAndMemory {
@@ -39,6 +44,7 @@ struct TextureImageAndMemory {
     Uint32 height;
     Uint8 channels;
     VkFormat format;
+    Uint32 mipLevels = 1;
 };
 
 struct EngineSharedContext {
@@ -50,22 +56,26 @@ struct EngineSharedContext {
     VkQueue graphicsQueue;
     Settings &settings;
 
+    MemoryAllocator *allocator;
+    UploadBatcher *uploadBatcher;
+    DeletionQueue *deletionQueue;
+    FontManager *fontManager;
+
     std::mutex &singleTimeCommandMutex;
 };
 
-struct GlyphUBO {
-    glm::vec2 Offset;
+/* One glyph of a label as uilabel.vert sees it, picked with gl_InstanceIndex. */
+struct GlyphInstance {
+    glm::vec4 Rect;     // offset.xy, scale.xy
+    glm::vec4 UVRect;   // where it is in its atlas page
 };
 
 struct Glyph {
     glm::vec2 offset;   // offset from the start of the string, from -1.0f to 1.0f
     glm::vec2 scale;
     char character;
-    std::string fontIdentifier;   // Identifies the font by family name, style name, and height.
-    std::optional<std::pair<TextureImageAndMemory, BufferAndMemory>> glyphBuffer;  // If it's a space or a newline, there won't be any glyph.
-
-    GlyphUBO glyphUBO;
-    BufferAndMemory glyphUBOBuffer;
+    Uint32 fontFaceID;   // From FontManager::GetFaceID, same family, style and height means same ID.
+    std::optional<GlyphAtlasRegion> atlasRegion;  // If it's a space or a newline, there won't be any glyph.
 };
 
 
@@ -110,7 +120,23 @@ namespace UI {
         virtual std::vector<GenericElement *> GetChildren();
 
         virtual void DestroyBuffers();
+
+        /* Throws away the cached layout of this element, everything under it and everything above it (FIT_CHILDREN looks down the tree).
+         * The setters call this themselves, only call it after changing something they don't cover, like fitType. */
+        void MarkLayoutDirty();
+
+        /* Goes up every time any element's layout is marked dirty, if it didn't move there's nothing to lay out again. */
+        static Uint64 GetLayoutGeneration();
     protected:
+        /* Which of the cached layout values below are still up to date. */
+        enum LayoutCache : Uint8 {
+            LAYOUT_POSITION     = 1 << 0,
+            LAYOUT_VISIBLE      = 1 << 1,
+            LAYOUT_SCALE        = 1 << 2,
+            LAYOUT_UNFIT_SCALE  = 1 << 3,
+            LAYOUT_DIMENSIONS   = 1 << 4,
+        };
+
         glm::vec2 m_Position;
 
         bool m_Visible = true;
@@ -119,6 +145,13 @@ namespace UI {
         std::vector<GenericElement *> m_Children;
 
         float m_Depth;
+
+        Uint8 m_ValidLayout = 0;
+
+        glm::vec2 m_CachedPosition;
+        bool m_CachedVisible;
+    private:
+        void InvalidateSubtree();
     };
 
     class Scalable : public GenericElement {
@@ -135,6 +168,9 @@ namespace UI {
         virtual glm::vec2 GetUnfitScale();
     protected:
         glm::vec2 m_Scale;
+
+        glm::vec2 m_CachedScale;
+        glm::vec2 m_CachedUnfitScale;
     };
 }
 
@@ -151,24 +187,20 @@ static Uint8 getChannelsFromFormats(VkFormat format) {
         //  return 3;
         case VK_FORMAT_R8G8B8A8_SRGB:
             return 4;
+        // block compressed, decodes to RGBA.
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 4;
         default:
             throw std::runtime_error(engineError::UNSUPPORTED_FORMAT);
     }
 }
 
-inline Uint32 FindMemoryType(EngineSharedContext &sharedContext, Uint32 typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(sharedContext.physicalDevice, &memoryProperties);
-
-    for (Uint32 i = 0; i < memoryProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-            return i;
-    }
-
-    throw std::runtime_error(engineError::CANT_FIND_SUITABLE_MEMTYPE);
-}
-
-inline void AllocateBuffer(EngineSharedContext &sharedContext, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &memory) {
+inline void AllocateBuffer(EngineSharedContext &sharedContext, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, MemoryAllocation &memory) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -181,15 +213,9 @@ inline void AllocateBuffer(EngineSharedContext &sharedContext, VkDeviceSize size
     VkMemoryRequirements memoryRequirements;
     vkGetBufferMemoryRequirements(sharedContext.engineDevice, buffer, &memoryRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memoryRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(sharedContext, memoryRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(sharedContext.engineDevice, &allocInfo, NULL, &memory) != VK_SUCCESS)
-        throw std::runtime_error(engineError::CANT_ALLOCATE_MEMORY);
+    memory = sharedContext.allocator->Allocate(memoryRequirements, properties, true);
 
-    vkBindBufferMemory(sharedContext.engineDevice, buffer, memory, 0);
+    vkBindBufferMemory(sharedContext.engineDevice, buffer, memory.deviceMemory, memory.offset);
 }
 
 inline VkCommandBuffer BeginSingleTimeCommands(EngineSharedContext &sharedContext) {
@@ -229,7 +255,7 @@ inline void EndSingleTimeCommands(EngineSharedContext &sharedContext, VkCommandB
     sharedContext.singleTimeCommandMutex.unlock();
 }
 
-inline TextureImageAndMemory CreateImage(EngineSharedContext &sharedContext, Uint32 width, Uint32 height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties) {
+inline TextureImageAndMemory CreateImage(EngineSharedContext &sharedContext, Uint32 width, Uint32 height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, Uint32 mipLevels = 1) {
     TextureImageAndMemory textureImageAndMemory;
 
     VkImageCreateInfo imageInfo{};
@@ -238,7 +264,7 @@ inline TextureImageAndMemory CreateImage(EngineSharedContext &sharedContext, Uin
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
@@ -254,21 +280,15 @@ inline TextureImageAndMemory CreateImage(EngineSharedContext &sharedContext, Uin
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(sharedContext.engineDevice, textureImageAndMemory.imageAndMemory.image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = FindMemoryType(sharedContext, memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(sharedContext.engineDevice, &allocInfo, nullptr, &textureImageAndMemory.imageAndMemory.memory) != VK_SUCCESS) {
-        throw std::runtime_error(engineError::CANT_ALLOCATE_MEMORY);
-    }
+    textureImageAndMemory.imageAndMemory.memory = sharedContext.allocator->Allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR);
 
     textureImageAndMemory.width = width;
     textureImageAndMemory.height = height;
     textureImageAndMemory.channels = getChannelsFromFormats(format);
     textureImageAndMemory.format = format;
+    textureImageAndMemory.mipLevels = mipLevels;
 
-    vkBindImageMemory(sharedContext.engineDevice, textureImageAndMemory.imageAndMemory.image, textureImageAndMemory.imageAndMemory.memory, 0);
+    vkBindImageMemory(sharedContext.engineDevice, textureImageAndMemory.imageAndMemory.image, textureImageAndMemory.imageAndMemory.memory.deviceMemory, textureImageAndMemory.imageAndMemory.memory.offset);
 
     return textureImageAndMemory;
 }
@@ -355,95 +375,62 @@ inline BufferAndMemory CreateSimpleVertexBuffer(EngineSharedContext &sharedConte
     //if (m_VertexBuffer || m_VertexBufferMemory)
     //    throw std::runtime_error(engineError::VERTEX_BUFFER_ALREADY_EXISTS);
 
-    // allocate the staging buffer (this is used for performance, having a buffer readable by the GPU and CPU is slower than a GPU-exclusive memory, so we will use that as our real vertex buffer)
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    VkDeviceSize bufferSize = sizeof(SimpleVertex) * simpleVerts.size();
 
-    VkDeviceSize stagingBufferSize = sizeof(SimpleVertex) * simpleVerts.size();
+    // the caller wants the host-visible staging buffer itself, no upload needed.
+    if (returnStaging) {
+        VkBuffer stagingBuffer;
+        MemoryAllocation stagingBufferMemory;
 
-    AllocateBuffer(sharedContext, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        AllocateBuffer(sharedContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
-    // copy the vertex data into the buffer
-    void *data;
-    vkMapMemory(sharedContext.engineDevice, stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-    SDL_memcpy(data, (void *)simpleVerts.data(), stagingBufferSize);
+        SDL_memcpy(stagingBufferMemory.mappedData, (void *)simpleVerts.data(), bufferSize);
 
-    if (returnStaging) {
-        return {stagingBuffer, stagingBufferMemory, data};
+        return {stagingBuffer, stagingBufferMemory, stagingBufferMemory.mappedData};
     }
 
-    vkUnmapMemory(sharedContext.engineDevice, stagingBufferMemory);
-
-    // allocate the gpu-exclusive vertex buffer
+    // allocate the gpu-exclusive vertex buffer, the upload batcher takes care of the staging buffer.
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    AllocateBuffer(sharedContext, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-    CopyHostBufferToDeviceBuffer(sharedContext, stagingBuffer, vertexBuffer, stagingBufferSize);
+    MemoryAllocation vertexBufferMemory;
+    AllocateBuffer(sharedContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
 
-    vkDestroyBuffer(sharedContext.engineDevice, stagingBuffer, NULL);
-    vkFreeMemory(sharedContext.engineDevice, stagingBufferMemory, NULL);
+    sharedContext.uploadBatcher->UploadBuffer(vertexBuffer, simpleVerts.data(), bufferSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
     return {vertexBuffer, vertexBufferMemory};
 }
 
-inline BufferAndMemory CreateVertexBuffer(EngineSharedContext &sharedContext, const std::vector<Vertex> &verts) {
+/* Vertex or QuantizedVertex, the pipeline it's drawn with has to expect the same one. */
+template<typename T>
+inline BufferAndMemory CreateVertexBuffer(EngineSharedContext &sharedContext, const std::vector<T> &verts) {
     //if (m_VertexBuffer || m_VertexBufferMemory)
     //    throw std::runtime_error(engineError::VERTEX_BUFFER_ALREADY_EXISTS);
 
-    // allocate the staging buffer (this is used for performance, having a buffer readable by the GPU and CPU is slower than a GPU-exclusive memory, so we will use that as our real vertex buffer)
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    VkDeviceSize bufferSize = sizeof(T) * verts.size();
 
-    VkDeviceSize stagingBufferSize = sizeof(Vertex) * verts.size();
-
-    AllocateBuffer(sharedContext, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    // copy the vertex data into the buffer
-    void *data;
-    vkMapMemory(sharedContext.engineDevice, stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-    SDL_memcpy(data, (void *)verts.data(), stagingBufferSize);
-    vkUnmapMemory(sharedContext.engineDevice, stagingBufferMemory);
-
-    // allocate the gpu-exclusive vertex buffer
+    // allocate the gpu-exclusive vertex buffer, the upload batcher takes care of the staging buffer.
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
-    AllocateBuffer(sharedContext, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-    CopyHostBufferToDeviceBuffer(sharedContext, stagingBuffer, vertexBuffer, stagingBufferSize);
+    MemoryAllocation vertexBufferMemory;
+    AllocateBuffer(sharedContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
 
-    vkDestroyBuffer(sharedContext.engineDevice, stagingBuffer, NULL);
-    vkFreeMemory(sharedContext.engineDevice, stagingBufferMemory, NULL);
+    sharedContext.uploadBatcher->UploadBuffer(vertexBuffer, verts.data(), bufferSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
     return {vertexBuffer, vertexBufferMemory};
 }
 
-inline BufferAndMemory CreateIndexBuffer(EngineSharedContext &sharedContext, const std::vector<Uint32> &inds) {
+/* Uint16 or Uint32 indices, bind it with the matching VkIndexType. */
+template<typename T>
+inline BufferAndMemory CreateIndexBuffer(EngineSharedContext &sharedContext, const std::vector<T> &inds) {
     //if (m_IndexBuffer || m_IndexBufferMemory)
     //    throw std::runtime_error(engineError::INDEX_BUFFER_ALREADY_EXISTS);
 
-    // allocate the staging buffer (this is used for performance, having a buffer readable by the GPU and CPU is slower than a GPU-exclusive memory, so we will use that as our real index buffer)
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    VkDeviceSize bufferSize = sizeof(T) * inds.size();
 
-    VkDeviceSize stagingBufferSize = sizeof(Uint32) * inds.size();
-    AllocateBuffer(sharedContext, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    // copy the index data into the buffer
-    void *data;
-    vkMapMemory(sharedContext.engineDevice, stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-    SDL_memcpy(data, (void *)inds.data(), stagingBufferSize);
-    vkUnmapMemory(sharedContext.engineDevice, stagingBufferMemory);
-
-    // allocate the gpu-exclusive index buffer
+    // allocate the gpu-exclusive index buffer, the upload batcher takes care of the staging buffer.
     VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
-    AllocateBuffer(sharedContext, stagingBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    MemoryAllocation indexBufferMemory;
+    AllocateBuffer(sharedContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
 
-    CopyHostBufferToDeviceBuffer(sharedContext, stagingBuffer, indexBuffer, stagingBufferSize);
-
-    vkDestroyBuffer(sharedContext.engineDevice, stagingBuffer, NULL);
-    vkFreeMemory(sharedContext.engineDevice, stagingBufferMemory, NULL);
+    sharedContext.uploadBatcher->UploadBuffer(indexBuffer, inds.data(), bufferSize, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
 
     return {indexBuffer, indexBufferMemory};
 }
@@ -479,40 +466,16 @@ inline void CopyBufferToImage(EngineSharedContext &sharedContext, TextureBufferA
 }
 
 inline TextureImageAndMemory CreateSinglePixelImage(EngineSharedContext &sharedContext, glm::vec3 color) {
-    /* Allocate the buffer that stores our pixel data. */
-    BufferAndMemory textureBufferAndMemory;
-
-    VkDeviceSize bufferSize = sizeof(Uint8) * 4;  // R8G8B8A8
+    std::array<Uint8, 4> texColors = {static_cast<Uint8>(color.r * 255), static_cast<Uint8>(color.g * 255), static_cast<Uint8>(color.b * 255), 255};    // R8G8B8A8
 
-    AllocateBuffer(sharedContext, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, textureBufferAndMemory.buffer, textureBufferAndMemory.memory);
-
-    // copy the texture data into the buffer
-    void *data;
-    std::array<Uint8, 4> texColors = {static_cast<Uint8>(color.r * 255), static_cast<Uint8>(color.g * 255), static_cast<Uint8>(color.b * 255), 255};
-
-    vkMapMemory(sharedContext.engineDevice, textureBufferAndMemory.memory, 0, bufferSize, 0, &data);
-    SDL_memcpy(data, (void *)texColors.data(), bufferSize);
-    vkUnmapMemory(sharedContext.engineDevice, textureBufferAndMemory.memory);
-
-    /* Transfer our newly created texture to an image */
     TextureImageAndMemory textureImageAndMemory = CreateImage(sharedContext,
     1, 1,
     VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
     VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
-    ChangeImageLayout(sharedContext, textureImageAndMemory.imageAndMemory.image, 
-                VK_FORMAT_R8G8B8A8_SRGB, 
-                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-            );
-    CopyBufferToImage(sharedContext, {textureBufferAndMemory, 1, 1, 4}, textureImageAndMemory.imageAndMemory.image);
-    ChangeImageLayout(sharedContext, textureImageAndMemory.imageAndMemory.image, 
-                VK_FORMAT_R8G8B8A8_SRGB, 
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-            );
-    
-    vkDestroyBuffer(sharedContext.engineDevice, textureBufferAndMemory.buffer, NULL);
-    vkFreeMemory(sharedContext.engineDevice, textureBufferAndMemory.memory, NULL);
+
+    sharedContext.uploadBatcher->UploadImage(textureImageAndMemory.imageAndMemory.image, texColors.data(), sizeof(Uint8) * texColors.size(), 1, 1);
 
     return textureImageAndMemory;
 }
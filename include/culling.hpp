@@ -0,0 +1,121 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <array>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+/* How much bigger the tree's boxes are than the actual boxes, small moves don't touch the tree at all. */
+#define AABB_TREE_MARGIN 0.1f
+
+#define AABB_TREE_NULL_NODE -1
+
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    /* From the [0] = higher, [1] = lower boxes that Model and Mesh use. */
+    static inline AABB FromBoundingBox(const std::array<glm::vec3, 2> &boundingBox) { return {boundingBox[1], boundingBox[0]}; };
+
+    inline bool Contains(const AABB &other) const { return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max)); };
+
+    /* Half of the surface area, only used to compare boxes. */
+    inline float GetCost() const { glm::vec3 size = max - min; return size.x * size.y + size.y * size.z + size.z * size.x; };
+};
+
+inline AABB mergeAABBs(const AABB &a, const AABB &b) {
+    return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+enum FrustumTestResult {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+/* The 6 planes of a view frustum, stored as a structure of arrays so 4 planes can be tested against a box at once.
+ * Padded to 8 planes, the padding planes contain everything. */
+struct Frustum {
+    alignas(16) float planeX[8];
+    alignas(16) float planeY[8];
+    alignas(16) float planeZ[8];
+    alignas(16) float planeW[8];
+
+    /* Absolute values of the plane normals, for the box's projected radius. */
+    alignas(16) float absPlaneX[8];
+    alignas(16) float absPlaneY[8];
+    alignas(16) float absPlaneZ[8];
+
+    /* Gribb/Hartmann plane extraction, viewProjection should be projection * view (OpenGL depth range, which is what glm gives us). */
+    static Frustum FromMatrix(const glm::mat4 &viewProjection);
+
+    FrustumTestResult TestAABB(const AABB &box) const;
+};
+
+struct AABBTreeNode {
+    /* Fattened by AABB_TREE_MARGIN on leaves. */
+    AABB box;
+
+    Sint32 parent = AABB_TREE_NULL_NODE;
+    Sint32 left = AABB_TREE_NULL_NODE;
+    Sint32 right = AABB_TREE_NULL_NODE;
+
+    /* Leaves are 0, free nodes are -1. */
+    Sint32 height = -1;
+
+    Uint32 userData = 0;
+
+    inline bool IsLeaf() const { return left == AABB_TREE_NULL_NODE; };
+};
+
+/* A dynamic bounding volume hierarchy (the same idea as Box2D's b2DynamicTree).
+ * Leaves are inserted where they grow the tree the least and the tree is kept balanced with AVL rotations, so moving things around stays cheap. */
+class AABBTree {
+public:
+    /* Returns the proxy ID, which stays valid until DestroyProxy. */
+    Sint32 CreateProxy(const AABB &box, Uint32 userData);
+    void DestroyProxy(Sint32 proxyID);
+
+    /* Returns true if the proxy had to be reinserted, nothing happens if box still fits in the fattened one. */
+    bool MoveProxy(Sint32 proxyID, const AABB &box);
+
+    inline void SetUserData(Sint32 proxyID, Uint32 userData) { m_Nodes[proxyID].userData = userData; };
+    inline Uint32 GetUserData(Sint32 proxyID) { return m_Nodes[proxyID].userData; };
+
+    /* Appends the userData of every proxy that's at least partially inside frustum to results. */
+    void QueryFrustum(const Frustum &frustum, std::vector<Uint32> &results);
+
+    inline Uint32 GetProxyCount() { return m_ProxyCount; };
+    inline Sint32 GetHeight() { return m_Root == AABB_TREE_NULL_NODE ? 0 : m_Nodes[m_Root].height; };
+private:
+    Sint32 AllocateNode();
+    void FreeNode(Sint32 nodeID);
+
+    void InsertLeaf(Sint32 leafID);
+    void RemoveLeaf(Sint32 leafID);
+
+    /* Rotates the tree at nodeID if it's unbalanced, returns the node that ends up in its place. */
+    Sint32 Balance(Sint32 nodeID);
+
+    /* Walks from nodeID to the root, balancing and refitting every node on the way. */
+    void RefitAncestors(Sint32 nodeID);
+
+    /* Every leaf under nodeID, no more tests needed. */
+    void CollectLeaves(Sint32 nodeID, std::vector<Uint32> &results);
+
+    std::vector<AABBTreeNode> m_Nodes;
+
+    Sint32 m_Root = AABB_TREE_NULL_NODE;
+    Sint32 m_FreeList = AABB_TREE_NULL_NODE;
+
+    Uint32 m_ProxyCount = 0;
+
+    /* Kept around so queries don't allocate. */
+    std::vector<Sint32> m_Stack;
+};
+
+#endif
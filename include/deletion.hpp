@@ -0,0 +1,74 @@
+#ifndef DELETION_HPP
+#define DELETION_HPP
+
+#include "allocator.hpp"
+#include "upload.hpp"
+
+#include <SDL3/SDL_stdinc.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Everything queued while one frame was the latest, destroyed together. */
+struct FrameDeletions {
+    Uint64 frameNumber;
+
+    /* The newest upload anything in here was a destination of, they can't go away mid-copy. */
+    UploadToken uploadToken = 0;
+
+    std::vector<std::pair<VkBuffer, MemoryAllocation>> buffers;
+    std::vector<std::pair<VkImage, MemoryAllocation>> images;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkSampler> samplers;
+    std::vector<std::pair<VkDescriptorPool, VkDescriptorSet>> descriptorSets;
+};
+
+/* Destroys resources once no frame in flight can be using them anymore, instead of idling the whole device for every single one.
+ * Resources are tagged with the frame number they were queued in, and destroyed once that frame's fence has signaled (frameCount frames later).
+ * This class is thread-safe. */
+class DeletionQueue {
+public:
+    DeletionQueue(VkDevice device, MemoryAllocator *allocator, UploadBatcher *uploadBatcher, Uint32 frameCount);
+
+    /* Destroys whatever's left, the device has to be idle by then. */
+    ~DeletionQueue();
+
+    /* frameNumber is the frame about to be recorded, call this once its frame slot's fence has been waited on.
+     * Destroys everything queued frameCount or more frames ago, whatever gets queued from now on is tagged with frameNumber. */
+    void BeginFrame(Uint64 frameNumber);
+
+    /* uploadToken is the last upload that wrote into the resource, if there's one that might not be done yet. */
+    void DestroyBuffer(VkBuffer buffer, const MemoryAllocation &memory, UploadToken uploadToken = 0);
+    void DestroyImage(VkImage image, const MemoryAllocation &memory, UploadToken uploadToken = 0);
+    void DestroyImageView(VkImageView imageView);
+    void DestroySampler(VkSampler sampler);
+    void FreeDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet);
+
+    /* Destroys everything right away, only call this while the device is idle. */
+    void Flush();
+
+    /* How many resources are waiting to be destroyed. */
+    size_t GetPendingCount();
+
+    /* Whether everything queued up until (and including) frameNumber has been destroyed already. */
+    bool IsRetired(Uint64 frameNumber);
+private:
+    /* All of these expect m_Mutex to be held. */
+    FrameDeletions &GetCurrentFrame();
+    void Destroy(FrameDeletions &deletions);
+
+    VkDevice m_Device;
+    MemoryAllocator *m_Allocator;
+    UploadBatcher *m_UploadBatcher;
+
+    Uint32 m_FrameCount;
+    Uint64 m_FrameNumber = 0;
+
+    /* Oldest first, there's at most one per frame number. */
+    std::deque<FrameDeletions> m_Frames;
+
+    std::mutex m_Mutex;
+};
+
+#endif
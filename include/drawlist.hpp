@@ -0,0 +1,91 @@
+#ifndef DRAWLIST_HPP
+#define DRAWLIST_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <array>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Opaque draws: pipeline (8 bits) | texture (20 bits) | mesh (20 bits) | depth (16 bits, front to back).
+ * Blended draws: inverted depth (16 bits, back to front) | pipeline (8 bits) | texture (20 bits) | mesh (20 bits). */
+typedef Uint64 DrawSortKey;
+
+#define DRAW_KEY_PIPELINE_BITS 8
+#define DRAW_KEY_TEXTURE_BITS 20
+#define DRAW_KEY_MESH_BITS 20
+#define DRAW_KEY_DEPTH_BITS 16
+
+/* The handles (buffers, image views, samplers) that went into a descriptor push, unused ones are 0. Compared exactly, not hashed. */
+typedef std::array<Uint64, 3> DescriptorKey;
+
+struct DrawCommand {
+    DrawSortKey key;
+
+    /* Whatever the caller wants it to be, usually an index into its own array. */
+    Uint32 index;
+};
+
+/* A list of draws that gets sorted by key, so draws that share state end up next to each other. Meant to be rebuilt every frame. */
+class DrawList {
+public:
+    /* depth is expected to be in [0, 1], anything outside of that gets clamped. */
+    static DrawSortKey MakeOpaqueKey(Uint32 pipelineID, Uint32 textureID, Uint32 meshID, float depth);
+    static DrawSortKey MakeBlendedKey(Uint32 pipelineID, Uint32 textureID, Uint32 meshID, float depth);
+
+    /* Folds a Vulkan handle (or any pointer) into an ID, IDs only decide the order, collisions are harmless. */
+    static Uint32 HandleID(Uint64 handle);
+
+    void Clear();
+    void Add(DrawSortKey key, Uint32 index);
+
+    /* LSD radix sort over the keys, 8 bits at a time. Bytes that are the same in every key are skipped. Stable. */
+    void Sort();
+
+    inline const std::vector<DrawCommand> &GetCommands() { return m_Commands; };
+    inline size_t Size() { return m_Commands.size(); };
+private:
+    std::vector<DrawCommand> m_Commands;
+
+    /* Kept around so sorting doesn't allocate every frame. */
+    std::vector<DrawCommand> m_Scratch;
+};
+
+/* Remembers what's bound on a command buffer so the same pipeline/buffer/descriptors don't get bound again back to back.
+ * Call Reset whenever a render pass begins, nothing carries over between render passes. */
+class CommandStateTracker {
+public:
+    void Reset(VkCommandBuffer commandBuffer);
+
+    /* The bind counts keep going up across Resets until this is called. */
+    void ResetStatistics();
+
+    void BindPipeline(VkPipeline pipeline);
+    void BindVertexBuffer(Uint32 binding, VkBuffer buffer, VkDeviceSize offset = 0);
+    void BindIndexBuffer(VkBuffer buffer, VkIndexType indexType);
+
+    /* Returns true if descriptorKey is different from the last one, the caller should push its descriptors then.
+     * Binding another pipeline forgets the last key. */
+    bool DescriptorsChanged(const DescriptorKey &descriptorKey);
+
+    inline Uint32 GetBindCount() { return m_BindCount; };
+    inline Uint32 GetSkippedBindCount() { return m_SkippedBindCount; };
+private:
+    VkCommandBuffer m_CommandBuffer = nullptr;
+
+    VkPipeline m_Pipeline = nullptr;
+
+    /* Only the first two bindings are tracked, that's all we use (vertices + instances). */
+    VkBuffer m_VertexBuffers[2] = {};
+    VkDeviceSize m_VertexBufferOffsets[2] = {};
+
+    VkBuffer m_IndexBuffer = nullptr;
+    VkIndexType m_IndexType = VK_INDEX_TYPE_UINT32;
+
+    DescriptorKey m_DescriptorKey{};
+    bool m_HasDescriptors = false;
+
+    Uint32 m_BindCount = 0;
+    Uint32 m_SkippedBindCount = 0;
+};
+
+#endif
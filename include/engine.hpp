@@ -11,8 +11,16 @@
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 #include "camera.hpp"
 #include "common.hpp"
+#include "culling.hpp"
+#include "drawlist.hpp"
+#include "gpuprofiler.hpp"
 #include "isteamnetworkingsockets.h"
+#include "recorder.hpp"
+#include "sdf.hpp"
 #include "steamnetworkingtypes.h"
+#include "texturedata.hpp"
+#include "texturetable.hpp"
+#include "threadpool.hpp"
 #include "ui.hpp"
 #include "ui/button.hpp"
 #include "object.hpp"
@@ -20,8 +28,11 @@
 #include <LinearMath/btVector3.h>
 #include <btBulletDynamicsCommon.h>
 
+#include <atomic>
+#include <deque>
 #include <future>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
 #ifndef VK_EXT_DEBUG_REPORT_EXTENSION_NAME
 #define VK_EXT_DEBUG_REPORT_EXTENSION_NAME "VK_EXT_debug_report"
@@ -72,11 +83,24 @@
 
 #define MAX_FRAMES_IN_FLIGHT 2
 
+/* What headless frames are rendered into (and read back as), RGBA so captures can be written as they are. */
+#define HEADLESS_IMAGE_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+
+/* A subpass is only split between recording threads if every thread gets at least this many items. */
+#define RECORDING_MIN_ITEMS_PER_CHUNK 32
+
+/* The profiler overlay is rebuilt every this many frames, rebuilding a label isn't cheap. */
+#define PROFILER_OVERLAY_REFRESH_FRAMES 30
+
 const std::vector<const char *> requiredDeviceExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME
 };
 
+/* Only needed when there's a window to present to. */
+const std::vector<const char *> presentationDeviceExtensions = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
+
 const std::vector<const char *> requiredInstanceExtensions = { 
 };
 
@@ -97,47 +121,127 @@ struct PipelineAndLayout {
     VkPipelineLayout layout = nullptr;
 };
 
+#define PIPELINE_CACHE_MAGIC 0x43505345    // "ESPC"
+#define PIPELINE_CACHE_VERSION 1
+
+/* Written in front of the driver's pipeline cache data, the whole cache gets thrown away if anything in here doesn't match. */
+struct PipelineCacheHeader {
+    Uint32 magic;
+    Uint32 version;
+
+    Uint32 vendorID;
+    Uint32 deviceID;
+    Uint32 driverVersion;
+    Uint8 pipelineCacheUUID[VK_UUID_SIZE];
+
+    Uint64 dataSize;
+    Uint64 dataHash;
+};
+
 struct MatricesUBO {
     glm::mat4 viewMatrix;
     glm::mat4 modelMatrix;
     glm::mat4 projectionMatrix;
 };
 
+/* Whatever is the same for every draw in a frame, there's one per frame slot. */
+struct FrameUBO {
+    glm::mat4 viewProjectionMatrix;
+};
+
 struct UIWaypointUBO {
     glm::vec3 Position;
 };
 
-struct UIArrowsUBO {
-    glm::vec3 Color;
+/* Small enough to be pushed with every arrow instead of having a UBO each. */
+struct UIArrowsPushConstants {
+    glm::mat4 ModelMatrix;
+    glm::vec4 Color;
 };
 
 /* Got a weird bug with floats and found out it was because I didn't put alignas(16), I am now extremely paranoid and will put this in every single UBO with a vec2/float. */
-struct UIPanelUBO {
-alignas(16)    glm::vec4 Dimensions;
+/* One quad of the UI, panels and glyphs alike. Rect is (x, y, w, h) in clip space, laid out already. Color is linear. */
+struct UIInstance {
+alignas(16)    glm::vec4 Rect;
+alignas(16)    glm::vec4 UVRect;
+alignas(16)    glm::vec4 Color;
 alignas(16)    float Depth;
 };
 
-struct UILabelPositionUBO {
-alignas(16)    glm::vec2 PositionOffset;
-alignas(16)    float Depth;
-};
+/* A texture and its view, shared by every mesh that uses the same file (or the same flat color). */
+struct RenderTexture {
+    TextureImageAndMemory image;
+    VkImageView imageView;
 
-struct RenderModel {
-    Model *model;
+    /* Its slot in the bindless texture table, if there's one. */
+    Uint32 textureIndex = 0;
+
+    /* Don't sample it before this is complete. */
+    UploadToken uploadToken;
+
+    /* Canonical path, or the color for single pixel textures. */
+    std::string key;
+    Uint32 referenceCount = 0;
+};
 
+/* Everything on the GPU side of a Mesh. Meshes that come from the same file are loaded once and shared by every RenderModel that uses them. */
+struct RenderMesh {
     BufferAndMemory vertexBuffer;
 
     VkDeviceSize indexBufferSize;
     BufferAndMemory indexBuffer;
 
-    TextureImageAndMemory diffTexture;
+    /* VK_INDEX_TYPE_UINT16 for meshes small enough, half the index memory and bandwidth. */
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+    /* The vertex buffer holds QuantizedVertex, drawn with the quantized pipeline and these pushed. */
+    bool isQuantized = false;
+    QuantizationParameters quantizationParameters;
+
+    /* Owned by the renderer, null if the mesh was loaded without textures. */
+    RenderTexture *diffTexture = nullptr;
+
+    /* Copied from diffTexture, so drawing doesn't have to chase the pointer. The sampler is shared and never freed with the mesh. */
     VkImageView diffTextureImageView;
     VkSampler diffTextureSampler;
 
+    /* Its slot in the bindless texture table, if there's one. */
+    Uint32 textureIndex = 0;
+
     glm::vec3 diffColor;
 
-    MatricesUBO matricesUBO;
-    BufferAndMemory matricesUBOBuffer;
+    /* Don't draw it before this is complete. */
+    UploadToken uploadToken;
+
+    /* Source file + mesh index, empty if this mesh can't be shared. */
+    std::string key;
+    Uint32 referenceCount = 0;
+
+    /* Where this mesh's model matrices start in the instance buffer, and how many there are. Rebuilt every frame. */
+    Uint32 firstInstance = 0;
+    Uint32 instanceCount = 0;
+
+    /* View-space depth of the closest instance, used to sort meshes front to back. */
+    float nearestDepth = 0.0f;
+};
+
+struct RenderModel {
+    Model *model;
+
+    /* Owned by the renderer, may be shared with other RenderModels. */
+    RenderMesh *mesh;
+
+    /* The mesh's bounding box in model-space, [0] = higher [1] = lower. */
+    std::array<glm::vec3, 2> localBoundingBox;
+
+    /* The model matrix the culling proxy was last moved with, also what gets drawn this frame. */
+    glm::mat4 modelMatrix;
+
+    /* In m_ModelTree, AABB_TREE_NULL_NODE if it isn't culled (the UI arrows). */
+    Sint32 cullingProxy = AABB_TREE_NULL_NODE;
+
+    /* Loaded but never visible, a scene that's still streaming in. */
+    bool isHidden = false;
 };
 
 struct RenderUIWaypoint {
@@ -166,27 +270,41 @@ struct RenderUIArrows {
     // VkSampler diffTextureSampler;
 
     std::array<RenderModel, 3> arrowRenderModels;
-
-    std::array<std::pair<std::pair<MatricesUBO, UIArrowsUBO>, std::pair<BufferAndMemory, BufferAndMemory>>, 3> arrowBuffers;
 };
 
 struct RenderUIPanel {
     UI::Panel *panel;
+};
 
-    VkImageView textureView;
-    VkSampler textureSampler;
+/* Everything needed to place a glyph without asking FreeType again, all in pixels at the size it was rasterized at. */
+struct GlyphMetrics {
+    float advance;
+    float bearingX;    // bitmap_left
+    float bearingY;    // bitmap_top
+    float width;
+    float height;
 
-    UIPanelUBO ubo;
-    BufferAndMemory uboBuffer;
+    /* Spaces and anything else without a bitmap only have an advance. */
+    std::optional<GlyphAtlasRegion> atlasRegion;
+};
+
+/* A run of a label's glyph instances that all come from the same atlas page, drawn with one instanced draw. */
+struct GlyphInstanceRange {
+    Uint32 page;
+    Uint32 firstInstance;
+    Uint32 instanceCount;
 };
 
 struct RenderUILabel {
     UI::Label *label;
 
-    std::vector<std::pair<char, std::pair<VkImageView, VkSampler>>> textureShaderData;
+    /* A GlyphInstance for every glyph of the label relative to the label, sorted by atlas page. */
+    std::vector<GlyphInstance> glyphInstances;
+    std::vector<GlyphInstanceRange> glyphInstanceRanges;
 
-    UILabelPositionUBO ubo;
-    BufferAndMemory uboBuffer;
+    /* Where its first glyph is in the UI instance buffer, glyphInstanceRanges are relative to it. */
+    Uint32 firstInstance;
+    bool isVisible;
 };
 
 struct RenderPass {
@@ -202,6 +320,17 @@ public:
     void SetMouseCaptureState(bool capturing);
 
     void LoadModel(Model *model);   // this is the first function created to be used by main.cpp
+
+    /* Same as LoadModel for every model, but the textures of all of them are decoded in parallel and everything goes out in one upload batch.
+     * Textures found in decodedTextures (by GetTextureKey) aren't decoded again. isHidden models aren't drawn until ShowModels. */
+    void LoadModels(const std::vector<Model *> &models, const std::unordered_map<std::string, TextureData> *decodedTextures = nullptr, bool isHidden = false);
+
+    /* Starts drawing models that were loaded with isHidden. */
+    void ShowModels(const std::vector<Model *> &models);
+
+    /* Decodes every texture the models use, looked up by GetTextureKey. Doesn't look at what's already loaded or touch the device,
+     * so it's safe to run on any thread, as long as threadPool isn't the renderer's own. */
+    std::unordered_map<std::string, TextureData> DecodeModelTextures(const std::vector<Model *> &models, ThreadPool &threadPool);
     void UnloadModel(Model *model);
 
     void AddUIChildren(UI::GenericElement *element);
@@ -234,6 +363,10 @@ public:
     bool RemoveUILabel(UI::Label *label);
 
     void RegisterUpdateFunction(const std::function<void()> &func);
+
+    /* Headless only, called with every frame once it's been read back: (frameNumber, RGBA pixels with rows top to bottom, width, height).
+     * The pixels are only valid during the call. */
+    void RegisterFrameReadbackListener(const std::function<void(Uint64, const Uint8 *, Uint32, Uint32)> &func);
     // Fixed Updates are called 60 times a second.
     void RegisterFixedUpdateFunction(const std::function<void(std::array<bool, 322>)> &func);
 
@@ -242,9 +375,24 @@ public:
 
     void SetPrimaryCamera(Camera *cam);
 
-    Glyph GenerateGlyph(EngineSharedContext &sharedContext, FT_Face ftFace, char c, float &x, float &y, float depth);
+    /* Rasterizes every character of text that isn't cached yet in one go, distance fields (video.SDFText) are generated on the worker threads.
+     * Call this before generating a string's glyphs one by one. */
+    void PrepareGlyphs(FontHandle font, const std::string &text);
+
+    /* font comes from the FontManager, its face is only touched the first time a (face, pixel size, character) is seen, after that it's a hash lookup. */
+    Glyph GenerateGlyph(FontHandle font, char c, float &x, float &y);
+
+    inline EngineSharedContext GetSharedContext() { return {this, m_EngineDevice, m_EnginePhysicalDevice, m_CommandPool, m_GraphicsQueue, m_Settings, m_Allocator.get(), m_UploadBatcher.get(), m_DeletionQueue.get(), m_FontManager.get(), m_SingleTimeCommandMutex}; };
 
-    inline EngineSharedContext GetSharedContext() { return {this, m_EngineDevice, m_EnginePhysicalDevice, m_CommandPool, m_GraphicsQueue, m_Settings, m_SingleTimeCommandMutex}; };
+    /* Gives empty memory pages back to the driver, call this after unloading a lot of stuff.
+     * Frees go through the DeletionQueue, so this only happens once it has destroyed everything queued until now. */
+    void DefragmentMemory();
+
+    /* Rolling GPU time of every profiled scope, empty unless profile.GPU is on. Results lag MAX_FRAMES_IN_FLIGHT frames behind. */
+    inline std::vector<GPUProfilerResult> GetGPUProfilerResults() { return m_GPUProfiler->GetResults(); };
+
+    /* Rolling average of how long the CPU spent on a frame, not counting the time spent waiting on the GPU. */
+    inline double GetCPUFrameMilliseconds() { return m_CPUFrameMilliseconds; };
 
     void  Init();
     void  Start();
@@ -255,25 +403,82 @@ private:
 
     void InitInstance();
     void InitSwapchain();
+
+    /* Takes the place of InitSwapchain in headless mode, one offscreen image and readback buffer per frame in flight. */
+    void InitHeadlessTargets();
+
+    /* Copies frameIndex's offscreen image into its readback buffer, goes right after the rescale render pass. */
+    void RecordReadback(VkCommandBuffer commandBuffer, Uint32 frameIndex);
+
+    /* Hands the frame waiting in frameIndex's readback buffer to the listeners and writes it out, if there is one. Only call this once the frame's fence has been waited on. */
+    void ProcessReadback(Uint32 frameIndex);
     void InitFramebuffers(VkRenderPass renderPass, VkImageView depthImageView);
     VkImageView CreateDepthImage(Uint32 width, Uint32 height);
-    PipelineAndLayout CreateGraphicsPipeline(const std::string &shaderName, VkRenderPass renderPass, Uint32 subpassIndex, VkFrontFace frontFace, VkViewport viewport, VkRect2D scissor, const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts = {}, bool isSimple = false, bool enableDepth = VK_TRUE);
+    /* isInstanced adds a per-instance model matrix (InstanceData) at binding 1, only works with regular (non-simple) vertices. */
+    /* isQuantized takes QuantizedVertex instead of Vertex, and sets the vertex shader's constant 0 to true so it knows. */
+    PipelineAndLayout CreateGraphicsPipeline(const std::string &vertexShaderName, const std::string &fragmentShaderName, VkRenderPass renderPass, Uint32 subpassIndex, VkFrontFace frontFace, VkViewport viewport, VkRect2D scissor, const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts = {}, bool isSimple = false, bool enableDepth = VK_TRUE, bool isInstanced = false, const std::vector<VkPushConstantRange> &pushConstantRanges = {}, bool isQuantized = false);
+    /* The pipeline cache survives between runs, it's loaded in Init and saved in the destructor. */
+    void LoadPipelineCache();
+    void SavePipelineCache();
+
     VkRenderPass CreateRenderPass(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp, size_t subpassCount, VkFormat imageFormat, VkImageLayout initialColorLayout, VkImageLayout finalColorLayout, bool shouldContainDepthImage = true);
     VkFramebuffer CreateFramebuffer(VkRenderPass renderPass, VkImageView imageView, VkExtent2D resolution, VkImageView depthImageView = nullptr);
     bool QuitEventCheck(SDL_Event &event);
 
+    /* Drops renderModel's reference to its mesh, the mesh is destroyed once nobody uses it anymore. */
     void UnloadRenderModel(RenderModel &renderModel);
 
+    /* Moves the culling proxies of models that moved and marks what's inside the frustum in m_RenderModelVisibility. */
+    void CullRenderModels(const glm::mat4 &viewProjection);
+
+    /* Splits itemCount items into chunks and records them in parallel, every chunk goes into its own secondary command buffer through record(commandBuffer, stateTracker, first, last).
+     * The buffers are executed in order on primaryCommandBuffer, which has to be in subpass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. record runs on any thread.
+     * profilerScope is timed from the start of the first chunk to the end of the last one, GPU_PROFILER_NO_SCOPE to skip. */
+    void RecordSubpassInParallel(VkCommandBuffer primaryCommandBuffer, VkRenderPass renderPass, Uint32 subpass, VkFramebuffer framebuffer, size_t itemCount, Uint32 profilerScope, const std::function<void(VkCommandBuffer, CommandStateTracker &, size_t, size_t)> &record);
+
+    /* Rewrites the overlay label with the latest profiler results, creates it the first time. */
+    void UpdateProfilerOverlay();
+
+    /* Lays every panel and label out into a new UI instance buffer and rebuilds the panel draw list.
+     * Only called when a UI element was added, removed or marked dirty since the last time. */
+    void UpdateUILayout();
+
+    /* Makes sure the instance buffer of frameIndex can hold instanceCount instances, only call this once the frame's fence has been waited on. */
+    void ReserveInstanceBuffer(Uint32 frameIndex, Uint32 instanceCount);
+
     SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
     VkShaderModule CreateShaderModule(VkDevice device, const std::vector<char> &code);
     Uint32 FindMemoryType(Uint32 typeFilter, VkMemoryPropertyFlags properties);
 
     void CopyHostBufferToDeviceBuffer(VkBuffer hostBuffer, VkBuffer deviceBuffer, VkDeviceSize size);
 
-    RenderModel LoadMesh(Mesh &mesh, Model *model, bool loadTextures = true);
-    std::array<TextureImageAndMemory, 1> LoadTexturesFromMesh(Mesh &mesh, bool recordAllocations = true);
+    /* decodedDiffuse is the already decoded diffuse map of mesh, it's read from disk here if it's null. */
+    RenderModel LoadMesh(Mesh &mesh, Model *model, bool loadTextures = true, const TextureData *decodedDiffuse = nullptr);
+    /* The textures are shared, every one of them has to be handed back to ReleaseTexture. */
+    std::array<RenderTexture *, 1> LoadTexturesFromMesh(Mesh &mesh, const TextureData *decodedDiffuse = nullptr);
+
+    /* Where the diffuse map of mesh is on disk, empty if it has none. */
+    std::filesystem::path GetDiffuseMapPath(Mesh &mesh);
+
+    /* What a texture loaded from path is cached as, two paths to the same file get the same key. */
+    std::string GetTextureKey(const std::filesystem::path &path);
+
+    /* Returns the texture cached under key, or calls createImage and caches what it returns. Either way, the caller holds a reference. */
+    RenderTexture *AcquireTexture(const std::string &key, const std::function<TextureImageAndMemory()> &createImage);
+
+    /* Frees the texture once nothing holds a reference anymore, after the frames in flight are done with it. */
+    void ReleaseTexture(RenderTexture *texture);
+
+    /* Creates a sampler the first time a parameter set is asked for, every later call gets the same one. */
+    VkSampler GetSharedSampler(float maxAnisotropy);
+
+    TextureImageAndMemory LoadTextureFromFile(const std::string &name);
+
+    /* The CPU half of LoadTextureFromFile, doesn't touch the device or any renderer state so it's safe to run on any thread. */
+    TextureData DecodeTextureFile(const std::string &name);
 
-    TextureBufferAndMemory LoadTextureFromFile(const std::string &name);
+    /* The GPU half, creates the image and queues every level on the upload batcher. */
+    TextureImageAndMemory UploadTexture(const TextureData &textureData);
     VkImageView CreateImageView(TextureImageAndMemory &imageAndMemory, VkFormat format, VkImageAspectFlags aspectMask, bool recordCreation = true);
     VkSampler CreateSampler(float maxAnisotropy, bool recordCreation = true);
 
@@ -293,7 +498,16 @@ private:
 
     std::unordered_map<SDL_EventType, std::vector<std::function<void(SDL_Event *)>>> m_SDLEventListeners;
 
-    std::vector<Glyph> m_GlyphCache;
+    /* Distance fields are generated at one size and drawn at any, bitmaps only ever at the size they were rasterized at. */
+    inline Uint32 GetGlyphSize(FontHandle font) { return m_Settings.SDFText ? SDF_GLYPH_SIZE : m_FontManager->GetPixelSize(font); };
+
+    /* Face ID in the top 24 bits, pixel size in the next 16, the character in the last 24. */
+    inline Uint64 GetGlyphKey(Uint32 fontFaceID, Uint32 pixelSize, Uint32 codepoint) { return (static_cast<Uint64>(fontFaceID) << 40) | (static_cast<Uint64>(pixelSize & 0xFFFF) << 24) | (codepoint & 0xFFFFFF); };
+
+    std::unordered_map<Uint64, GlyphMetrics> m_GlyphCache;
+
+    /* A (0, 0) to (1, 1) quad, every glyph instance is drawn with it. */
+    BufferAndMemory m_GlyphQuadBuffer{};
 
     std::vector<RenderUIWaypoint> m_RenderUIWaypoints;
     std::vector<RenderUIArrows> m_RenderUIArrows;
@@ -311,8 +525,10 @@ private:
 
     VkQueue m_GraphicsQueue = nullptr;
     VkQueue m_PresentQueue = nullptr;
+    VkQueue m_TransferQueue = nullptr;
     Uint32 m_GraphicsQueueIndex = UINT32_MAX;
     Uint32 m_PresentQueueIndex = UINT32_MAX;
+    Uint32 m_TransferQueueIndex = UINT32_MAX;
 
     std::vector<VkCommandBuffer> m_CommandBuffers;
 
@@ -334,19 +550,83 @@ private:
     VkSampler m_RescaleRenderSampler = nullptr;
 
     PipelineAndLayout m_MainGraphicsPipeline; // Used to render the 3D scene
+    PipelineAndLayout m_QuantizedGraphicsPipeline; // Same as the main one, for meshes with QuantizedVertex. The layouts are identical, so bound sets carry over between them.
     PipelineAndLayout m_UIWaypointGraphicsPipeline; // Used to add shiny waypoints
     PipelineAndLayout m_UIArrowsGraphicsPipeline; // Used for UI arrows, commonly used in the Map Editor (WIP at the time of writing this comment).
     PipelineAndLayout m_RescaleGraphicsPipeline; // Used to rescale.
     PipelineAndLayout m_UIPanelGraphicsPipeline; // Used for UI Panels.
     PipelineAndLayout m_UILabelGraphicsPipeline; // Used for UI Labels.
 
-    BufferAndMemory m_FullscreenQuadVertexBuffer = {nullptr, nullptr};
+    BufferAndMemory m_FullscreenQuadVertexBuffer = {nullptr, {}};
 
     std::vector<RenderModel> m_RenderModels;    // to be used in the loop.
 
+    /* Every loaded mesh, m_SharedRenderMeshes only has the ones that can be shared (looked up by RenderMesh::key). */
+    std::vector<std::unique_ptr<RenderMesh>> m_RenderMeshes;
+    std::unordered_map<std::string, RenderMesh *> m_SharedRenderMeshes;
+
+    /* Every loaded texture, looked up by RenderTexture::key. */
+    std::unordered_map<std::string, std::unique_ptr<RenderTexture>> m_RenderTextures;
+
+    /* One sampler per parameter set, they live as long as the renderer. (maxAnisotropy, sampler) */
+    std::vector<std::pair<float, VkSampler>> m_SharedSamplers;
+
+    /* Model matrices of every RenderModel that's drawn this frame, grouped by mesh. [frame] */
+    std::array<BufferAndMemory, MAX_FRAMES_IN_FLIGHT> m_InstanceBuffers{};
+    std::array<Uint32, MAX_FRAMES_IN_FLIGHT> m_InstanceBufferCapacities{};
+
+    /* FrameUBO, written once a frame and shared by every draw that needs the camera. [frame] */
+    std::array<BufferAndMemory, MAX_FRAMES_IN_FLIGHT> m_FrameUBOBuffers{};
+
+    /* Every RenderModel in m_RenderModels has a proxy here, the proxy's userData is its index in m_RenderModels. */
+    AABBTree m_ModelTree;
+
+    /* Filled by CullRenderModels every frame, [renderModel index] */
+    std::vector<Uint8> m_RenderModelVisibility;
+    std::vector<Uint32> m_VisibleRenderModels;
+
+    /* Rebuilt and sorted every frame, kept around so they don't reallocate. The panel one only when the UI layout changes. */
+    DrawList m_MainDrawList;
+    DrawList m_UIPanelDrawList;
+
+    /* The visible panels are the first m_UIPanelInstanceCount instances, back to front, so all of them are a single draw. */
+    Uint32 m_UIPanelInstanceCount = 0;
+
+    /* Every laid out UI quad, panels first and then the glyphs of every label. Replaced as a whole when anything changes,
+     * the old one goes to the DeletionQueue since frames in flight might still be drawing it. */
+    BufferAndMemory m_UIInstanceBuffer{};
+
+    /* Set when a panel or label is added or removed, elements changing themselves bump UI::GenericElement::GetLayoutGeneration instead. */
+    bool m_UILayoutDirty = true;
+    Uint64 m_UILayoutGeneration = 0;
+
+    /* Skips redundant binds on the frame's command buffer, only for what's still recorded inline (the rescale subpass). */
+    CommandStateTracker m_CommandStateTracker;
+
+    /* Records the subpasses, the thread that renders is thread 0. */
+    std::unique_ptr<ThreadPool> m_RecordingThreadPool;
+    std::unique_ptr<SecondaryCommandRecorder> m_SecondaryCommandRecorder;
+
+    /* Filled by RecordSubpassInParallel, kept around so it doesn't reallocate. */
+    std::vector<VkCommandBuffer> m_SecondaryCommandBuffers;
+
+    /* Always there, it just doesn't do anything unless profile.GPU is on. */
+    std::unique_ptr<GPUProfiler> m_GPUProfiler;
+
+    struct {
+        Uint32 frame;
+        Uint32 mainPass, lighting, waypoints, arrows;
+        Uint32 rescalePass, rescale, uiPanels, uiLabels;
+    } m_ProfilerScopes;
+
+    double m_CPUFrameMilliseconds = 0.0;
+
+    UI::Label *m_ProfilerOverlay = nullptr;
+
     VkSwapchainKHR m_Swapchain = nullptr;
     std::vector<VkRenderPass> m_RenderPasses;
     std::vector<PipelineAndLayout> m_PipelineAndLayouts;
+    VkPipelineCache m_PipelineCache = nullptr;
 
     VkRenderPass m_MainRenderPass;
     VkFramebuffer m_RenderFramebuffer;
@@ -368,6 +648,24 @@ private:
 
     std::mutex m_SingleTimeCommandMutex;
 
+    /* Every VkDeviceMemory we use comes from here. */
+    std::unique_ptr<MemoryAllocator> m_Allocator;
+
+    /* Every staging copy goes through here, submitted once per frame (or earlier if someone waits on it). */
+    std::unique_ptr<UploadBatcher> m_UploadBatcher;
+
+    /* Resources that might still be used by a frame in flight are handed over here instead of waiting for the device to go idle. */
+    std::unique_ptr<DeletionQueue> m_DeletionQueue;
+
+    /* Every glyph bitmap of every label lives in here. */
+    std::unique_ptr<GlyphAtlas> m_GlyphAtlas;
+
+    /* The one FT_Library, and every font a label uses. */
+    std::unique_ptr<FontManager> m_FontManager;
+
+    /* Every mesh texture, only there with BindlessTextures on (and supported). */
+    std::unique_ptr<TextureTable> m_TextureTable;
+
     VkViewport m_RenderViewport;
     VkViewport m_DisplayViewport;
     VkRect2D m_RenderScissor;
@@ -377,13 +675,26 @@ private:
     std::vector<std::function<void()>> m_UpdateFunctions;
     std::vector<std::function<void(std::array<bool, 322>)>> m_FixedUpdateFunctions;
 
+    /* Headless only. [frame] */
+    std::array<BufferAndMemory, MAX_FRAMES_IN_FLIGHT> m_ReadbackBuffers{};
+    std::array<Sint64, MAX_FRAMES_IN_FLIGHT> m_ReadbackFrameNumbers{}; // -1 = nothing waiting
+
+    std::vector<std::function<void(Uint64, const Uint8 *, Uint32, Uint32)>> m_FrameReadbackListeners;
+
+    /* How many frames have been submitted. */
+    Uint64 m_FrameNumber = 0;
+
+    /* Set by DefragmentMemory, we defragment once the DeletionQueue has retired everything up to m_DefragmentFrameNumber. */
+    bool m_IsDefragmentPending = false;
+    Uint64 m_DefragmentFrameNumber = 0;
+
     // keymap, array of 322 booleans, should be indexed by the scancode (e.g. SDL_SCANCODE_UP, SDL_SCANCODE_A), returns whether the key had been pressed.
     std::array<bool, 322> m_KeyMap;
 
     // memory cleanup related, will not include any buffer that is already above (e.g. m_VertexBuffer)
     std::vector<VkImage> m_AllocatedImages;
     std::vector<VkBuffer> m_AllocatedBuffers;
-    std::vector<VkDeviceMemory> m_AllocatedMemory;
+    std::vector<MemoryAllocation> m_AllocatedMemory;
     std::vector<VkImageView> m_CreatedImageViews;
     std::vector<VkSampler> m_CreatedSamplers;
 };
@@ -503,6 +814,41 @@ struct NetworkingThreadState {
     std::thread thread;
 };
 
+/* A scene that's being imported by Engine::ImportSceneAsync. */
+class SceneLoad {
+public:
+    inline const std::string &GetPath() { return m_Path; };
+
+    /* Resolves to true once the scene replaced the old one, and false if it was cancelled. Rethrows whatever the import threw. */
+    inline std::shared_future<bool> GetResult() { return m_Result; };
+
+    /* Stops the load at its next step, from any thread. The old scene is only replaced once the new one is complete, so it stays as it was. */
+    inline void Cancel() { m_IsCancelled = true; };
+private:
+    friend class Engine;
+
+    std::string m_Path;
+
+    std::promise<bool> m_Promise;
+    std::shared_future<bool> m_Result;
+    std::function<void(bool)> m_OnDone;
+
+    std::atomic<bool> m_IsCancelled{false};
+
+    /* Set by the loader thread once it stops, whether it got through everything or not. Nothing below is touched by the main thread before that. */
+    std::atomic<bool> m_IsImported{false};
+    std::thread m_Thread;
+    std::exception_ptr m_Exception;
+
+    /* Owned by the load until it's applied, then by the engine. */
+    Object *m_RootObject = nullptr;
+    std::vector<Model *> m_Models;
+    std::unordered_map<std::string, TextureData> m_Textures;
+
+    /* m_Models before m_NextModel are loaded by the renderer (hidden), the old scene stays until all of them are. */
+    size_t m_NextModel = 0;
+};
+
 class Engine {
 public:
     ~Engine();
@@ -542,6 +888,12 @@ public:
     void RemoveCamera(Camera *cam);
 
     bool ImportScene(const std::string &path);
+
+    /* Imports path and decodes its textures on a background thread, then loads its models over as many frames as it takes,
+     * spending at most video.StreamingBudget milliseconds of every frame on it. The old scene is drawn until the new one is complete,
+     * then they're swapped within one frame. Loads are applied in the order they were started.
+     * onDone is called on the main thread with the value the result resolves to. Without a renderer, this is ImportScene. */
+    std::shared_ptr<SceneLoad> ImportSceneAsync(const std::string &path, const std::function<void(bool)> &onDone = {});
     void ExportScene(const std::string &path);
 
     void AttachCameraToConnection(Camera *cam, HSteamNetConnection conn);
@@ -598,6 +950,9 @@ private:
 
     std::string m_ScenePath = "";
 
+    /* Started by ImportSceneAsync, the front one is the only one that gets applied. */
+    std::deque<std::shared_ptr<SceneLoad>> m_SceneLoads;
+
     std::unordered_map<NetworkingEventType, std::vector<std::function<void(HSteamNetConnection)>>> m_EventTypeToListenerMap;
     std::vector<std::function<void(HSteamNetConnection, std::vector<std::byte> &)>> m_DataListeners;
 
@@ -606,7 +961,7 @@ private:
     std::vector<Networking_Event> m_NetworkingEvents;
     std::mutex m_NetworkingEventsLock;
     
-    Settings *m_Settings;
+    Settings *m_Settings = nullptr;
     Camera *m_MainCamera;
 
     /* Next 2 variables are for ProcessNetworkEvents */
@@ -638,6 +993,18 @@ private:
     */
     std::optional<Networking_Object> AddObjectToStatePacket(Object *obj, Networking_StatePacket &statePacket, bool includeChildren = true, bool isRecursive = false);
 
+    /* Unloads and deletes every object, and their models. */
+    void UnloadScene();
+
+    /* Called every frame, applies whatever ImportSceneAsync has finished importing until the frame's budget runs out. */
+    void ProcessSceneLoads();
+
+    /* Frees whatever load didn't hand over to the engine, then resolves its result and calls its onDone. */
+    void FinishSceneLoad(SceneLoad &load, bool succeeded);
+
+    /* This function is recursive. Does everything AddObject does except loading models, the whole tree's models are collected into models so they load in one go. */
+    void AddObjectTree(Object *object, std::vector<Model *> &models);
+
     /* Do not set isRecursive to true, This is only there to recursively add objs children BEFORE obj. This is a requirement in the protocol. */
     void AddObjectToStatePacketIfChanged(Object *obj, Networking_StatePacket &statePacket, bool includeChildren = true, bool isRecursive = false);
 
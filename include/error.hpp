@@ -19,6 +19,7 @@ namespace engineError {
     inline string PIPELINE_LAYOUT_CREATION_FAILURE = "Failed to create a graphics pipeline layout!";
     inline string FRAMEBUFFER_CREATION_FAILURE = "Failed to create framebuffers!";
     inline string COMMAND_POOL_CREATION_FAILURE = "Failed to create command pool!";
+    inline string QUERY_POOL_CREATION_FAILURE = "Failed to create a query pool!";
     inline string COMMAND_BUFFER_ALLOCATION_FAILURE = "Failed to allocate command buffer!";
     inline string COMMAND_BUFFER_BEGIN_FAILURE = "Failed to begin recording the command buffer!";
     inline string COMMAND_BUFFER_END_FAILURE = "Failed to end recording of the command buffer!";
@@ -41,8 +42,19 @@ namespace engineError {
     inline string CANT_FIND_ANY_FORMAT = "Tried to find best format, but none can be used!";
     inline string RENDERPASS_PIPELINE_EXISTS = "Tried to create a graphics pipeline for a renderpass that already has a graphics pipeline!";
     inline string SURFACE_CREATION_FAILURE = "Failed to create a surface, Reason: {}!";
+    inline string CAPTURE_DIRECTORY_CREATION_FAILURE = "Failed to create the capture directory {}, Reason: {}!";
+    inline string FRAME_CAPTURE_FAILURE = "Failed to write the captured frame to {}!";
     inline string NO_MATERIALS = "No materials found in model!";
     inline string WAIT_FOR_FENCES_FAILED = "Waiting for fences failed! {}";
+    inline string PIPELINE_CACHE_CREATION_FAILURE = "Failed to create a pipeline cache!";
+    inline string DEVICE_ALLOCATION_LIMIT_REACHED = "Reached the device memory allocation limit! ({} allocations)";
+    inline string GLYPH_TOO_LARGE = "Tried to add a {}x{} glyph, it doesn't fit in a glyph atlas page!";
+    inline string FREETYPE_INIT_FAILURE = "Failed to initialize FreeType!";
+    inline string FONT_LOADING_FAILURE = "Failed to locate the requested font ({}) in your system!";
+    inline string UNKNOWN_FONT_HANDLE = "Tried to use font handle {}, which isn't open!";
+    inline string TEXTURE_TABLE_FULL = "The bindless texture table is full! ({} textures)";
+    inline string DESCRIPTOR_POOL_CREATION_FAILURE = "Failed to create descriptor pool!";
+    inline string DESCRIPTOR_SET_ALLOCATION_FAILURE = "Failed to allocate descriptor set! ({})";
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef FONTMANAGER_HPP
+#define FONTMANAGER_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <filesystem>
+#include <ft2build.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include FT_FREETYPE_H
+
+typedef Uint32 FontHandle;
+
+#define INVALID_FONT_HANDLE UINT32_MAX
+
+/* Owns the one FT_Library, and every FT_Face anything uses. Faces are reference-counted and shared by everyone asking for the same (path, pixel size),
+ * font files are memory-mapped once no matter how many sizes they're opened at.
+ * Handles are never reused, so a released handle can't suddenly point to another font. */
+class FontManager {
+public:
+    /* Throws std::runtime_error if FreeType fails to initialize. */
+    FontManager();
+
+    /* Whatever is still acquired is closed too. */
+    ~FontManager();
+
+    /* Opens the font at pixelSize, or takes another reference to it if it's already open. Throws std::runtime_error if the font can't be loaded. */
+    FontHandle Acquire(const std::filesystem::path &path, Uint32 pixelSize);
+
+    /* The face is closed (and the file unmapped) once every reference to it has been released. */
+    void Release(FontHandle handle);
+
+    FT_Face GetFace(FontHandle handle);
+
+    /* Same family, style and height means the same ID, whatever the path or the size. */
+    Uint32 GetFaceID(FontHandle handle);
+
+    Uint32 GetPixelSize(FontHandle handle);
+private:
+    struct MappedFile {
+        void *data;
+        size_t size;
+
+        Uint32 referenceCount;
+    };
+
+    struct Font {
+        std::string path;
+        Uint32 pixelSize;
+
+        FT_Face face;
+        Uint32 faceID;
+
+        Uint32 referenceCount;
+    };
+
+    /* Maps path if it isn't already, and takes a reference to it. */
+    MappedFile &MapFile(const std::string &path);
+    void UnmapFile(const std::string &path);
+
+    Font &GetFont(FontHandle handle);
+
+    FT_Library m_FTLibrary = nullptr;
+
+    std::unordered_map<std::string, MappedFile> m_MappedFiles;
+    std::unordered_map<FontHandle, Font> m_Fonts;
+
+    /* "path:pixelSize" to the handle that's open for it. */
+    std::unordered_map<std::string, FontHandle> m_OpenFonts;
+
+    /* Family, style and height to face ID. */
+    std::unordered_map<std::string, Uint32> m_FaceIDs;
+
+    FontHandle m_NextHandle = 0;
+};
+
+#endif
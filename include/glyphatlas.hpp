@@ -0,0 +1,91 @@
+#ifndef GLYPHATLAS_HPP
+#define GLYPHATLAS_HPP
+
+#include "allocator.hpp"
+#include "deletion.hpp"
+#include "upload.hpp"
+
+#include <SDL3/SDL_stdinc.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Every page is a square 8-bit image this big, a glyph bigger than that can't be packed. */
+#define GLYPH_ATLAS_PAGE_SIZE 1024
+
+/* Empty texels kept around every glyph, so linear filtering never picks up its neighbours. */
+#define GLYPH_ATLAS_PADDING 1
+
+/* Where a glyph ended up in the atlas. */
+struct GlyphAtlasRegion {
+    Uint32 page;
+
+    /* (u0, v0, u1, v1), normalized. */
+    glm::vec4 uvRect;
+};
+
+/* Packs glyph bitmaps into a few big pages instead of giving every glyph its own image.
+ * Glyphs are packed into shelves, rows as tall as the first glyph that opened them, and a new page is opened once a page is full.
+ * Pages keep a CPU copy and are re-uploaded as a whole on Flush. The re-upload goes into a brand new image, the one frames in flight might
+ * still be sampling is handed to the DeletionQueue, so adding glyphs never has to wait on the GPU. */
+class GlyphAtlas {
+public:
+    /* format has to be a single 8-bit channel, R8_SRGB or R8_UNORM. */
+    GlyphAtlas(VkDevice device, MemoryAllocator *allocator, UploadBatcher *uploadBatcher, DeletionQueue *deletionQueue, VkFormat format);
+    ~GlyphAtlas();
+
+    /* pixels is width * height 8-bit coverage values, rows are pitch bytes apart. Throws std::runtime_error if it doesn't fit in a page. */
+    GlyphAtlasRegion Add(Uint32 width, Uint32 height, const Uint8 *pixels, Sint32 pitch);
+
+    /* Uploads every page that changed since the last call, has to be called before anything is recorded with GetPageView in a frame. */
+    void Flush();
+
+    inline Uint32 GetPageCount() { return m_Pages.size(); };
+
+    /* Pages that haven't been flushed yet return nullptr. */
+    inline VkImageView GetPageView(Uint32 page) { return m_Pages[page].imageView; };
+
+    /* Shared by every page. */
+    inline VkSampler GetSampler() { return m_Sampler; };
+private:
+    struct Shelf {
+        Uint32 y;
+        Uint32 height;
+
+        /* Where the next glyph on this shelf goes. */
+        Uint32 x;
+    };
+
+    struct Page {
+        std::vector<Uint8> pixels;
+        std::vector<Shelf> shelves;
+
+        /* Where the next shelf goes. */
+        Uint32 nextShelfY = 0;
+
+        VkImage image = nullptr;
+        MemoryAllocation memory;
+        VkImageView imageView = nullptr;
+        UploadToken uploadToken = 0;
+
+        bool isDirty = false;
+    };
+
+    /* Finds room for a width * height rectangle (padding included) in page, returns false if there's none. */
+    bool Pack(Page &page, Uint32 width, Uint32 height, Uint32 &x, Uint32 &y);
+
+    void UploadPage(Page &page);
+    void DestroyPage(Page &page, bool deferred);
+
+    VkDevice m_Device;
+    MemoryAllocator *m_Allocator;
+    UploadBatcher *m_UploadBatcher;
+    DeletionQueue *m_DeletionQueue;
+
+    VkFormat m_Format;
+    VkSampler m_Sampler = nullptr;
+
+    std::vector<Page> m_Pages;
+};
+
+#endif
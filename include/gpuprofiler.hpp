@@ -0,0 +1,106 @@
+#ifndef GPUPROFILER_HPP
+#define GPUPROFILER_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <array>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#define GPU_PROFILER_MAX_SCOPES 16
+
+/* How many frames the rolling averages are taken over. */
+#define GPU_PROFILER_HISTORY 64
+
+#define GPU_PROFILER_NO_SCOPE UINT32_MAX
+
+/* The statistics asked for when pipeline statistics are enabled, GPUProfilerResult::statistics follows this order. */
+#define GPU_PROFILER_STATISTIC_FLAGS (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | \
+                                      VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | \
+                                      VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+                                      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+                                      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT)
+#define GPU_PROFILER_STATISTIC_COUNT 5
+
+struct GPUProfilerResult {
+    std::string name;
+
+    double averageMilliseconds;
+    double lastMilliseconds;
+
+    /* Only filled for scopes that had statistics queried, averaged the same way. */
+    bool hasStatistics;
+    std::array<double, GPU_PROFILER_STATISTIC_COUNT> statistics;
+};
+
+/* Times named scopes of a frame on the GPU with timestamp queries, and optionally counts what went through the pipeline in them.
+ * Every frame in flight has its own query pools, a frame's results are only read once its fence has been waited on, so nothing ever stalls,
+ * they just show up MAX_FRAMES_IN_FLIGHT frames late. Does nothing if the graphics queue can't write timestamps. */
+class GPUProfiler {
+public:
+    /* timestampPeriod is VkPhysicalDeviceLimits::timestampPeriod, timestampValidBits comes from the graphics queue family.
+     * pipelineStatistics needs the pipelineStatisticsQuery feature, and inheritedQueries too if secondary command buffers run inside a statistics scope. */
+    GPUProfiler(VkDevice device, float timestampPeriod, Uint32 timestampValidBits, Uint32 frameCount, bool pipelineStatistics);
+    ~GPUProfiler();
+
+    /* Picks up the results frameIndex left behind last time and resets its queries, has to be recorded before any scope and outside of a render pass. */
+    void BeginFrame(VkCommandBuffer commandBuffer, Uint32 frameIndex);
+
+    /* Same name, same scope, scopes are registered the first time they're asked for. */
+    Uint32 GetScope(const std::string &name);
+
+    /* Each can only be written once per frame, Begin and End can be recorded into different command buffers as long as they run in that order. */
+    void WriteBeginTimestamp(VkCommandBuffer commandBuffer, Uint32 scope);
+    void WriteEndTimestamp(VkCommandBuffer commandBuffer, Uint32 scope);
+
+    /* Primary command buffers only, and secondary command buffers executed in between have to inherit GetStatisticFlags. */
+    void BeginStatistics(VkCommandBuffer commandBuffer, Uint32 scope);
+    void EndStatistics(VkCommandBuffer commandBuffer, Uint32 scope);
+
+    inline bool IsEnabled() { return m_TimestampPool != nullptr; };
+    inline VkQueryPipelineStatisticFlags GetStatisticFlags() { return m_StatisticsPool ? GPU_PROFILER_STATISTIC_FLAGS : 0; };
+
+    /* In the order the scopes were registered, scopes that haven't come back from the GPU yet are left out. */
+    std::vector<GPUProfilerResult> GetResults();
+
+    void PrintResults();
+private:
+    struct Scope {
+        std::string name;
+
+        std::array<double, GPU_PROFILER_HISTORY> milliseconds{};
+        std::array<std::array<double, GPU_PROFILER_STATISTIC_COUNT>, GPU_PROFILER_HISTORY> statistics{};
+        Uint32 sampleCount = 0;
+        Uint32 statisticsSampleCount = 0;
+        Uint32 nextSample = 0;
+        Uint32 nextStatisticsSample = 0;
+    };
+
+    /* What got written into a frame's queries, so unwritten ones are never read. */
+    struct FrameQueries {
+        std::array<bool, GPU_PROFILER_MAX_SCOPES> beginWritten{};
+        std::array<bool, GPU_PROFILER_MAX_SCOPES> endWritten{};
+        std::array<bool, GPU_PROFILER_MAX_SCOPES> statisticsWritten{};
+    };
+
+    void CollectResults(Uint32 frameIndex);
+
+    /* Timestamps are begin/end pairs, a pair per scope. */
+    inline Uint32 GetTimestampQuery(Uint32 frameIndex, Uint32 scope) { return (frameIndex * GPU_PROFILER_MAX_SCOPES + scope) * 2; };
+    inline Uint32 GetStatisticsQuery(Uint32 frameIndex, Uint32 scope) { return frameIndex * GPU_PROFILER_MAX_SCOPES + scope; };
+
+    VkDevice m_Device;
+
+    VkQueryPool m_TimestampPool = nullptr;
+    VkQueryPool m_StatisticsPool = nullptr;
+
+    double m_NanosecondsPerTick;
+    Uint64 m_TimestampMask;
+
+    std::vector<Scope> m_Scopes;
+    std::vector<FrameQueries> m_FrameQueries;
+
+    Uint32 m_FrameIndex = 0;
+};
+
+#endif
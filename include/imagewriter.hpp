@@ -0,0 +1,14 @@
+#ifndef IMAGEWRITER_HPP
+#define IMAGEWRITER_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <string>
+
+/* Writes 8-bit RGBA pixels (rows top to bottom, no padding) as a PNG.
+ * The image data isn't compressed (stored deflate blocks), it's meant for captures and golden images, not for shipping. Returns false if the file couldn't be written. */
+bool writePNG(const std::string &path, const Uint8 *pixels, Uint32 width, Uint32 height);
+
+/* Writes size bytes as they are, no header. */
+bool writeRawImage(const std::string &path, const Uint8 *pixels, size_t size);
+
+#endif
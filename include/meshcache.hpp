@@ -0,0 +1,118 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include "model.hpp"
+
+#include <SDL3/SDL_stdinc.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+/* Bump this whenever the layout of anything below changes, older cache files are then just re-cooked. */
+#define MESH_CACHE_VERSION 2
+
+struct glTFPhysicsMaterial {
+    float staticFriction;
+    float dynamicFriction;
+
+    float restitution;
+};
+
+enum glTFColliderShape : Uint8 {
+    /* A shape we don't know how to build, the node doesn't get a rigid body. */
+    GLTF_COLLIDER_NONE,
+    GLTF_COLLIDER_BOX,
+    GLTF_COLLIDER_TRIANGLE_MESH
+};
+
+/* Only the data, createColliderShape (util.hpp) turns it into a bullet shape. */
+struct glTFColliderInfo {
+    glTFColliderShape shape = GLTF_COLLIDER_NONE;
+
+    glm::vec3 boxSize{};
+
+    /* GLTF_COLLIDER_TRIANGLE_MESH only, 3 indices per triangle. */
+    std::vector<glm::vec3> vertices;
+    std::vector<Uint32> indices;
+
+    glTFPhysicsMaterial physicsMaterial{};
+
+    /* TODO: I don't see a point in collisionFilter but it could be useful. */
+};
+
+struct glTFRigidBody {
+    /* If this is 0, then the RigidBody is static. */
+    Uint64 mass = 0;
+
+    glTFColliderInfo colliderInfo;
+};
+
+struct CookedCamera {
+    float aspect;
+    glm::vec3 up;
+
+    float yaw, pitch;
+
+    bool isOrthographic;
+
+    /* degrees, perspective cameras only. */
+    float FOV;
+    float orthographicWidth;
+};
+
+struct CookedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<Uint32> indices;
+
+    std::string diffuseMapPath;
+    glm::vec3 diffuse;
+};
+
+/* A node straight out of the source file, the transform is exactly what assimp decomposed. */
+struct CookedNode {
+    /* -1 for the root node. */
+    Sint32 parent;
+
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+
+    /* Indices into CookedScene::meshes, which are the source file's own mesh indices. */
+    std::vector<Uint32> meshes;
+
+    std::optional<CookedCamera> camera;
+    std::optional<glTFRigidBody> rigidBody;
+};
+
+/* Everything ImportFromFile needs from a source file, with assimp out of the picture.
+ * Nodes are in depth-first order, a node's index is its source ID and its parent always comes before it. */
+struct CookedScene {
+    std::vector<CookedNode> nodes;
+    std::vector<CookedMesh> meshes;
+};
+
+/* A file the importer read besides the source file itself (an .mtl, a glTF's .bin), changing it changes the cooked scene just the same. */
+struct MeshCacheDependency {
+    std::string path;
+
+    /* 0 if the file couldn't be read, so one showing up later still counts as a change. */
+    Uint64 hash;
+};
+
+/* Hashes the contents of a whole file, returns 0 if it can't be read. */
+Uint64 hashFileContents(const std::string &path);
+
+/* Where the cooked version of sourcePath lives in cacheDirectory, named after the hash of its absolute path. */
+std::string getMeshCachePath(const std::string &cacheDirectory, const std::string &sourcePath);
+
+/* Maps cachePath and reads it into scene. Returns false if there's no cache file, or if it's from another version, another source file,
+ * or older contents of it or of any of its dependencies (sourceHash or a dependency's hash doesn't match), or if it's cut short.
+ * scene is left in an unspecified state then. */
+bool readMeshCache(const std::string &cachePath, const std::string &sourcePath, Uint64 sourceHash, CookedScene &scene);
+
+/* Writes scene to a temporary file and renames it over cachePath, so a reader never sees half a cache. Returns false if it couldn't. */
+bool writeMeshCache(const std::string &cachePath, const std::string &sourcePath, Uint64 sourceHash, const std::vector<MeshCacheDependency> &dependencies, const CookedScene &scene);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MESHOPT_HPP
+#define MESHOPT_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+/* The LRU cache Forsyth's scoring assumes, bigger than any real one so it does well on all of them. */
+#define FORSYTH_CACHE_SIZE 32
+
+/* The FIFO cache analyzeVertexCache simulates, about what a real post-transform cache holds. */
+#define VERTEX_CACHE_FIFO_SIZE 16
+
+/* How much worse optimizeOverdraw is allowed to make the ACMR of a cluster, 1.05 = 5%. */
+#define OVERDRAW_THRESHOLD 1.05f
+
+struct VertexCacheStatistics {
+    /* Average cache miss ratio, transformed vertices per triangle. 3 is the worst, 0.5 is about the best a regular grid gets. */
+    float acmr = 0.0f;
+
+    /* Average transformed vertex ratio, transformed vertices per vertex the mesh uses. 1 is perfect. */
+    float atvr = 0.0f;
+
+    Uint32 transformedVertexCount = 0;
+};
+
+/* Runs indices through a FIFO cache of cacheSize vertices and counts how many times the vertex shader would run. */
+VertexCacheStatistics analyzeVertexCache(const std::vector<Uint32> &indices, Uint32 vertexCount, Uint32 cacheSize = VERTEX_CACHE_FIFO_SIZE);
+
+/* Reorders the triangles in indices with Tom Forsyth's linear-speed vertex cache optimization, so vertices get reused while they're still cached.
+ * indices has to be a triangle list, every index below vertexCount. */
+void optimizeVertexCache(std::vector<Uint32> &indices, Uint32 vertexCount);
+
+/* Splits indices into clusters where the vertex cache restarts anyway, and sorts them so the ones facing outwards come first.
+ * Those usually end up in front, so less of the mesh gets shaded only to be covered up. Run it after optimizeVertexCache, the clusters come from its order.
+ * Triangles inside a cluster keep their order, the ACMR goes up by about threshold at most. */
+void optimizeOverdraw(std::vector<Uint32> &indices, const std::vector<glm::vec3> &positions, float threshold = OVERDRAW_THRESHOLD);
+
+/* Renumbers the vertices in the order indices first uses them, so they're fetched front to back. Rewrites indices and returns the old index of every
+ * new vertex, vertices nothing uses are left out. Run it last, it doesn't change the triangle order. */
+std::vector<Uint32> optimizeVertexFetch(std::vector<Uint32> &indices, Uint32 vertexCount);
+
+#endif
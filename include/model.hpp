@@ -11,6 +11,7 @@
 #include <glm/ext/vector_float2.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -38,6 +39,24 @@ struct Vertex {
     glm::vec2 TexCoord;
 };
 
+/* Half the size of Vertex, for meshes that don't need full precision. The shader puts it back together with the mesh's QuantizationParameters. */
+struct QuantizedVertex {
+    /* R16G16B16A16_UNORM, where the position is in the mesh's bounding box. w is unused. */
+    Uint64 Position;
+
+    /* R16G16_SNORM, the normal folded onto an octahedron. */
+    Uint32 Normal;
+
+    /* R16G16_SFLOAT. */
+    Uint32 TexCoord;
+};
+
+/* position = Offset + quantized position * Scale, which is the bounding box's lower corner and size. */
+struct QuantizationParameters {
+    glm::vec4 Offset;
+    glm::vec4 Scale;
+};
+
 struct SimpleVertex {
     glm::vec2 Position;
     //glm::vec3 Color;  // might add later
@@ -74,6 +93,109 @@ inline struct array<VkVertexInputAttributeDescription, 3> getVertexAttributeDesc
     return attributeDescriptions;
 }
 
+inline struct VkVertexInputBindingDescription getQuantizedVertexBindingDescription() {
+    VkVertexInputBindingDescription bindingDescrption{};
+    bindingDescrption.binding = 0;
+    bindingDescrption.stride = sizeof(QuantizedVertex);
+    bindingDescrption.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescrption;
+}
+
+/* Same locations as getVertexAttributeDescriptions, so both go into the same shader. */
+inline struct array<VkVertexInputAttributeDescription, 3> getQuantizedVertexAttributeDescriptions() {
+    array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(QuantizedVertex, Position);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(QuantizedVertex, Normal);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(QuantizedVertex, TexCoord);
+
+    return attributeDescriptions;
+}
+
+/* Maps a unit vector to [-1, 1]^2, lighting.vert has the way back. Zero vectors come back as +Z. */
+inline glm::vec2 encodeOctahedral(glm::vec3 normal) {
+    float length = glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+
+    if (length == 0.0f)
+        return glm::vec2(0.0f);
+
+    normal /= length;
+
+    // the lower half gets folded over the diagonals.
+    if (normal.z < 0.0f) {
+        glm::vec2 folded = glm::vec2(1.0f) - glm::abs(glm::vec2(normal.y, normal.x));
+
+        return glm::vec2(normal.x >= 0.0f ? folded.x : -folded.x, normal.y >= 0.0f ? folded.y : -folded.y);
+    }
+
+    return glm::vec2(normal.x, normal.y);
+}
+
+/* The bounding box ([0] = higher, [1] = lower) as the shader wants it. Flat axes get a scale of 0, every position on them is the same anyway. */
+inline QuantizationParameters getQuantizationParameters(const std::array<glm::vec3, 2> &boundingBox) {
+    return {glm::vec4(boundingBox[1], 0.0f), glm::vec4(boundingBox[0] - boundingBox[1], 0.0f)};
+}
+
+inline QuantizedVertex quantizeVertex(const Vertex &vertex, const QuantizationParameters &parameters) {
+    glm::vec3 scale = glm::vec3(parameters.Scale);
+    glm::vec3 inverseScale = glm::vec3(scale.x > 0.0f ? 1.0f / scale.x : 0.0f, scale.y > 0.0f ? 1.0f / scale.y : 0.0f, scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+
+    QuantizedVertex quantizedVertex;
+    quantizedVertex.Position = glm::packUnorm4x16(glm::vec4((vertex.Position - glm::vec3(parameters.Offset)) * inverseScale, 0.0f));
+    quantizedVertex.Normal = glm::packSnorm2x16(encodeOctahedral(vertex.Normal));
+    quantizedVertex.TexCoord = glm::packHalf2x16(vertex.TexCoord);
+
+    return quantizedVertex;
+}
+
+/* Per-instance data of the lighting pipeline, comes from binding 1. */
+struct InstanceData {
+    glm::mat4 ModelMatrix;
+
+    /* Where the mesh's texture is in the bindless texture table, ignored without one. */
+    Uint32 TextureIndex;
+};
+
+inline struct VkVertexInputBindingDescription getInstanceBindingDescription() {
+    VkVertexInputBindingDescription bindingDescrption{};
+    bindingDescrption.binding = 1;
+    bindingDescrption.stride = sizeof(InstanceData);
+    bindingDescrption.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescrption;
+}
+
+/* A mat4 attribute takes up 4 locations, one for every column. The texture index comes right after. */
+inline struct array<VkVertexInputAttributeDescription, 5> getInstanceAttributeDescriptions() {
+    array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+
+    for (Uint32 i = 0; i < 4; i++) {
+        attributeDescriptions[i].binding = 1;
+        attributeDescriptions[i].location = 3 + i;
+        attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[i].offset = offsetof(InstanceData, ModelMatrix) + sizeof(glm::vec4) * i;
+    }
+
+    attributeDescriptions[4].binding = 1;
+    attributeDescriptions[4].location = 7;
+    attributeDescriptions[4].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[4].offset = offsetof(InstanceData, TextureIndex);
+
+    return attributeDescriptions;
+}
+
 inline struct VkVertexInputBindingDescription getSimpleVertexBindingDescription() {
     VkVertexInputBindingDescription bindingDescrption{};
     bindingDescrption.binding = 0;
@@ -99,6 +221,21 @@ inline struct array<VkVertexInputAttributeDescription, 2> getSimpleVertexAttribu
     return attributeDescriptions;
 }
 
+/* Transforms a [0] = higher, [1] = lower bounding box and returns the world-space box that contains it.
+ * Only the center gets the full matrix, the extents go through the absolute value of the rotation/scale part, no need to transform all 8 corners. */
+inline std::array<glm::vec3, 2> transformBoundingBox(const std::array<glm::vec3, 2> &boundingBox, const glm::mat4 &matrix) {
+    glm::vec3 center = (boundingBox[0] + boundingBox[1]) * 0.5f;
+    glm::vec3 extents = (boundingBox[0] - boundingBox[1]) * 0.5f;
+
+    glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+    glm::vec3 newExtents = glm::vec3(0.0f);
+
+    for (int column = 0; column < 3; column++)
+        newExtents += glm::abs(glm::vec3(matrix[column])) * extents[column];
+
+    return {newCenter + newExtents, newCenter - newExtents};
+}
+
 class Mesh;
 
 class Model 
@@ -110,13 +247,13 @@ public:
 
     Mesh processMesh(aiMesh *mesh, const aiScene *scene);
 
-    /* Return the models Bounding Box, also transforms the bounding box with the Model Matrix. */
-    std::array<glm::vec3, 2> GetBoundingBox() { return {glm::vec4(m_BoundingBox[0], 0.0f) * GetModelMatrix(), glm::vec4(m_BoundingBox[1], 0.0f) * GetModelMatrix()}; };
+    /* Return the models Bounding Box in world-space, it's only recalculated when the model matrix changes. */
+    std::array<glm::vec3, 2> GetBoundingBox();
 
     /* Return the models Bounding Box, with no transformations, This should not be used for ray checks and such. */
     constexpr std::array<glm::vec3, 2> GetRawBoundingBox() { return m_BoundingBox; };
 
-    constexpr void SetBoundingBox(std::array<glm::vec3, 2> boundingBox) { m_BoundingBox = boundingBox; };
+    constexpr void SetBoundingBox(std::array<glm::vec3, 2> boundingBox) { m_BoundingBox = boundingBox; m_IsWorldBoundingBoxValid = false; };
 
     /* Only 1 object can be attached at a time. */
     void SetObjectAttachment(Object *object);
@@ -133,10 +270,15 @@ private:
 
     // [0] = higher
     // [1] = lower
-    std::array<glm::vec3, 2> m_BoundingBox;
+    std::array<glm::vec3, 2> m_BoundingBox = {glm::vec3(-INFINITY), glm::vec3(INFINITY)};
 
     glm::mat4 m_ModelMatrix = glm::mat4(1.0f);
 
+    /* m_BoundingBox transformed by m_WorldBoundingBoxMatrix. */
+    std::array<glm::vec3, 2> m_WorldBoundingBox;
+    glm::mat4 m_WorldBoundingBoxMatrix;
+    bool m_IsWorldBoundingBoxValid = false;
+
     //Texture loadDefaultTexture(string typeName);
 };
 
@@ -147,6 +289,13 @@ public:
     vector<Vertex>       vertices;
     vector<Uint32>       indices;
     path                 diffuseMapPath;
+
+    /* Where the mesh came from, meshes with the same source file and index get shared by the renderer. Empty/-1 if it wasn't loaded from a file. */
+    string               sourceFile;
+    int                  sourceMeshIndex = -1;
+
+    /* Uploaded as QuantizedVertex instead of Vertex, only the GPU copy loses precision. Has to be set before the renderer loads it. */
+    bool                 isQuantized = false;
     // glm::vec3            ambient;
     // glm::vec3            specular;
     glm::vec3            diffuse;
@@ -157,9 +306,9 @@ public:
     Mesh() = default;
 
     Mesh(Model &parent, vector<Vertex> vertices, vector<Uint32> indices, path diffuseMapPath, /*float shininess = 0.0, float roughness = 0.0, float metallic = 0.0, glm::vec3 ambient = glm::vec3(0.2f, 0.2f, 0.2f), glm::vec3 specular = glm::vec3(1.0f, 1.0f, 1.0f), */glm::vec3 diffuse = glm::vec3(1.0f, 1.0f, 1.0f)) : m_Parent(&parent) {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->diffuseMapPath = diffuseMapPath;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->diffuseMapPath = std::move(diffuseMapPath);
         // this->ambient = ambient;
         // this->specular = specular;
         this->diffuse = diffuse;
@@ -167,9 +316,7 @@ public:
         // this->roughness = roughness;
         // this->metallic = metallic;
 
-        for (Vertex &vertex : vertices) {
-            fmt::println("{} {} {}", vertex.Position.x, vertex.Position.y, vertex.Position.z);
-
+        for (const Vertex &vertex : this->vertices) {
             m_BoundingBox[0].x = glm::max(vertex.Position.x, m_BoundingBox[0].x);
             m_BoundingBox[1].x = glm::min(vertex.Position.x, m_BoundingBox[1].x);
 
@@ -186,8 +333,11 @@ public:
             throw std::runtime_error("Tried to get the bounding box of an orphaned Mesh! (a Model parent is required for this)");
         }
 
-        return {glm::vec4(m_BoundingBox[0], 0.0f) * m_Parent->GetModelMatrix(), glm::vec4(m_BoundingBox[1], 0.0f) * m_Parent->GetModelMatrix()};
+        return transformBoundingBox(m_BoundingBox, m_Parent->GetModelMatrix());
     }
+
+    /* Same as Model::GetRawBoundingBox, no transformations. */
+    constexpr std::array<glm::vec3, 2> GetRawBoundingBox() { return m_BoundingBox; };
 private:
     Model *m_Parent = nullptr;
 
@@ -3,11 +3,14 @@
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 #include "camera.hpp"
 #include "model.hpp"
+#include <atomic>
 #include <functional>
 #include <glm/gtc/quaternion.hpp>
 #include <memory>
 #include <optional>
 
+struct CookedScene;
+
 class Object {
 public:
     ~Object();
@@ -16,8 +19,11 @@ public:
 
     /* Loads a model/scene file with assimp, preferrably glTF 2.0 files.
         Nodes are converted to objects and their meshes are converted into a Model attachment.
-        If there's atleast 1 camera, and if primaryCamOutput is set, it will set primaryCamOutput to the first camera it sees. primaryCamOutput MUST be null!! */
-    void ImportFromFile(const std::string &path, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput = {});
+        If there's atleast 1 camera, and if primaryCamOutput is set, it will set primaryCamOutput to the first camera it sees. primaryCamOutput MUST be null!!
+        If cacheDirectory isn't empty, the cooked file is kept there and assimp only runs again once the file's contents change.
+        If quantizeVertices is set, every mesh gets uploaded as QuantizedVertex, set Mesh::isQuantized yourself to pick per mesh.
+        If verbose is set, it prints how much cooking improved each mesh's vertex cache use. */
+    void ImportFromFile(const std::string &path, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput = {}, const std::string &cacheDirectory = "", bool quantizeVertices = false, bool verbose = false);
 
     /* Gets the source path if the object had ImportFromFile called on it.
         Returns empty if the object didn't come from a file or is the child of an object that did. */
@@ -65,7 +71,8 @@ public:
     int GetObjectID();
     void SetObjectID(int objectID);
 private:
-    void ProcessNode(aiNode *node, const aiScene *scene, int &sourceID, Object *parent = nullptr, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput = {});
+    /* Turns every node into an object, the root node is this object. */
+    void BuildFromCookedScene(const CookedScene &scene, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput = {}, bool quantizeVertices = false);
 
     void SynchronizePhysicsTransform();
 
@@ -89,5 +96,6 @@ private:
 
     std::shared_ptr<btRigidBody> m_RigidBody;
 
-    static int HighestObjectID;
+    /* Scenes can be imported on a background thread, so objects can be created on several threads at once. */
+    static std::atomic<int> HighestObjectID;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include "drawlist.hpp"
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Hands out secondary command buffers to recording threads. Every thread gets its own command pool for every frame in flight, so threads never share a pool
+ * and a frame's pools can be reset all at once instead of resetting buffers one by one. */
+class SecondaryCommandRecorder {
+public:
+    SecondaryCommandRecorder(VkDevice device, Uint32 queueFamily, Uint32 threadCount, Uint32 frameCount);
+    ~SecondaryCommandRecorder();
+
+    /* Resets every pool of frameIndex, the buffers from last time are reused. Only call this once the frame's fence has been waited on. */
+    void BeginFrame(Uint32 frameIndex);
+
+    /* Begins a secondary command buffer that continues subpass of renderPass, it's only allowed to be touched by threadIndex until it's ended.
+     * framebuffer is optional, but it's faster for some drivers. */
+    VkCommandBuffer Begin(Uint32 threadIndex, VkRenderPass renderPass, Uint32 subpass, VkFramebuffer framebuffer);
+    void End(VkCommandBuffer commandBuffer);
+
+    /* The tracker of threadIndex, Begin already points it at the new buffer. */
+    inline CommandStateTracker &GetStateTracker(Uint32 threadIndex) { return m_Threads[threadIndex].stateTracker; };
+
+    /* Summed over every thread, since the last BeginFrame. */
+    Uint32 GetBindCount();
+    Uint32 GetSkippedBindCount();
+
+    inline Uint32 GetThreadCount() { return m_Threads.size(); };
+
+    /* Secondary buffers executed while a pipeline statistics query is active have to say so, needs the inheritedQueries feature. */
+    inline void SetInheritedPipelineStatistics(VkQueryPipelineStatisticFlags pipelineStatistics) { m_InheritedPipelineStatistics = pipelineStatistics; };
+private:
+    struct ThreadContext {
+        /* [frame] */
+        std::vector<VkCommandPool> commandPools;
+        std::vector<std::vector<VkCommandBuffer>> commandBuffers;
+        std::vector<Uint32> usedCommandBuffers;
+
+        CommandStateTracker stateTracker;
+    };
+
+    VkDevice m_Device;
+
+    std::vector<ThreadContext> m_Threads;
+
+    Uint32 m_FrameIndex = 0;
+
+    VkQueryPipelineStatisticFlags m_InheritedPipelineStatistics = 0;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SDF_HPP
+#define SDF_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <vector>
+
+/* The pixel size every distance field glyph is generated at, whatever size it ends up being drawn at. */
+#define SDF_GLYPH_SIZE 48
+
+/* How far (in SDF_GLYPH_SIZE pixels) the field reaches on either side of an edge, it's also the border added around every glyph. */
+#define SDF_SPREAD 6
+
+/* Glyphs are rasterized this many times bigger than SDF_GLYPH_SIZE, so the edges in the field aren't stair-stepped. */
+#define SDF_OVERSAMPLE 4
+
+/* Turns an 8-bit coverage bitmap into a signed distance field oversample times smaller, with a spread pixel border all around.
+ * 128 is the edge, anything above it is inside. Uses an exact euclidean distance transform, so the cost is linear in the bitmap size.
+ * Only touches its arguments, so it's safe to run on any thread. */
+std::vector<Uint8> generateSignedDistanceField(const Uint8 *coverage, Uint32 width, Uint32 height, Sint32 pitch, Uint32 spread, Uint32 oversample, Uint32 &fieldWidth, Uint32 &fieldHeight);
+
+#endif
@@ -4,6 +4,7 @@
 #include "fmt/core.h"
 
 #include <SDL3/SDL_stdinc.h>
+#include <string>
 #include <string_view>
 
 using std::string_view;
@@ -17,10 +18,27 @@ public:
     bool Fullscreen, IgnoreRenderResolution;
     float FieldOfView;
     float CameraNear;
+    std::string PipelineCachePath;
+    std::string MeshCacheDirectory; // cooked models go here, empty = import with assimp every time
+    bool QuantizeVertices;          // imported meshes are uploaded with 16-bit positions, octahedral normals and half float UVs
+    float StreamingBudget;          // ms of every frame spent swapping in a scene from ImportSceneAsync
+    Uint32 RecordingThreads;
+    bool SDFText;                   // glyphs are distance fields, one atlas serves every text size
+    bool BindlessTextures;          // every texture in one descriptor array, needs descriptor indexing
+
+// Headless, no window or swapchain, frames are read back instead of presented
+    bool Headless;
+    Uint32 HeadlessFrameCount;      // 0 = run until something quits
+    std::string CaptureDirectory;   // empty = don't write frames anywhere
+    std::string CaptureFormat;      // "png" or "raw"
 
 // Profiling information
     bool ReportFPS;
     bool Verbose;
+    bool ProfileGPU;
+    bool PipelineStatistics;        // needs ProfileGPU
+    bool ProfilerOverlay;           // needs ProfileGPU
+    std::string ProfilerOverlayFont;
 
 // Input
     float MouseSensitivity;
@@ -0,0 +1,40 @@
+#ifndef TEXTUREDATA_HPP
+#define TEXTUREDATA_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Where one mip level is in TextureData::data. */
+struct TextureLevel {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+
+    Uint32 width;
+    Uint32 height;
+};
+
+/* Every mip level of a texture, tightly packed one after the other, biggest first. */
+struct TextureData {
+    VkFormat format;
+
+    std::vector<Uint8> data;
+    std::vector<TextureLevel> levels;
+};
+
+/* How many levels a full mip chain down to 1x1 has. */
+Uint32 getMipLevelCount(Uint32 width, Uint32 height);
+
+/* Wraps width * height RGBA8 pixels as the first level of a TextureData. */
+TextureData makeRGBA8TextureData(const Uint8 *pixels, Uint32 width, Uint32 height, VkFormat format);
+
+/* Box filters the first level of an R8G8B8A8 texture down to 1x1, replacing any levels after it.
+ * sRGB textures are averaged in linear space, so the smaller levels don't get darker. Only touches texture, so it's safe to run on any thread. */
+void generateMipChain(TextureData &texture);
+
+/* Reads a DDS file holding BC1, BC3 or BC7 blocks (legacy DXT1/DXT5 or a DX10 header), with whatever mip levels it has.
+ * Legacy files don't say what color space they're in, they're taken as sRGB like every other diffuse map. Throws std::runtime_error if it can't. */
+TextureData loadDDS(const std::string &path);
+
+#endif
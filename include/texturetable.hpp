@@ -0,0 +1,52 @@
+#ifndef TEXTURETABLE_HPP
+#define TEXTURETABLE_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* How many textures the table can hold at most, the device's descriptor indexing limits can make it smaller. */
+#define TEXTURE_TABLE_SIZE 4096
+
+/* One big array of combined image samplers in a single descriptor set, every resident texture gets a slot in it.
+ * Shaders index it with whatever index Add handed out, so draws with different textures don't need their own descriptors.
+ * Slots are only handed out again frameCount frames after they were removed, a frame in flight might still sample the old texture.
+ * Needs descriptor indexing (partially bound, update after bind, runtime arrays). This class is thread-safe. */
+class TextureTable {
+public:
+    TextureTable(VkDevice device, Uint32 capacity, Uint32 frameCount);
+    ~TextureTable();
+
+    /* Returns the texture's index, it stays the same until Remove. Throws std::runtime_error if the table is full. */
+    Uint32 Add(VkImageView imageView, VkSampler sampler);
+    void Remove(Uint32 index);
+
+    /* frameNumber is the frame about to be recorded, call this once its frame slot's fence has been waited on. */
+    void BeginFrame(Uint64 frameNumber);
+
+    inline VkDescriptorSetLayout GetLayout() { return m_Layout; };
+    inline VkDescriptorSet GetDescriptorSet() { return m_DescriptorSet; };
+private:
+    VkDevice m_Device;
+
+    Uint32 m_Capacity;
+    Uint32 m_FrameCount;
+    Uint64 m_FrameNumber = 0;
+
+    VkDescriptorSetLayout m_Layout = nullptr;
+    VkDescriptorPool m_Pool = nullptr;
+    VkDescriptorSet m_DescriptorSet = nullptr;
+
+    /* Slots that were never used are handed out in order, after that the free ones get reused. */
+    Uint32 m_NextIndex = 0;
+    std::vector<Uint32> m_FreeIndices;
+
+    /* Removed slots and the frame they were removed in, oldest first. */
+    std::deque<std::pair<Uint32, Uint64>> m_RetiredIndices;
+
+    std::mutex m_Mutex;
+};
+
+#endif
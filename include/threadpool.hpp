@@ -0,0 +1,52 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <SDL3/SDL_stdinc.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* (threadIndex, taskIndex), threadIndex is in [0, GetThreadCount()) and is stable, so it can index per-thread data. */
+typedef std::function<void(Uint32, Uint32)> ThreadPoolTask;
+
+/* A fixed set of worker threads that run one batch of tasks at a time. */
+class ThreadPool {
+public:
+    /* threadCount includes the thread calling Dispatch, so 1 means no extra threads at all. */
+    ThreadPool(Uint32 threadCount);
+    ~ThreadPool();
+
+    /* Runs task for every taskIndex in [0, taskCount) and blocks until all of them are done, the calling thread helps out as threadIndex 0.
+     * If a task throws, the rest still run and the first exception gets rethrown here. Not reentrant. */
+    void Dispatch(Uint32 taskCount, const ThreadPoolTask &task);
+
+    inline Uint32 GetThreadCount() { return m_Workers.size() + 1; };
+private:
+    void WorkerLoop(Uint32 threadIndex);
+    void RunTasks(Uint32 threadIndex, const ThreadPoolTask &task, Uint32 taskCount);
+
+    std::vector<std::thread> m_Workers;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkDone;
+
+    /* The current batch, only valid while Dispatch is running. */
+    const ThreadPoolTask *m_Task = nullptr;
+    Uint32 m_TaskCount = 0;
+    std::atomic<Uint32> m_NextTask{0};
+
+    /* Goes up with every Dispatch, so workers can tell a new batch from the one they just finished. */
+    Uint64 m_Generation = 0;
+    Uint32 m_ActiveWorkers = 0;
+
+    std::exception_ptr m_Exception;
+
+    bool m_Quit = false;
+};
+
+#endif
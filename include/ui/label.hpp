@@ -35,8 +35,8 @@ private:
     std::string m_Text;
     std::filesystem::path m_FontPath;
 
-    FT_Library m_FTLibrary;
-    FT_Face m_FTFace;
+    /* Acquired from the engine's FontManager, released in DestroyBuffers. */
+    FontHandle m_Font = INVALID_FONT_HANDLE;
 
     EngineSharedContext m_SharedContext;
 };
@@ -7,8 +7,6 @@ class GenericElement;
 
 class Panel : public Scalable {
 public:
-    TextureImageAndMemory texture;
-    
     ~Panel();
 
     /* Dimensions are expected to be provided as a 4D vector, {X, Y, W, H}. */
@@ -21,12 +19,21 @@ public:
     glm::vec2 GetPosition();
     glm::vec2 GetScale();
 
+    void SetColor(glm::vec3 color);
+    glm::vec3 GetColor();
+
+    /* Cached until the layout is marked dirty. */
     glm::vec4 GetDimensions();
 
     void DestroyBuffers();
 private:
+    glm::vec4 CalculateDimensions();
+
     struct EngineSharedContext m_SharedContext;
 
+    glm::vec3 m_Color;
+
     glm::vec4 m_Dimensions;
+    glm::vec4 m_CachedDimensions;
 };
 }
\ No newline at end of file
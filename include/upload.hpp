@@ -0,0 +1,100 @@
+#ifndef UPLOAD_HPP
+#define UPLOAD_HPP
+
+#include "allocator.hpp"
+#include "texturedata.hpp"
+
+#include <SDL3/SDL_stdinc.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+/* Identifies the batch an upload went into. Tokens only ever go up, so a token is complete once every batch up to it has finished. */
+typedef Uint64 UploadToken;
+
+struct UploadBatch {
+    UploadToken token;
+
+    /* Records the copies, lives on the transfer queue family (which is the graphics one if there's no dedicated transfer queue). */
+    VkCommandBuffer transferCommandBuffer = nullptr;
+
+    /* Only used with a dedicated transfer queue, acquires ownership of everything on the graphics queue. */
+    VkCommandBuffer graphicsCommandBuffer = nullptr;
+    VkSemaphore ownershipSemaphore = nullptr;
+
+    VkFence fence = nullptr;
+
+    std::vector<std::pair<VkBuffer, MemoryAllocation>> stagingBuffers;
+
+    /* Recorded all at once when the batch is submitted. */
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    VkPipelineStageFlags dstStageMask = 0;
+};
+
+/* Records staging copies and their barriers into one command buffer and submits them all at once with a fence, instead of blocking on the queue for every copy.
+ * Nothing recorded here reaches the GPU before Submit(). The renderer submits once per frame before its own submission, so anything recorded before that is visible to the frame.
+ * Submit() uses the graphics queue, it should only be called from the thread that renders. */
+class UploadBatcher {
+public:
+    /* Pass the graphics queue twice if there's no dedicated transfer queue. */
+    UploadBatcher(VkDevice device, MemoryAllocator *allocator, Uint32 graphicsQueueFamily, VkQueue graphicsQueue, Uint32 transferQueueFamily, VkQueue transferQueue);
+    ~UploadBatcher();
+
+    /* Copies size bytes from data into dstBuffer, dstAccessMask and dstStageMask describe how the buffer is going to be used afterwards. */
+    UploadToken UploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, VkDeviceSize dstOffset = 0);
+
+    /* Fills a freshly created (VK_IMAGE_LAYOUT_UNDEFINED) image, it ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. */
+    UploadToken UploadImage(VkImage dstImage, const void *data, VkDeviceSize size, Uint32 width, Uint32 height);
+
+    /* Same as above, but fills a mip level for every entry in levels, their offsets are into data. The image needs at least levels.size() mip levels. */
+    UploadToken UploadImage(VkImage dstImage, const void *data, VkDeviceSize size, const std::vector<TextureLevel> &levels);
+
+    /* The token that the next upload will get. */
+    UploadToken GetRecordingToken();
+
+    /* Submits everything recorded so far, returns its token. */
+    UploadToken Submit();
+
+    bool IsComplete(UploadToken token);
+
+    /* Blocks until token is complete, submitting it first if needed. */
+    void Wait(UploadToken token);
+
+    /* Frees the staging memory of every finished batch, called once per frame. */
+    void Collect();
+private:
+    /* All of these expect m_Mutex to be held. */
+    UploadBatch &GetRecordingBatch();
+    std::pair<VkBuffer, MemoryAllocation> CreateStagingBuffer(const void *data, VkDeviceSize size);
+    UploadToken SubmitRecordingBatch();
+    void RetireBatch(UploadBatch &batch);
+
+    inline bool HasDedicatedTransferQueue() { return m_GraphicsQueueFamily != m_TransferQueueFamily; };
+
+    VkDevice m_Device;
+    MemoryAllocator *m_Allocator;
+
+    Uint32 m_GraphicsQueueFamily;
+    VkQueue m_GraphicsQueue;
+    Uint32 m_TransferQueueFamily;
+    VkQueue m_TransferQueue;
+
+    VkCommandPool m_TransferCommandPool = nullptr;
+    VkCommandPool m_GraphicsCommandPool = nullptr;
+
+    UploadToken m_NextToken = 1;
+    UploadToken m_CompletedToken = 0;
+
+    /* Only valid while m_IsRecording is true. */
+    UploadBatch m_RecordingBatch;
+    bool m_IsRecording = false;
+
+    /* Submitted batches, oldest first. */
+    std::deque<UploadBatch> m_InFlightBatches;
+
+    std::mutex m_Mutex;
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include "BulletCollision/CollisionShapes/btCollisionShape.h"
 #include "common.hpp"
 #include "engine.hpp"
+#include "meshcache.hpp"
 #include "fmt/base.h"
 #include "isteamnetworkingsockets.h"
 #include "object.hpp"
@@ -23,28 +24,6 @@
                                     ? void(0)   \
                                     : throw std::runtime_error((std::string)#expr + (std::string)" is false/null!"))
 
-struct glTFPhysicsMaterial {
-    float staticFriction;
-    float dynamicFriction;
-
-    float restitution;
-};
-
-struct glTFColliderInfo {
-    btCollisionShape *shape;
-
-    glTFPhysicsMaterial physicsMaterial;
-
-    /* TODO: I don't see a point in collisionFilter but it could be useful. */
-};
-
-struct glTFRigidBody {
-    /* If this is 0, then the RigidBody is static. */
-    Uint64 mass = 0;
-
-    glTFColliderInfo colliderInfo;
-};
-
 bool                     intersects(const glm::vec3 &origin, const glm::vec3 &front, const std::array<glm::vec3, 2> &boundingBox);
 std::vector<std::string> split(const std::string_view text, const char delim);
 
@@ -67,8 +46,12 @@ bool                     getVisible(rapidxml::xml_node<char> *propertiesNode);
 /* Creates a box shape and gives back a pointer that is owned by the caller. */
 btCollisionShape *createBoxShape(glm::vec3 size);
 
+/* Reads the KHR_physics_rigid_bodies collider of node, the shape is only described, createColliderShape builds it. */
 struct glTFRigidBody getColliderInfoFromNode(const aiNode *node, const aiScene *scene);
 
+/* Builds the bullet shape a collider describes, owned by the caller. Returns nullptr for GLTF_COLLIDER_NONE. */
+btCollisionShape *createColliderShape(const glTFColliderInfo &colliderInfo);
+
 template<typename T>
 void Deserialize(std::vector<std::byte> &object, T &dest) {
     if constexpr (std::is_same<T, std::string>::value) {
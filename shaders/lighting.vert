@@ -1,20 +1,53 @@
 #version 450
 
+// set by the quantized pipeline, the inputs are a QuantizedVertex then.
+layout(constant_id = 0) const bool QUANTIZED_VERTICES = false;
+
+// quantized: position is unorm in the mesh's bounding box, normal is octahedral (only xy are read).
 layout(location = 0) in vec3 vt_pos;
 layout(location = 1) in vec3 vt_normal;
 layout(location = 2) in vec2 vt_txcoord;
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 viewMatrix;
-    mat4 modelMatrix;
-    mat4 projectionMatrix;
-} ubo;
+// per-instance, takes up locations 3 to 6.
+layout(location = 3) in mat4 inst_modelMatrix;
+layout(location = 7) in uint inst_textureIndex;
+
+layout(binding = 0) uniform FrameUniformBufferObject {
+    mat4 viewProjectionMatrix;
+} frame;
+
+// only pushed for quantized meshes.
+layout(push_constant) uniform QuantizationParameters {
+    vec4 offset;
+    vec4 scale;
+} quantization;
 
 layout(location = 0) out vec2 fragCoord;
 layout(location = 1) out vec3 fragNormal;
+layout(location = 2) flat out uint fragTextureIndex;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+
+    // unfold the lower half.
+    float t = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -t : t;
+    normal.y += normal.y >= 0.0 ? -t : t;
+
+    return normalize(normal);
+}
 
 void main() {
-    gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(vt_pos, 1.0);
+    vec3 position = vt_pos;
+    vec3 normal = vt_normal;
+
+    if (QUANTIZED_VERTICES) {
+        position = quantization.offset.xyz + vt_pos * quantization.scale.xyz;
+        normal = decodeOctahedral(vt_normal.xy);
+    }
+
+    gl_Position = frame.viewProjectionMatrix * inst_modelMatrix * vec4(position, 1.0);
     fragCoord = vt_txcoord;
-    fragNormal = vt_normal;
-}
\ No newline at end of file
+    fragNormal = normal;
+    fragTextureIndex = inst_textureIndex;
+}
@@ -0,0 +1,15 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragCoord;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) flat in uint fragTextureIndex;
+
+// the whole texture table, indexed by the instance.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures[nonuniformEXT(fragTextureIndex)], fragCoord);
+}
\ No newline at end of file
@@ -2,12 +2,13 @@
 
 layout(location = 0) in vec2 fragCoord;
 
-layout(binding = 1) uniform ArrowInfo {
-    vec3 Color;
+layout(push_constant) uniform ArrowInfo {
+    mat4 modelMatrix;
+    vec4 Color;
 } arrowInfo;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(arrowInfo.Color, 1.0f);
+    outColor = vec4(arrowInfo.Color.rgb, 1.0f);
 }
\ No newline at end of file
@@ -3,15 +3,18 @@
 layout(location = 0) in vec3 vt_pos;
 layout(location = 2) in vec2 vt_txcoord;
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 viewMatrix;
+layout(binding = 0) uniform FrameUniformBufferObject {
+    mat4 viewProjectionMatrix;
+} frame;
+
+layout(push_constant) uniform ArrowInfo {
     mat4 modelMatrix;
-    mat4 projectionMatrix;
-} ubo;
+    vec4 Color;
+} arrowInfo;
 
 layout(location = 0) out vec2 fragCoord;
 
 void main() {
-    gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(vt_pos, 1.0);
+    gl_Position = frame.viewProjectionMatrix * arrowInfo.modelMatrix * vec4(vt_pos, 1.0);
     fragCoord = vt_txcoord;
 }
\ No newline at end of file
@@ -3,18 +3,24 @@
 layout(location = 0) in vec2 vt_pos;
 layout(location = 1) in vec2 vt_txcoord;
 
-layout(set = 0, binding = 0) uniform LabelUBO {
-    vec2 PositionOffset;
+struct UIInstance {
+    vec4 Rect;      // position.xy, scale.xy, the label's position is already in there
+    vec4 UVRect;
+    vec4 Color;
     float Depth;
-} labelUBO;
+};
 
-layout(set = 0, binding = 2) uniform GlyphUBO {
-    vec2 Offset;
-} glyphUBO;
+layout(std430, set = 0, binding = 0) readonly buffer UIInstances {
+    UIInstance instances[];
+} uiInstances;
 
 layout(location = 0) out vec2 fragCoord;
+layout(location = 1) flat out vec4 fragUVRect;
 
 void main() {
-    gl_Position = vec4(vt_pos.xy + labelUBO.PositionOffset + glyphUBO.Offset, labelUBO.Depth, 1.0);
+    UIInstance glyph = uiInstances.instances[gl_InstanceIndex];
+
+    gl_Position = vec4(vt_pos.xy * glyph.Rect.zw + glyph.Rect.xy, glyph.Depth, 1.0);
     fragCoord = vt_txcoord;
-}
\ No newline at end of file
+    fragUVRect = glyph.UVRect;
+}
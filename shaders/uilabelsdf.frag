@@ -0,0 +1,18 @@
+#version 450
+
+layout(location = 0) in vec2 fragCoord;
+layout(location = 1) flat in vec4 fragUVRect;
+
+layout(binding = 1) uniform sampler2D tex;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // 0.5 is the edge of the glyph, anything above it is inside.
+    float distance = texture(tex, mix(fragUVRect.xy, fragUVRect.zw, fragCoord)).r;
+
+    // one pixel of antialiasing, whatever size the glyph is drawn at.
+    float smoothing = fwidth(distance) * 0.5;
+
+    outColor = vec4(1.0, 1.0, 1.0, smoothstep(0.5 - smoothing, 0.5 + smoothing, distance));
+}
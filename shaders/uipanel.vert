@@ -3,23 +3,33 @@
 layout(location = 0) in vec2 vt_pos;
 layout(location = 1) in vec2 vt_txcoord;
 
-layout(binding = 0) uniform UniformBufferObject {
-    vec4 Dimensions;
+struct UIInstance {
+    vec4 Rect;      // x, y, w, h
+    vec4 UVRect;
+    vec4 Color;
     float Depth;
-} ubo;
+};
+
+layout(std430, binding = 0) readonly buffer UIInstances {
+    UIInstance instances[];
+} uiInstances;
 
 layout(location = 0) out vec2 fragCoord;
+layout(location = 1) flat out vec4 fragColor;
 
 void main() {
+    UIInstance panel = uiInstances.instances[gl_InstanceIndex];
+
     if (gl_VertexIndex == 0 || gl_VertexIndex == 3) {
-        gl_Position = vec4(ubo.Dimensions.x, ubo.Dimensions.y, ubo.Depth, 1.0);
+        gl_Position = vec4(panel.Rect.x, panel.Rect.y, panel.Depth, 1.0);
     } else if (gl_VertexIndex == 1 || gl_VertexIndex == 5) {
-        gl_Position = vec4(ubo.Dimensions.x + ubo.Dimensions.z, ubo.Dimensions.y + ubo.Dimensions.w, ubo.Depth, 1.0);
+        gl_Position = vec4(panel.Rect.x + panel.Rect.z, panel.Rect.y + panel.Rect.w, panel.Depth, 1.0);
     } else if (gl_VertexIndex == 2) {
-        gl_Position = vec4(ubo.Dimensions.x, ubo.Dimensions.y + ubo.Dimensions.w, ubo.Depth, 1.0);
+        gl_Position = vec4(panel.Rect.x, panel.Rect.y + panel.Rect.w, panel.Depth, 1.0);
     } else {
-        gl_Position = vec4(ubo.Dimensions.x + ubo.Dimensions.z, ubo.Dimensions.y, ubo.Depth, 1.0);
+        gl_Position = vec4(panel.Rect.x + panel.Rect.z, panel.Rect.y, panel.Depth, 1.0);
     }
 
     fragCoord = vt_txcoord;
+    fragColor = panel.Color;
 }
\ No newline at end of file
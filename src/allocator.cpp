@@ -0,0 +1,271 @@
+#include "allocator.hpp"
+#include "error.hpp"
+
+#include "fmt/base.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static Uint32 getSizeClass(VkDeviceSize size) {
+    Uint32 sizeClass = 0;
+
+    while ((1ull << (sizeClass + ALLOCATOR_MIN_SLOT_SIZE_LOG2)) < size)
+        sizeClass++;
+
+    return sizeClass;
+}
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice) : m_Device(device) {
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    m_MaxDeviceAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_Statistics.allocationCount > 0)
+        fmt::println("WARN: Destroying the memory allocator with {} allocations still alive!", m_Statistics.allocationCount);
+
+    for (auto &memoryTypePools : m_Pools)
+        for (auto &tilingPools : memoryTypePools)
+            for (MemoryPool &pool : tilingPools)
+                for (std::unique_ptr<MemoryPage> &page : pool)
+                    vkFreeMemory(m_Device, page->deviceMemory, NULL);
+
+    /* Dedicated allocations that were never freed can't be found anymore, they die with the device. */
+}
+
+Uint32 MemoryAllocator::FindMemoryType(Uint32 typeFilter, VkMemoryPropertyFlags properties) {
+    for (Uint32 i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            return i;
+    }
+
+    throw std::runtime_error(engineError::CANT_FIND_SUITABLE_MEMTYPE);
+}
+
+MemoryAllocator::MemoryPool &MemoryAllocator::GetPool(Uint32 memoryTypeIndex, bool isLinear, Uint32 sizeClass) {
+    return m_Pools[memoryTypeIndex][isLinear][sizeClass];
+}
+
+MemoryPage *MemoryAllocator::CreatePage(Uint32 memoryTypeIndex, bool isLinear, Uint32 sizeClass) {
+    if (m_Statistics.deviceAllocationCount >= m_MaxDeviceAllocationCount)
+        throw std::runtime_error(fmt::format(engineError::DEVICE_ALLOCATION_LIMIT_REACHED, m_MaxDeviceAllocationCount));
+
+    std::unique_ptr<MemoryPage> page = std::make_unique<MemoryPage>();
+
+    page->memoryTypeIndex = memoryTypeIndex;
+    page->isLinear = isLinear;
+    page->sizeClass = sizeClass;
+    page->slotSize = 1ull << (sizeClass + ALLOCATOR_MIN_SLOT_SIZE_LOG2);
+    page->size = std::clamp<VkDeviceSize>(page->slotSize * ALLOCATOR_SLOTS_PER_PAGE, ALLOCATOR_MIN_PAGE_SIZE, ALLOCATOR_MAX_PAGE_SIZE);
+
+    Uint32 slotCount = page->size / page->slotSize;
+
+    page->slotUsage.resize(slotCount, 0);
+
+    /* Reversed so that the lowest slots get handed out first. */
+    page->freeSlots.reserve(slotCount);
+    for (Uint32 i = slotCount; i > 0; i--)
+        page->freeSlots.push_back(i - 1);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = page->size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    if (vkAllocateMemory(m_Device, &allocInfo, NULL, &page->deviceMemory) != VK_SUCCESS)
+        throw std::runtime_error(engineError::CANT_ALLOCATE_MEMORY);
+
+    /* Host-visible pages stay mapped for their whole lifetime, a VkDeviceMemory can only be mapped once anyway. */
+    if (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vkMapMemory(m_Device, page->deviceMemory, 0, VK_WHOLE_SIZE, 0, &page->mappedData);
+
+    m_Statistics.bytesAllocated += page->size;
+    m_Statistics.deviceAllocationCount++;
+
+    MemoryPool &pool = GetPool(memoryTypeIndex, isLinear, sizeClass);
+    pool.push_back(std::move(page));
+
+    return pool.back().get();
+}
+
+MemoryAllocation MemoryAllocator::AllocateFromPage(MemoryPage *page, VkDeviceSize size) {
+    Uint32 slot = page->freeSlots.back();
+    page->freeSlots.pop_back();
+
+    page->slotUsage[slot] = size;
+
+    MemoryAllocation allocation;
+    allocation.deviceMemory = page->deviceMemory;
+    allocation.offset = slot * page->slotSize;
+    allocation.size = size;
+    allocation.mappedData = page->mappedData ? static_cast<char *>(page->mappedData) + allocation.offset : nullptr;
+    allocation.page = page;
+    allocation.slot = slot;
+
+    m_Statistics.bytesUsed += size;
+    m_Statistics.allocationCount++;
+
+    return allocation;
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool isLinear) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Uint32 memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+
+    /* Slots are aligned to their own size, so any alignment up to the slot size comes for free. */
+    VkDeviceSize slotSize = std::max(requirements.size, requirements.alignment);
+
+    if (slotSize > (1ull << ALLOCATOR_MAX_SLOT_SIZE_LOG2)) {
+        if (m_Statistics.deviceAllocationCount >= m_MaxDeviceAllocationCount)
+            throw std::runtime_error(fmt::format(engineError::DEVICE_ALLOCATION_LIMIT_REACHED, m_MaxDeviceAllocationCount));
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        MemoryAllocation allocation;
+        allocation.size = requirements.size;
+
+        if (vkAllocateMemory(m_Device, &allocInfo, NULL, &allocation.deviceMemory) != VK_SUCCESS)
+            throw std::runtime_error(engineError::CANT_ALLOCATE_MEMORY);
+
+        if (m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            vkMapMemory(m_Device, allocation.deviceMemory, 0, VK_WHOLE_SIZE, 0, &allocation.mappedData);
+
+        m_Statistics.bytesAllocated += requirements.size;
+        m_Statistics.bytesUsed += requirements.size;
+        m_Statistics.deviceAllocationCount++;
+        m_Statistics.dedicatedAllocationCount++;
+        m_Statistics.allocationCount++;
+
+        return allocation;
+    }
+
+    Uint32 sizeClass = getSizeClass(slotSize);
+
+    for (std::unique_ptr<MemoryPage> &page : GetPool(memoryTypeIndex, isLinear, sizeClass)) {
+        if (!page->freeSlots.empty())
+            return AllocateFromPage(page.get(), requirements.size);
+    }
+
+    return AllocateFromPage(CreatePage(memoryTypeIndex, isLinear, sizeClass), requirements.size);
+}
+
+void MemoryAllocator::Free(MemoryAllocation &allocation) {
+    if (!allocation.deviceMemory)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (allocation.page == nullptr) {
+        vkFreeMemory(m_Device, allocation.deviceMemory, NULL);
+
+        m_Statistics.bytesAllocated -= allocation.size;
+        m_Statistics.deviceAllocationCount--;
+        m_Statistics.dedicatedAllocationCount--;
+    } else {
+        MemoryPage *page = allocation.page;
+
+        page->slotUsage[allocation.slot] = 0;
+        page->freeSlots.push_back(allocation.slot);
+    }
+
+    m_Statistics.bytesUsed -= allocation.size;
+    m_Statistics.allocationCount--;
+
+    allocation = MemoryAllocation{};
+}
+
+void MemoryAllocator::Defragment(const DefragmentationCallback &callback) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (auto &memoryTypePools : m_Pools) {
+        for (auto &tilingPools : memoryTypePools) {
+            for (MemoryPool &pool : tilingPools) {
+                if (callback && pool.size() > 1) {
+                    /* Fullest pages first, we move allocations from the back of the pool into the holes at the front. */
+                    std::stable_sort(pool.begin(), pool.end(), [](const std::unique_ptr<MemoryPage> &a, const std::unique_ptr<MemoryPage> &b) {
+                        return a->freeSlots.size() < b->freeSlots.size();
+                    });
+
+                    size_t destinationPage = 0;
+
+                    for (size_t sourcePage = pool.size() - 1; sourcePage > destinationPage; sourcePage--) {
+                        MemoryPage *source = pool[sourcePage].get();
+
+                        for (Uint32 slot = 0; slot < source->slotUsage.size(); slot++) {
+                            if (source->slotUsage[slot] == 0)
+                                continue;
+
+                            while (destinationPage < sourcePage && pool[destinationPage]->freeSlots.empty())
+                                destinationPage++;
+
+                            if (destinationPage >= sourcePage)
+                                break;
+
+                            MemoryAllocation oldAllocation;
+                            oldAllocation.deviceMemory = source->deviceMemory;
+                            oldAllocation.offset = slot * source->slotSize;
+                            oldAllocation.size = source->slotUsage[slot];
+                            oldAllocation.mappedData = source->mappedData ? static_cast<char *>(source->mappedData) + oldAllocation.offset : nullptr;
+                            oldAllocation.page = source;
+                            oldAllocation.slot = slot;
+
+                            MemoryAllocation newAllocation = AllocateFromPage(pool[destinationPage].get(), oldAllocation.size);
+
+                            /* AllocateFromPage counted this one twice, only one of them survives. */
+                            m_Statistics.bytesUsed -= oldAllocation.size;
+                            m_Statistics.allocationCount--;
+
+                            if (callback(oldAllocation, newAllocation)) {
+                                source->slotUsage[slot] = 0;
+                                source->freeSlots.push_back(slot);
+                            } else {
+                                pool[destinationPage]->slotUsage[newAllocation.slot] = 0;
+                                pool[destinationPage]->freeSlots.push_back(newAllocation.slot);
+                            }
+                        }
+                    }
+                }
+
+                /* Give every empty page back to the driver. */
+                for (size_t i = 0; i < pool.size(); i++) {
+                    if (pool[i]->freeSlots.size() != pool[i]->slotUsage.size())
+                        continue;
+
+                    vkFreeMemory(m_Device, pool[i]->deviceMemory, NULL);
+
+                    m_Statistics.bytesAllocated -= pool[i]->size;
+                    m_Statistics.deviceAllocationCount--;
+
+                    pool.erase(pool.begin() + (i--));
+                }
+            }
+        }
+    }
+}
+
+MemoryAllocatorStatistics MemoryAllocator::GetStatistics() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_Statistics;
+}
+
+void MemoryAllocator::PrintStatistics() {
+    MemoryAllocatorStatistics statistics = GetStatistics();
+
+    double usage = statistics.bytesAllocated > 0 ? static_cast<double>(statistics.bytesUsed) / static_cast<double>(statistics.bytesAllocated) * 100.0 : 0.0;
+
+    fmt::println("Device memory: {:.2f} MiB used out of {:.2f} MiB allocated ({:.1f}%), {} allocations in {} device allocations ({} dedicated, limit is {})",
+                    statistics.bytesUsed / 1048576.0, statistics.bytesAllocated / 1048576.0, usage,
+                    statistics.allocationCount, statistics.deviceAllocationCount, statistics.dedicatedAllocationCount, m_MaxDeviceAllocationCount);
+}
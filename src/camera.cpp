@@ -4,8 +4,7 @@
 
 Camera::Camera(float aspectRatio, glm::vec3 up, float yaw, float pitch) : Front(glm::vec3(0.0f, 1.0f, 0.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), FOV(FIELDOFVIEW)
 {
-    HighestCameraID++;
-    SetCameraID(HighestCameraID);
+    SetCameraID(++HighestCameraID);
 
     AspectRatio = aspectRatio;
 
@@ -18,8 +17,7 @@ Camera::Camera(float aspectRatio, glm::vec3 up, float yaw, float pitch) : Front(
 // constructor with scalar values
 Camera::Camera(float aspectRatio, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 1.0f, 0.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), FOV(FIELDOFVIEW)
 {
-    HighestCameraID++;
-    SetCameraID(HighestCameraID);
+    SetCameraID(++HighestCameraID);
 
     AspectRatio = aspectRatio;
 
@@ -110,4 +108,4 @@ void Camera::SetObjectAttachment(Object *obj) {
     }
 }
 
-int Camera::HighestCameraID = -1;
+std::atomic<int> Camera::HighestCameraID{-1};
@@ -0,0 +1,369 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CULLING_USE_SSE 1
+#endif
+
+Frustum Frustum::FromMatrix(const glm::mat4 &viewProjection) {
+    Frustum frustum;
+
+    // glm is column-major, [column][row].
+    glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    std::array<glm::vec4, 8> planes = {
+        row3 + row0,    // left
+        row3 - row0,    // right
+        row3 + row1,    // bottom
+        row3 - row1,    // top
+        row3 + row2,    // near
+        row3 - row2,    // far
+
+        // padding, 0x + 0y + 0z + 1 is always positive.
+        glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+        glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+    };
+
+    for (size_t i = 0; i < planes.size(); i++) {
+        frustum.planeX[i] = planes[i].x;
+        frustum.planeY[i] = planes[i].y;
+        frustum.planeZ[i] = planes[i].z;
+        frustum.planeW[i] = planes[i].w;
+
+        frustum.absPlaneX[i] = std::fabs(planes[i].x);
+        frustum.absPlaneY[i] = std::fabs(planes[i].y);
+        frustum.absPlaneZ[i] = std::fabs(planes[i].z);
+    }
+
+    return frustum;
+}
+
+/* For every plane: the box is outside if its center is further behind the plane than its projected radius, and completely in front if it's further in front than that.
+ * The planes aren't normalized, both sides of the comparison are scaled the same way so it doesn't matter. */
+FrustumTestResult Frustum::TestAABB(const AABB &box) const {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+#ifdef CULLING_USE_SSE
+    __m128 centerX = _mm_set1_ps(center.x);
+    __m128 centerY = _mm_set1_ps(center.y);
+    __m128 centerZ = _mm_set1_ps(center.z);
+
+    __m128 extentsX = _mm_set1_ps(extents.x);
+    __m128 extentsY = _mm_set1_ps(extents.y);
+    __m128 extentsZ = _mm_set1_ps(extents.z);
+
+    int intersectMask = 0;
+
+    for (int i = 0; i < 8; i += 4) {
+        __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&planeX[i]), centerX), _mm_mul_ps(_mm_load_ps(&planeY[i]), centerY)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_load_ps(&planeZ[i]), centerZ), _mm_load_ps(&planeW[i])));
+
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(&absPlaneX[i]), extentsX), _mm_mul_ps(_mm_load_ps(&absPlaneY[i]), extentsY)),
+                                   _mm_mul_ps(_mm_load_ps(&absPlaneZ[i]), extentsZ));
+
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())))
+            return FRUSTUM_OUTSIDE;
+
+        intersectMask |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+    }
+
+    return intersectMask ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+#else
+    bool intersects = false;
+
+    for (int i = 0; i < 6; i++) {
+        float distance = planeX[i] * center.x + planeY[i] * center.y + planeZ[i] * center.z + planeW[i];
+        float radius = absPlaneX[i] * extents.x + absPlaneY[i] * extents.y + absPlaneZ[i] * extents.z;
+
+        if (distance + radius < 0.0f)
+            return FRUSTUM_OUTSIDE;
+
+        if (distance - radius < 0.0f)
+            intersects = true;
+    }
+
+    return intersects ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+#endif
+}
+
+Sint32 AABBTree::AllocateNode() {
+    if (m_FreeList == AABB_TREE_NULL_NODE) {
+        m_Nodes.emplace_back();
+
+        return m_Nodes.size() - 1;
+    }
+
+    Sint32 nodeID = m_FreeList;
+
+    // free nodes use parent as the next pointer.
+    m_FreeList = m_Nodes[nodeID].parent;
+
+    m_Nodes[nodeID] = AABBTreeNode{};
+
+    return nodeID;
+}
+
+void AABBTree::FreeNode(Sint32 nodeID) {
+    m_Nodes[nodeID].parent = m_FreeList;
+    m_Nodes[nodeID].height = -1;
+
+    m_FreeList = nodeID;
+}
+
+Sint32 AABBTree::CreateProxy(const AABB &box, Uint32 userData) {
+    Sint32 proxyID = AllocateNode();
+
+    m_Nodes[proxyID].box = {box.min - glm::vec3(AABB_TREE_MARGIN), box.max + glm::vec3(AABB_TREE_MARGIN)};
+    m_Nodes[proxyID].userData = userData;
+    m_Nodes[proxyID].height = 0;
+
+    InsertLeaf(proxyID);
+
+    m_ProxyCount++;
+
+    return proxyID;
+}
+
+void AABBTree::DestroyProxy(Sint32 proxyID) {
+    RemoveLeaf(proxyID);
+    FreeNode(proxyID);
+
+    m_ProxyCount--;
+}
+
+bool AABBTree::MoveProxy(Sint32 proxyID, const AABB &box) {
+    if (m_Nodes[proxyID].box.Contains(box))
+        return false;
+
+    RemoveLeaf(proxyID);
+
+    m_Nodes[proxyID].box = {box.min - glm::vec3(AABB_TREE_MARGIN), box.max + glm::vec3(AABB_TREE_MARGIN)};
+
+    InsertLeaf(proxyID);
+
+    return true;
+}
+
+void AABBTree::InsertLeaf(Sint32 leafID) {
+    if (m_Root == AABB_TREE_NULL_NODE) {
+        m_Root = leafID;
+        m_Nodes[m_Root].parent = AABB_TREE_NULL_NODE;
+
+        return;
+    }
+
+    /* Walk down to the sibling that makes the tree grow the least (surface area heuristic). */
+    AABB leafBox = m_Nodes[leafID].box;
+    Sint32 index = m_Root;
+
+    while (!m_Nodes[index].IsLeaf()) {
+        Sint32 left = m_Nodes[index].left;
+        Sint32 right = m_Nodes[index].right;
+
+        float area = m_Nodes[index].box.GetCost();
+        float combinedArea = mergeAABBs(m_Nodes[index].box, leafBox).GetCost();
+
+        // cost of making a new parent for this node and the leaf.
+        float cost = 2.0f * combinedArea;
+
+        // minimum cost of pushing the leaf further down the tree.
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](Sint32 child) {
+            float newArea = mergeAABBs(leafBox, m_Nodes[child].box).GetCost();
+
+            if (m_Nodes[child].IsLeaf())
+                return newArea + inheritanceCost;
+
+            return (newArea - m_Nodes[child].box.GetCost()) + inheritanceCost;
+        };
+
+        float leftCost = descendCost(left);
+        float rightCost = descendCost(right);
+
+        if (cost < leftCost && cost < rightCost)
+            break;
+
+        index = leftCost < rightCost ? left : right;
+    }
+
+    Sint32 sibling = index;
+
+    Sint32 oldParent = m_Nodes[sibling].parent;
+    Sint32 newParent = AllocateNode();
+
+    m_Nodes[newParent].parent = oldParent;
+    m_Nodes[newParent].box = mergeAABBs(leafBox, m_Nodes[sibling].box);
+    m_Nodes[newParent].height = m_Nodes[sibling].height + 1;
+    m_Nodes[newParent].left = sibling;
+    m_Nodes[newParent].right = leafID;
+
+    m_Nodes[sibling].parent = newParent;
+    m_Nodes[leafID].parent = newParent;
+
+    if (oldParent == AABB_TREE_NULL_NODE) {
+        m_Root = newParent;
+    } else {
+        if (m_Nodes[oldParent].left == sibling)
+            m_Nodes[oldParent].left = newParent;
+        else
+            m_Nodes[oldParent].right = newParent;
+    }
+
+    RefitAncestors(m_Nodes[leafID].parent);
+}
+
+void AABBTree::RemoveLeaf(Sint32 leafID) {
+    if (leafID == m_Root) {
+        m_Root = AABB_TREE_NULL_NODE;
+        return;
+    }
+
+    Sint32 parent = m_Nodes[leafID].parent;
+    Sint32 grandParent = m_Nodes[parent].parent;
+    Sint32 sibling = m_Nodes[parent].left == leafID ? m_Nodes[parent].right : m_Nodes[parent].left;
+
+    // the sibling takes the parent's place.
+    if (grandParent == AABB_TREE_NULL_NODE) {
+        m_Root = sibling;
+        m_Nodes[sibling].parent = AABB_TREE_NULL_NODE;
+
+        FreeNode(parent);
+    } else {
+        if (m_Nodes[grandParent].left == parent)
+            m_Nodes[grandParent].left = sibling;
+        else
+            m_Nodes[grandParent].right = sibling;
+
+        m_Nodes[sibling].parent = grandParent;
+
+        FreeNode(parent);
+
+        RefitAncestors(grandParent);
+    }
+}
+
+void AABBTree::RefitAncestors(Sint32 nodeID) {
+    while (nodeID != AABB_TREE_NULL_NODE) {
+        nodeID = Balance(nodeID);
+
+        Sint32 left = m_Nodes[nodeID].left;
+        Sint32 right = m_Nodes[nodeID].right;
+
+        m_Nodes[nodeID].height = 1 + std::max(m_Nodes[left].height, m_Nodes[right].height);
+        m_Nodes[nodeID].box = mergeAABBs(m_Nodes[left].box, m_Nodes[right].box);
+
+        nodeID = m_Nodes[nodeID].parent;
+    }
+}
+
+Sint32 AABBTree::Balance(Sint32 a) {
+    if (m_Nodes[a].IsLeaf() || m_Nodes[a].height < 2)
+        return a;
+
+    Sint32 b = m_Nodes[a].left;
+    Sint32 c = m_Nodes[a].right;
+
+    Sint32 balance = m_Nodes[c].height - m_Nodes[b].height;
+
+    // rotates `up` into a's place, a takes one of up's children and up keeps the taller one.
+    auto rotate = [&](Sint32 up, Sint32 other, bool upIsRight) {
+        Sint32 f = m_Nodes[up].left;
+        Sint32 g = m_Nodes[up].right;
+
+        m_Nodes[up].left = a;
+        m_Nodes[up].parent = m_Nodes[a].parent;
+        m_Nodes[a].parent = up;
+
+        if (m_Nodes[up].parent != AABB_TREE_NULL_NODE) {
+            if (m_Nodes[m_Nodes[up].parent].left == a)
+                m_Nodes[m_Nodes[up].parent].left = up;
+            else
+                m_Nodes[m_Nodes[up].parent].right = up;
+        } else {
+            m_Root = up;
+        }
+
+        Sint32 kept = m_Nodes[f].height > m_Nodes[g].height ? f : g;
+        Sint32 given = kept == f ? g : f;
+
+        m_Nodes[up].right = kept;
+
+        if (upIsRight)
+            m_Nodes[a].right = given;
+        else
+            m_Nodes[a].left = given;
+
+        m_Nodes[given].parent = a;
+
+        m_Nodes[a].box = mergeAABBs(m_Nodes[other].box, m_Nodes[given].box);
+        m_Nodes[up].box = mergeAABBs(m_Nodes[a].box, m_Nodes[kept].box);
+
+        m_Nodes[a].height = 1 + std::max(m_Nodes[other].height, m_Nodes[given].height);
+        m_Nodes[up].height = 1 + std::max(m_Nodes[a].height, m_Nodes[kept].height);
+    };
+
+    if (balance > 1) {
+        rotate(c, b, true);
+        return c;
+    }
+
+    if (balance < -1) {
+        rotate(b, c, false);
+        return b;
+    }
+
+    return a;
+}
+
+void AABBTree::CollectLeaves(Sint32 nodeID, std::vector<Uint32> &results) {
+    size_t stackBase = m_Stack.size();
+
+    m_Stack.push_back(nodeID);
+
+    while (m_Stack.size() > stackBase) {
+        Sint32 index = m_Stack.back();
+        m_Stack.pop_back();
+
+        if (m_Nodes[index].IsLeaf()) {
+            results.push_back(m_Nodes[index].userData);
+        } else {
+            m_Stack.push_back(m_Nodes[index].left);
+            m_Stack.push_back(m_Nodes[index].right);
+        }
+    }
+}
+
+void AABBTree::QueryFrustum(const Frustum &frustum, std::vector<Uint32> &results) {
+    if (m_Root == AABB_TREE_NULL_NODE)
+        return;
+
+    m_Stack.clear();
+    m_Stack.push_back(m_Root);
+
+    while (!m_Stack.empty()) {
+        Sint32 index = m_Stack.back();
+        m_Stack.pop_back();
+
+        FrustumTestResult result = frustum.TestAABB(m_Nodes[index].box);
+
+        if (result == FRUSTUM_OUTSIDE)
+            continue;
+
+        // the whole subtree is visible, no point in testing any of it.
+        if (result == FRUSTUM_INSIDE || m_Nodes[index].IsLeaf()) {
+            CollectLeaves(index, results);
+            continue;
+        }
+
+        m_Stack.push_back(m_Nodes[index].left);
+        m_Stack.push_back(m_Nodes[index].right);
+    }
+}
@@ -0,0 +1,125 @@
+#include "deletion.hpp"
+
+#include <algorithm>
+
+DeletionQueue::DeletionQueue(VkDevice device, MemoryAllocator *allocator, UploadBatcher *uploadBatcher, Uint32 frameCount)
+    : m_Device(device), m_Allocator(allocator), m_UploadBatcher(uploadBatcher), m_FrameCount(frameCount) {}
+
+DeletionQueue::~DeletionQueue() {
+    Flush();
+}
+
+void DeletionQueue::BeginFrame(Uint64 frameNumber) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_FrameNumber = frameNumber;
+
+    while (!m_Frames.empty()) {
+        FrameDeletions &deletions = m_Frames.front();
+
+        // the frame it was queued in (and every one before it) has finished.
+        if (deletions.frameNumber + m_FrameCount > frameNumber)
+            break;
+
+        // an upload that was still being recorded back then might not be done, try again next frame.
+        if (deletions.uploadToken && !m_UploadBatcher->IsComplete(deletions.uploadToken))
+            break;
+
+        Destroy(deletions);
+        m_Frames.pop_front();
+    }
+}
+
+FrameDeletions &DeletionQueue::GetCurrentFrame() {
+    if (m_Frames.empty() || m_Frames.back().frameNumber != m_FrameNumber) {
+        m_Frames.emplace_back();
+        m_Frames.back().frameNumber = m_FrameNumber;
+    }
+
+    return m_Frames.back();
+}
+
+void DeletionQueue::DestroyBuffer(VkBuffer buffer, const MemoryAllocation &memory, UploadToken uploadToken) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    FrameDeletions &deletions = GetCurrentFrame();
+
+    deletions.buffers.push_back(std::make_pair(buffer, memory));
+    deletions.uploadToken = std::max(deletions.uploadToken, uploadToken);
+}
+
+void DeletionQueue::DestroyImage(VkImage image, const MemoryAllocation &memory, UploadToken uploadToken) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    FrameDeletions &deletions = GetCurrentFrame();
+
+    deletions.images.push_back(std::make_pair(image, memory));
+    deletions.uploadToken = std::max(deletions.uploadToken, uploadToken);
+}
+
+void DeletionQueue::DestroyImageView(VkImageView imageView) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    GetCurrentFrame().imageViews.push_back(imageView);
+}
+
+void DeletionQueue::DestroySampler(VkSampler sampler) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    GetCurrentFrame().samplers.push_back(sampler);
+}
+
+void DeletionQueue::FreeDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSet descriptorSet) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    GetCurrentFrame().descriptorSets.push_back(std::make_pair(descriptorPool, descriptorSet));
+}
+
+void DeletionQueue::Flush() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (FrameDeletions &deletions : m_Frames)
+        Destroy(deletions);
+
+    m_Frames.clear();
+}
+
+size_t DeletionQueue::GetPendingCount() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    size_t pendingCount = 0;
+
+    for (FrameDeletions &deletions : m_Frames)
+        pendingCount += deletions.buffers.size() + deletions.images.size() + deletions.imageViews.size() + deletions.samplers.size() + deletions.descriptorSets.size();
+
+    return pendingCount;
+}
+
+bool DeletionQueue::IsRetired(Uint64 frameNumber) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // oldest first, if the front one is newer then so is everything behind it.
+    return m_Frames.empty() || m_Frames.front().frameNumber > frameNumber;
+}
+
+void DeletionQueue::Destroy(FrameDeletions &deletions) {
+    // views before what they view.
+    for (VkImageView imageView : deletions.imageViews)
+        vkDestroyImageView(m_Device, imageView, NULL);
+
+    for (VkSampler sampler : deletions.samplers)
+        vkDestroySampler(m_Device, sampler, NULL);
+
+    for (auto &descriptorSet : deletions.descriptorSets)
+        vkFreeDescriptorSets(m_Device, descriptorSet.first, 1, &descriptorSet.second);
+
+    for (auto &image : deletions.images) {
+        vkDestroyImage(m_Device, image.first, NULL);
+        m_Allocator->Free(image.second);
+    }
+
+    for (auto &buffer : deletions.buffers) {
+        vkDestroyBuffer(m_Device, buffer.first, NULL);
+        m_Allocator->Free(buffer.second);
+    }
+}
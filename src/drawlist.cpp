@@ -0,0 +1,161 @@
+#include "drawlist.hpp"
+
+#include <algorithm>
+
+static Uint64 quantizeDepth(float depth) {
+    depth = std::clamp(depth, 0.0f, 1.0f);
+
+    return static_cast<Uint64>(depth * ((1 << DRAW_KEY_DEPTH_BITS) - 1));
+}
+
+DrawSortKey DrawList::MakeOpaqueKey(Uint32 pipelineID, Uint32 textureID, Uint32 meshID, float depth) {
+    DrawSortKey key = 0;
+
+    key |= static_cast<Uint64>(pipelineID & ((1 << DRAW_KEY_PIPELINE_BITS) - 1));
+    key <<= DRAW_KEY_TEXTURE_BITS;
+    key |= static_cast<Uint64>(textureID & ((1 << DRAW_KEY_TEXTURE_BITS) - 1));
+    key <<= DRAW_KEY_MESH_BITS;
+    key |= static_cast<Uint64>(meshID & ((1 << DRAW_KEY_MESH_BITS) - 1));
+    key <<= DRAW_KEY_DEPTH_BITS;
+    key |= quantizeDepth(depth);
+
+    return key;
+}
+
+DrawSortKey DrawList::MakeBlendedKey(Uint32 pipelineID, Uint32 textureID, Uint32 meshID, float depth) {
+    DrawSortKey key = 0;
+
+    // furthest first, blending needs whatever's behind to already be there.
+    key |= ((1 << DRAW_KEY_DEPTH_BITS) - 1) - quantizeDepth(depth);
+    key <<= DRAW_KEY_PIPELINE_BITS;
+    key |= static_cast<Uint64>(pipelineID & ((1 << DRAW_KEY_PIPELINE_BITS) - 1));
+    key <<= DRAW_KEY_TEXTURE_BITS;
+    key |= static_cast<Uint64>(textureID & ((1 << DRAW_KEY_TEXTURE_BITS) - 1));
+    key <<= DRAW_KEY_MESH_BITS;
+    key |= static_cast<Uint64>(meshID & ((1 << DRAW_KEY_MESH_BITS) - 1));
+
+    return key;
+}
+
+Uint32 DrawList::HandleID(Uint64 handle) {
+    // handles are usually aligned pointers, mix the bits so the low ones mean something.
+    handle ^= handle >> 33;
+    handle *= 0xff51afd7ed558ccdull;
+    handle ^= handle >> 33;
+
+    return static_cast<Uint32>(handle);
+}
+
+void DrawList::Clear() {
+    m_Commands.clear();
+}
+
+void DrawList::Add(DrawSortKey key, Uint32 index) {
+    m_Commands.push_back({key, index});
+}
+
+void DrawList::Sort() {
+    if (m_Commands.size() < 2)
+        return;
+
+    m_Scratch.resize(m_Commands.size());
+
+    for (Uint32 shift = 0; shift < 64; shift += 8) {
+        std::array<size_t, 256> offsets{};
+
+        for (const DrawCommand &command : m_Commands)
+            offsets[(command.key >> shift) & 0xFF]++;
+
+        // every key has the same byte here, this pass wouldn't move anything.
+        if (offsets[(m_Commands[0].key >> shift) & 0xFF] == m_Commands.size())
+            continue;
+
+        size_t total = 0;
+        for (size_t &offset : offsets) {
+            size_t count = offset;
+            offset = total;
+            total += count;
+        }
+
+        for (const DrawCommand &command : m_Commands)
+            m_Scratch[offsets[(command.key >> shift) & 0xFF]++] = command;
+
+        m_Commands.swap(m_Scratch);
+    }
+}
+
+void CommandStateTracker::Reset(VkCommandBuffer commandBuffer) {
+    m_CommandBuffer = commandBuffer;
+
+    m_Pipeline = nullptr;
+
+    for (Uint32 i = 0; i < 2; i++) {
+        m_VertexBuffers[i] = nullptr;
+        m_VertexBufferOffsets[i] = 0;
+    }
+
+    m_IndexBuffer = nullptr;
+    m_HasDescriptors = false;
+}
+
+void CommandStateTracker::ResetStatistics() {
+    m_BindCount = 0;
+    m_SkippedBindCount = 0;
+}
+
+void CommandStateTracker::BindPipeline(VkPipeline pipeline) {
+    if (m_Pipeline == pipeline) {
+        m_SkippedBindCount++;
+        return;
+    }
+
+    vkCmdBindPipeline(m_CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    m_Pipeline = pipeline;
+    m_HasDescriptors = false;
+    m_BindCount++;
+}
+
+void CommandStateTracker::BindVertexBuffer(Uint32 binding, VkBuffer buffer, VkDeviceSize offset) {
+    bool isTracked = binding < 2;
+
+    if (isTracked && m_VertexBuffers[binding] == buffer && m_VertexBufferOffsets[binding] == offset) {
+        m_SkippedBindCount++;
+        return;
+    }
+
+    vkCmdBindVertexBuffers(m_CommandBuffer, binding, 1, &buffer, &offset);
+
+    if (isTracked) {
+        m_VertexBuffers[binding] = buffer;
+        m_VertexBufferOffsets[binding] = offset;
+    }
+
+    m_BindCount++;
+}
+
+void CommandStateTracker::BindIndexBuffer(VkBuffer buffer, VkIndexType indexType) {
+    if (m_IndexBuffer == buffer && m_IndexType == indexType) {
+        m_SkippedBindCount++;
+        return;
+    }
+
+    vkCmdBindIndexBuffer(m_CommandBuffer, buffer, 0, indexType);
+
+    m_IndexBuffer = buffer;
+    m_IndexType = indexType;
+    m_BindCount++;
+}
+
+bool CommandStateTracker::DescriptorsChanged(const DescriptorKey &descriptorKey) {
+    if (m_HasDescriptors && m_DescriptorKey == descriptorKey) {
+        m_SkippedBindCount++;
+        return false;
+    }
+
+    m_DescriptorKey = descriptorKey;
+    m_HasDescriptors = true;
+    m_BindCount++;
+
+    return true;
+}
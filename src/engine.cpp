@@ -15,6 +15,7 @@
 #include "fmt/base.h"
 #include "error.hpp"
 #include "fmt/format.h"
+#include "imagewriter.hpp"
 #include "isteamnetworkingsockets.h"
 #include "object.hpp"
 #include "steamclientpublic.h"
@@ -22,6 +23,8 @@
 #include "model.hpp"
 #include "steamnetworkingtypes.h"
 #include "steamtypes.h"
+#include "switch_fnv1a.h"
+#include "texturedata.hpp"
 #include "ui/arrows.hpp"
 #include "ui/button.hpp"
 #include "ui/label.hpp"
@@ -45,7 +48,9 @@
 #include <fstream>
 #include <functional>
 #include <future>
+#include <unordered_set>
 #include <glm/fwd.hpp>
+#include <glm/gtc/color_space.hpp>
 #include <iterator>
 #include <memory>
 #include <mutex>
@@ -64,14 +69,14 @@
 #include "stb/stb_image.h"
 
 
-bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char *> &deviceExtensions) {
     Uint32 extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(requiredDeviceExtensions.begin(), requiredDeviceExtensions.end());
+    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -134,13 +139,30 @@ Renderer::~Renderer() {
     if (m_EngineDevice)
         vkDeviceWaitIdle(m_EngineDevice);
 
-    if (m_FullscreenQuadVertexBuffer.buffer && m_FullscreenQuadVertexBuffer.memory) {
+    if (m_FullscreenQuadVertexBuffer.buffer && m_FullscreenQuadVertexBuffer.memory.deviceMemory) {
         vkDestroyBuffer(m_EngineDevice, m_FullscreenQuadVertexBuffer.buffer, NULL);
-        vkFreeMemory(m_EngineDevice, m_FullscreenQuadVertexBuffer.memory, NULL);
+        m_Allocator->Free(m_FullscreenQuadVertexBuffer.memory);
     }
 
-    for (RenderModel &renderModel : m_RenderModels)
-        this->UnloadModel(renderModel.model);
+    // UnloadModel erases from m_RenderModels, can't range-for over it.
+    while (!m_RenderModels.empty())
+        this->UnloadModel(m_RenderModels.front().model);
+
+    for (BufferAndMemory &instanceBuffer : m_InstanceBuffers) {
+        if (!instanceBuffer.buffer)
+            continue;
+
+        vkDestroyBuffer(m_EngineDevice, instanceBuffer.buffer, NULL);
+        m_Allocator->Free(instanceBuffer.memory);
+    }
+
+    for (BufferAndMemory &frameUBOBuffer : m_FrameUBOBuffers) {
+        if (!frameUBOBuffer.buffer)
+            continue;
+
+        vkDestroyBuffer(m_EngineDevice, frameUBOBuffer.buffer, NULL);
+        m_Allocator->Free(frameUBOBuffer.memory);
+    }
 
     for (RenderUIPanel renderPanel : m_UIPanels) {
         this->RemoveUIPanel(renderPanel.panel);
@@ -154,6 +176,9 @@ Renderer::~Renderer() {
         renderLabel.label->DestroyBuffers();
     }
 
+    // the only label the renderer owns.
+    delete m_ProfilerOverlay;
+
     for (RenderUIWaypoint &renderUIWaypoint : m_RenderUIWaypoints) {
         this->RemoveUIWaypoint(renderUIWaypoint.waypoint);
     }
@@ -162,6 +187,31 @@ Renderer::~Renderer() {
         this->RemoveUIArrows(renderUIArrows.arrows);
     }
 
+    // the device is idle, nothing has to wait for its frame anymore. Descriptor sets in there need their pools, so this can't wait until the end.
+    m_DeletionQueue->Flush();
+
+    m_GlyphAtlas.reset();
+
+    m_TextureTable.reset();
+
+    // every label let go of its font in DestroyBuffers.
+    m_FontManager.reset();
+
+    if (m_GlyphQuadBuffer.buffer) {
+        vkDestroyBuffer(m_EngineDevice, m_GlyphQuadBuffer.buffer, NULL);
+        m_Allocator->Free(m_GlyphQuadBuffer.memory);
+    }
+
+    if (m_UIInstanceBuffer.buffer) {
+        vkDestroyBuffer(m_EngineDevice, m_UIInstanceBuffer.buffer, NULL);
+        m_Allocator->Free(m_UIInstanceBuffer.memory);
+    }
+
+    SavePipelineCache();
+
+    if (m_PipelineCache)
+        vkDestroyPipelineCache(m_EngineDevice, m_PipelineCache, NULL);
+
     for (PipelineAndLayout pipelineAndLayout : m_PipelineAndLayouts) {
         vkDestroyPipeline(m_EngineDevice, pipelineAndLayout.pipeline, NULL);
         vkDestroyPipelineLayout(m_EngineDevice, pipelineAndLayout.layout, NULL);
@@ -179,15 +229,21 @@ Renderer::~Renderer() {
         vkDestroyImage(m_EngineDevice, image, NULL);
     for (VkBuffer buffer : m_AllocatedBuffers)
         vkDestroyBuffer(m_EngineDevice, buffer, NULL);
-    for (VkDeviceMemory memory : m_AllocatedMemory) {
-        //vkUnmapMemory(m_EngineDevice, memory);  // vulkan doesn't care if the memory isn't already mapped, you WILL get a warning from a validation layer tho.
-        vkFreeMemory(m_EngineDevice, memory, NULL);
-    }
+    for (MemoryAllocation &memory : m_AllocatedMemory)
+        m_Allocator->Free(memory);
     for (VkImageView imageView : m_CreatedImageViews)
         vkDestroyImageView(m_EngineDevice, imageView, NULL);
     for (VkSampler sampler : m_CreatedSamplers)
         vkDestroySampler(m_EngineDevice, sampler, NULL);
     
+    for (BufferAndMemory &readbackBuffer : m_ReadbackBuffers) {
+        if (!readbackBuffer.buffer)
+            continue;
+
+        vkDestroyBuffer(m_EngineDevice, readbackBuffer.buffer, NULL);
+        m_Allocator->Free(readbackBuffer.memory);
+    }
+
     for (VkSemaphore semaphore : m_ImageAvailableSemaphores)
         if (semaphore)
             vkDestroySemaphore(m_EngineDevice, semaphore, NULL);
@@ -233,6 +289,22 @@ Renderer::~Renderer() {
 
     if (m_CommandPool)
         vkDestroyCommandPool(m_EngineDevice, m_CommandPool, NULL);
+
+    m_SecondaryCommandRecorder.reset();
+    m_RecordingThreadPool.reset();
+    m_GPUProfiler.reset();
+
+    // still holds staging memory, so it goes before the allocator.
+    m_UploadBatcher.reset();
+    m_DeletionQueue.reset();
+
+    if (m_Allocator) {
+        if (m_Settings.Verbose)
+            m_Allocator->PrintStatistics();
+
+        /* Gives every page back to the driver, has to happen before the device goes away. */
+        m_Allocator.reset();
+    }
     
     if (m_EngineDevice)
         vkDestroyDevice(m_EngineDevice, NULL);
@@ -243,7 +315,8 @@ Renderer::~Renderer() {
     if (m_EngineWindow)
         SDL_DestroyWindow(m_EngineWindow);
 
-    SDL_Vulkan_UnloadLibrary();
+    if (!m_Settings.Headless)
+        SDL_Vulkan_UnloadLibrary();
     SDL_Quit();
 }
 
@@ -299,96 +372,191 @@ void Renderer::CopyHostBufferToDeviceBuffer(VkBuffer hostBuffer, VkBuffer device
     EndSingleTimeCommands(sharedContext, commandBuffer);
 }
 
+std::filesystem::path Renderer::GetDiffuseMapPath(Mesh &mesh) {
+    std::filesystem::path path;
+
+    if (mesh.diffuseMapPath.empty())
+        return path;
+
+    if (!mesh.diffuseMapPath.has_root_path()) {
+        // https://stackoverflow.com/a/73927710
+        auto rel = std::filesystem::relative(mesh.diffuseMapPath, "resources");
+        // map_Kd resources/brown_mud_dry_diff_4k.jpg
+        if (!rel.empty() && rel.native()[0] != '.')
+            path = mesh.diffuseMapPath;
+        // map_Kd brown_mud_dry_diff_4k.jpg
+        else
+            path = "resources" / mesh.diffuseMapPath;
+    }
+
+    std::string absoluteSourcePath = std::filesystem::absolute(path).string();
+    std::string absoluteResourcesPath = std::filesystem::absolute("resources").string();
+
+    UTILASSERT(absoluteSourcePath.substr(0, absoluteResourcesPath.length()).compare(absoluteResourcesPath) == 0);
+
+    return path;
+}
+
+std::string Renderer::GetTextureKey(const std::filesystem::path &path) {
+    std::error_code errorCode;
+    std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(path, errorCode);
+
+    return errorCode ? std::filesystem::absolute(path).string() : canonicalPath.string();
+}
+
+RenderTexture *Renderer::AcquireTexture(const std::string &key, const std::function<TextureImageAndMemory()> &createImage) {
+    auto cachedTexture = m_RenderTextures.find(key);
+
+    if (cachedTexture != m_RenderTextures.end()) {
+        cachedTexture->second->referenceCount++;
+
+        if (m_Settings.Verbose)
+            fmt::println("Texture {} is already loaded, sharing it ({} users)", key, cachedTexture->second->referenceCount);
+
+        return cachedTexture->second.get();
+    }
+
+    std::unique_ptr<RenderTexture> texture = std::make_unique<RenderTexture>();
+
+    texture->key = key;
+    texture->referenceCount = 1;
+    texture->image = createImage();
+
+    // Image view, for sampling. Might be block compressed, so use whatever format it was loaded as.
+    texture->imageView = CreateImageView(texture->image, texture->image.format, VK_IMAGE_ASPECT_COLOR_BIT, false);
+
+    // the copies went into the batch that's currently recording.
+    texture->uploadToken = m_UploadBatcher->GetRecordingToken();
+
+    if (m_TextureTable) {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(m_EnginePhysicalDevice, &properties);
+
+        texture->textureIndex = m_TextureTable->Add(texture->imageView, GetSharedSampler(properties.limits.maxSamplerAnisotropy));
+    }
+
+    RenderTexture *texturePointer = texture.get();
+
+    m_RenderTextures[key] = std::move(texture);
+
+    return texturePointer;
+}
+
+void Renderer::ReleaseTexture(RenderTexture *texture) {
+    if (--texture->referenceCount > 0)
+        return;
+
+    // frames in flight might still sample it, and the copies might not even be submitted yet.
+    m_DeletionQueue->DestroyImageView(texture->imageView);
+
+    // the slot gets handed out again once those frames are done too.
+    if (m_TextureTable)
+        m_TextureTable->Remove(texture->textureIndex);
+
+    m_DeletionQueue->DestroyImage(texture->image.imageAndMemory.image, texture->image.imageAndMemory.memory, texture->uploadToken);
+
+    m_RenderTextures.erase(texture->key);
+}
+
+VkSampler Renderer::GetSharedSampler(float maxAnisotropy) {
+    for (std::pair<float, VkSampler> &sharedSampler : m_SharedSamplers) {
+        if (sharedSampler.first == maxAnisotropy)
+            return sharedSampler.second;
+    }
+
+    // destroyed with the rest of m_CreatedSamplers.
+    VkSampler sampler = CreateSampler(maxAnisotropy, true);
+
+    m_SharedSamplers.push_back({maxAnisotropy, sampler});
+
+    return sampler;
+}
+
 // first element = diffuse
-std::array<TextureImageAndMemory, 1> Renderer::LoadTexturesFromMesh(Mesh &mesh, bool recordAllocations) {
-    std::array<TextureImageAndMemory, 1> textures;
+std::array<RenderTexture *, 1> Renderer::LoadTexturesFromMesh(Mesh &mesh, const TextureData *decodedDiffuse) {
+    std::array<RenderTexture *, 1> textures;
 
     EngineSharedContext sharedContext = GetSharedContext();
     
     {
         if (!mesh.diffuseMapPath.empty()) {
-            std::filesystem::path path;
-
-            if (!mesh.diffuseMapPath.has_root_path()) {
-                // https://stackoverflow.com/a/73927710
-                auto rel = std::filesystem::relative(mesh.diffuseMapPath, "resources");
-                // map_Kd resources/brown_mud_dry_diff_4k.jpg
-                if (!rel.empty() && rel.native()[0] != '.')
-                    path = mesh.diffuseMapPath;
-                // map_Kd brown_mud_dry_diff_4k.jpg
-                else
-                    path = "resources" / mesh.diffuseMapPath;
-            }
-
-            std::string absoluteSourcePath = std::filesystem::absolute(path).string();
-            std::string absoluteResourcesPath = std::filesystem::absolute("resources").string();
-
-            UTILASSERT(absoluteSourcePath.substr(0, absoluteResourcesPath.length()).compare(absoluteResourcesPath) == 0);
-
-            TextureBufferAndMemory textureBufferAndMemory = LoadTextureFromFile(path);
-            VkFormat textureFormat = getBestFormatFromChannels(textureBufferAndMemory.channels);
-
-            textures[0] = CreateImage(sharedContext,
-            textureBufferAndMemory.width, textureBufferAndMemory.height,
-            textureFormat, VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-                );
-            ChangeImageLayout(sharedContext, textures[0].imageAndMemory.image, 
-                        textureFormat, 
-                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-                    );
-            CopyBufferToImage(sharedContext, textureBufferAndMemory, textures[0].imageAndMemory.image);
-            ChangeImageLayout(sharedContext, textures[0].imageAndMemory.image, 
-                        textureFormat, 
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                    );
-            
-            vkDestroyBuffer(m_EngineDevice, textureBufferAndMemory.bufferAndMemory.buffer, NULL);
-            vkFreeMemory(m_EngineDevice, textureBufferAndMemory.bufferAndMemory.memory, NULL);
+            std::filesystem::path path = GetDiffuseMapPath(mesh);
 
-            m_AllocatedBuffers.erase(std::find(m_AllocatedBuffers.begin(), m_AllocatedBuffers.end(), textureBufferAndMemory.bufferAndMemory.buffer));
-            m_AllocatedMemory.erase(std::find(m_AllocatedMemory.begin(), m_AllocatedMemory.end(), textureBufferAndMemory.bufferAndMemory.memory));
+            textures[0] = AcquireTexture(GetTextureKey(path), [&]() {
+                return decodedDiffuse ? UploadTexture(*decodedDiffuse) : LoadTextureFromFile(path);
+            });
         } else {
-            textures[0] = CreateSinglePixelImage(sharedContext, mesh.diffuse);
+            // flat colors are shared too, by the color they end up as.
+            std::string key = fmt::format("#{:02x}{:02x}{:02x}", static_cast<Uint8>(mesh.diffuse.r * 255), static_cast<Uint8>(mesh.diffuse.g * 255), static_cast<Uint8>(mesh.diffuse.b * 255));
+
+            textures[0] = AcquireTexture(key, [&]() {
+                return CreateSinglePixelImage(sharedContext, mesh.diffuse);
+            });
         }
     }
 
     return textures;
 }
 
-TextureBufferAndMemory Renderer::LoadTextureFromFile(const std::string &name) {
-    int texWidth, texHeight;
-    
+TextureImageAndMemory Renderer::LoadTextureFromFile(const std::string &name) {
+    return UploadTexture(DecodeTextureFile(name));
+}
+
+TextureData Renderer::DecodeTextureFile(const std::string &name) {
+    TextureData textureData;
+
     fmt::println("Loading image {} ...", name);
-    stbi_uc *imageData = stbi_load(name.data(), &texWidth, &texHeight, nullptr, STBI_rgb_alpha);
-    VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth * texHeight * 4);
 
-    if (!imageData)
-    {
-        fmt::println("fopen() error: {}", strerror(errno));
-        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, stbi_failure_reason(), name));
-    }
+    // compressed and mipmapped offline, it goes to the GPU as it is.
+    if (std::filesystem::path(name).extension() == ".dds") {
+        textureData = loadDDS(name);
 
-    fmt::println("Image loaded ({}x{}, {} channels) with an expected buffer size of {}.", texWidth, texHeight, 4, texWidth * texHeight * 4);
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_EnginePhysicalDevice, textureData.format, &formatProperties);
 
-    EngineSharedContext sharedContext = GetSharedContext();
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+            throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, fmt::format("this device can't sample {}", string_VkFormat(textureData.format)), name));
+
+        fmt::println("Image loaded ({}x{}, {}, {} mip levels).", textureData.levels[0].width, textureData.levels[0].height, string_VkFormat(textureData.format), textureData.levels.size());
+    } else {
+        int texWidth, texHeight;
+
+        stbi_uc *imageData = stbi_load(name.data(), &texWidth, &texHeight, nullptr, STBI_rgb_alpha);
+
+        if (!imageData)
+        {
+            fmt::println("fopen() error: {}", strerror(errno));
+            throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, stbi_failure_reason(), name));
+        }
+
+        fmt::println("Image loaded ({}x{}, {} channels) with an expected buffer size of {}.", texWidth, texHeight, 4, texWidth * texHeight * 4);
+
+        textureData = makeRGBA8TextureData(imageData, texWidth, texHeight, getBestFormatFromChannels(4));
+
+        stbi_image_free(imageData);
 
-    VkBuffer imageStagingBuffer;
-    VkDeviceMemory imageStagingMemory;
+        // CPU side, so it works on a transfer-only queue too. Costs about a third more memory than the first level alone.
+        generateMipChain(textureData);
+    }
 
-    AllocateBuffer(sharedContext, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, imageStagingBuffer, imageStagingMemory);
-    m_AllocatedBuffers.push_back(imageStagingBuffer);
-    m_AllocatedMemory.push_back(imageStagingMemory);
+    return textureData;
+}
 
-    void *data;
-    vkMapMemory(m_EngineDevice, imageStagingMemory, 0, imageSize, 0, &data);
-    SDL_memcpy(data, imageData, imageSize);
-    vkUnmapMemory(m_EngineDevice, imageStagingMemory);
+TextureImageAndMemory Renderer::UploadTexture(const TextureData &textureData) {
+    EngineSharedContext sharedContext = GetSharedContext();
 
-    stbi_image_free(imageData);
+    TextureImageAndMemory texture = CreateImage(sharedContext,
+    textureData.levels[0].width, textureData.levels[0].height,
+    textureData.format, VK_IMAGE_TILING_OPTIMAL,
+    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+    textureData.levels.size()
+        );
 
-    return {{imageStagingBuffer, imageStagingMemory}, (Uint32)texWidth, (Uint32)texHeight, (Uint8)4};
+    // the batcher copies every level into its own staging buffer, textureData can go right away.
+    m_UploadBatcher->UploadImage(texture.imageAndMemory.image, textureData.data.data(), textureData.data.size(), textureData.levels);
+
+    return texture;
 }
 
 VkImageView Renderer::CreateImageView(TextureImageAndMemory &imageAndMemory, VkFormat format, VkImageAspectFlags aspectMask, bool recordCreation) {
@@ -401,7 +569,7 @@ VkImageView Renderer::CreateImageView(TextureImageAndMemory &imageAndMemory, VkF
     imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
     imageViewCreateInfo.subresourceRange.layerCount = 1;
     imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    imageViewCreateInfo.subresourceRange.levelCount = 1;
+    imageViewCreateInfo.subresourceRange.levelCount = imageAndMemory.mipLevels;
 
     VkImageView imageView;
     if (vkCreateImageView(m_EngineDevice, &imageViewCreateInfo, NULL, &imageView) != VK_SUCCESS)
@@ -431,7 +599,8 @@ VkSampler Renderer::CreateSampler(float maxAnisotropy, bool recordCreation) {
     samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerCreateInfo.mipLodBias = 0.0f;
     samplerCreateInfo.minLod = 0.0f;
-    samplerCreateInfo.maxLod = 0.0f;
+    // as many levels as the image view has.
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     VkSampler sampler;
     if (vkCreateSampler(m_EngineDevice, &samplerCreateInfo, NULL, &sampler) != VK_SUCCESS)
@@ -459,44 +628,98 @@ VkFormat Renderer::FindBestFormat(const std::vector<VkFormat>& candidates, VkIma
     throw std::runtime_error(engineError::CANT_FIND_ANY_FORMAT);
 }
 
-RenderModel Renderer::LoadMesh(Mesh &mesh, Model *model, bool loadTextures) {
+/* Meshes with the same key share one RenderMesh, empty if the mesh can't be shared.
+ * untextured meshes (UI arrows) are never shared, they'd end up drawn with someone elses missing texture otherwise. */
+static std::string getRenderMeshKey(const Mesh &mesh, bool loadTextures) {
+    // the same mesh quantized and not are two different vertex buffers.
+    if (loadTextures && !mesh.sourceFile.empty() && mesh.sourceMeshIndex >= 0)
+        return fmt::format("{}:{}{}", mesh.sourceFile, mesh.sourceMeshIndex, mesh.isQuantized ? ":quantized" : "");
+
+    return "";
+}
+
+RenderModel Renderer::LoadMesh(Mesh &mesh, Model *model, bool loadTextures, const TextureData *decodedDiffuse) {
     EngineSharedContext sharedContext = GetSharedContext();
 
     RenderModel renderModel{};
 
     renderModel.model = model;
+    renderModel.localBoundingBox = mesh.GetRawBoundingBox();
 
-    BufferAndMemory vertexBuffer = CreateVertexBuffer(sharedContext, mesh.vertices);
-    renderModel.vertexBuffer = vertexBuffer;
+    // no vertices, the box was never grown past its starting (inverted) value.
+    if (glm::any(glm::lessThan(renderModel.localBoundingBox[0], renderModel.localBoundingBox[1])))
+        renderModel.localBoundingBox = {glm::vec3(0.0f), glm::vec3(0.0f)};
 
-    renderModel.indexBufferSize = mesh.indices.size();
-    renderModel.indexBuffer = CreateIndexBuffer(sharedContext, mesh.indices);
+    std::string key = getRenderMeshKey(mesh, loadTextures);
 
-    if (loadTextures) {
-        std::array<TextureImageAndMemory, 1> meshTextures = LoadTexturesFromMesh(mesh, false);
-        renderModel.diffTexture = meshTextures[0];
+    if (!key.empty()) {
+        auto sharedRenderMesh = m_SharedRenderMeshes.find(key);
+
+        if (sharedRenderMesh != m_SharedRenderMeshes.end()) {
+            renderModel.mesh = sharedRenderMesh->second;
+            renderModel.mesh->referenceCount++;
+
+            if (m_Settings.Verbose)
+                fmt::println("Mesh {} is already loaded, sharing it ({} users)", key, renderModel.mesh->referenceCount);
+
+            return renderModel;
+        }
+    }
+
+    std::unique_ptr<RenderMesh> renderMesh = std::make_unique<RenderMesh>();
+
+    renderMesh->key = key;
+    renderMesh->referenceCount = 1;
+
+    if (mesh.isQuantized) {
+        renderMesh->isQuantized = true;
+        renderMesh->quantizationParameters = getQuantizationParameters(mesh.GetRawBoundingBox());
+
+        std::vector<QuantizedVertex> vertices(mesh.vertices.size());
+
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+            vertices[i] = quantizeVertex(mesh.vertices[i], renderMesh->quantizationParameters);
 
-        VkFormat textureFormat = getBestFormatFromChannels(renderModel.diffTexture.channels);
+        renderMesh->vertexBuffer = CreateVertexBuffer(sharedContext, vertices);
+    } else {
+        renderMesh->vertexBuffer = CreateVertexBuffer(sharedContext, mesh.vertices);
+    }
+
+    renderMesh->indexBufferSize = mesh.indices.size();
 
-        // Image view, for sampling.
-        renderModel.diffTextureImageView = CreateImageView(renderModel.diffTexture, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, false);
+    // 0xFFFF is left out, it's the restart index if primitive restart ever gets turned on.
+    if (mesh.vertices.size() < 0xFFFF) {
+        std::vector<Uint16> indices(mesh.indices.begin(), mesh.indices.end());
+
+        renderMesh->indexBuffer = CreateIndexBuffer(sharedContext, indices);
+        renderMesh->indexType = VK_INDEX_TYPE_UINT16;
+    } else {
+        renderMesh->indexBuffer = CreateIndexBuffer(sharedContext, mesh.indices);
+    }
+
+    if (loadTextures) {
+        std::array<RenderTexture *, 1> meshTextures = LoadTexturesFromMesh(mesh, decodedDiffuse);
+        renderMesh->diffTexture = meshTextures[0];
 
         VkPhysicalDeviceProperties properties{};
         vkGetPhysicalDeviceProperties(m_EnginePhysicalDevice, &properties);
 
-        renderModel.diffTextureSampler = CreateSampler(properties.limits.maxSamplerAnisotropy, false);
+        renderMesh->diffTextureImageView = renderMesh->diffTexture->imageView;
+        renderMesh->diffTextureSampler = GetSharedSampler(properties.limits.maxSamplerAnisotropy);
+        renderMesh->textureIndex = renderMesh->diffTexture->textureIndex;
     }
 
-    renderModel.diffColor = mesh.diffuse;
+    renderMesh->diffColor = mesh.diffuse;
 
-    // UBO
-    VkDeviceSize uniformBufferSize = sizeof(MatricesUBO);
+    // everything above went into the batch that's currently recording.
+    renderMesh->uploadToken = m_UploadBatcher->GetRecordingToken();
 
-    renderModel.matricesUBO = {glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f)};
+    renderModel.mesh = renderMesh.get();
 
-    AllocateBuffer(sharedContext, uniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, renderModel.matricesUBOBuffer.buffer, renderModel.matricesUBOBuffer.memory);
+    if (!key.empty())
+        m_SharedRenderMeshes[key] = renderMesh.get();
 
-    vkMapMemory(m_EngineDevice, renderModel.matricesUBOBuffer.memory, 0, uniformBufferSize, 0, &renderModel.matricesUBOBuffer.mappedData);
+    m_RenderMeshes.push_back(std::move(renderMesh));
 
     return renderModel;
 }
@@ -510,42 +733,186 @@ void Renderer::SetPrimaryCamera(Camera *cam) {
 }
 
 void Renderer::LoadModel(Model *model) {
-    std::vector<std::future<RenderModel>> tasks;
+    LoadModels({model});
+}
+
+void Renderer::LoadModels(const std::vector<Model *> &models, const std::unordered_map<std::string, TextureData> *decodedTextures, bool isHidden) {
+    struct PendingTexture {
+        std::string key;
+        std::filesystem::path path;
+    };
+
+    std::vector<PendingTexture> pendingTextures;
+    std::unordered_set<std::string> pendingKeys;
+    std::unordered_set<std::string> pendingTextureKeys;
+    std::unordered_map<Mesh *, std::string> meshTextureKeys;
+
+    // only meshes that are about to get their own RenderMesh need their texture, shared ones already have it.
+    // every file is decoded once, the first mesh that uses it uploads it and the rest find it in the texture cache.
+    for (Model *model : models) {
+        for (Mesh &mesh : model->meshes) {
+            if (mesh.diffuseMapPath.empty())
+                continue;
+
+            std::string key = getRenderMeshKey(mesh, true);
+
+            if (!key.empty() && (m_SharedRenderMeshes.find(key) != m_SharedRenderMeshes.end() || !pendingKeys.insert(key).second))
+                continue;
+
+            std::filesystem::path path = GetDiffuseMapPath(mesh);
+            std::string textureKey = GetTextureKey(path);
 
-    for (Mesh &mesh : model->meshes) {
-        tasks.push_back(std::async(std::launch::deferred, &Renderer::LoadMesh, this, std::ref(mesh), model, true));
+            meshTextureKeys[&mesh] = textureKey;
+
+            if (m_RenderTextures.find(textureKey) != m_RenderTextures.end() || (decodedTextures && decodedTextures->find(textureKey) != decodedTextures->end()))
+                continue;
+
+            if (pendingTextureKeys.insert(textureKey).second)
+                pendingTextures.push_back({textureKey, path});
+        }
+    }
+
+    std::vector<TextureData> pendingTextureData(pendingTextures.size());
+
+    // decoding and mip generation are most of the load time, and they don't need the device.
+    m_RecordingThreadPool->Dispatch(pendingTextures.size(), [&](Uint32 threadIndex, Uint32 textureIndex) {
+        pendingTextureData[textureIndex] = DecodeTextureFile(pendingTextures[textureIndex].path);
+    });
+
+    std::unordered_map<std::string, const TextureData *> textures;
+
+    if (decodedTextures) {
+        for (const auto &decodedTexture : *decodedTextures)
+            textures[decodedTexture.first] = &decodedTexture.second;
     }
 
+    for (size_t i = 0; i < pendingTextures.size(); i++)
+        textures[pendingTextures[i].key] = &pendingTextureData[i];
+
     // Any exception here is going to just happen and get caught like a regular engine error.
-    for (std::future<RenderModel> &task : tasks) {
-        m_RenderModels.push_back(task.share().get());
+    for (Model *model : models) {
+        for (Mesh &mesh : model->meshes) {
+            const TextureData *decodedDiffuse = nullptr;
+            auto meshTextureKey = meshTextureKeys.find(&mesh);
+
+            if (meshTextureKey != meshTextureKeys.end()) {
+                auto texture = textures.find(meshTextureKey->second);
+
+                if (texture != textures.end())
+                    decodedDiffuse = texture->second;
+            }
+
+            RenderModel renderModel = LoadMesh(mesh, model, true, decodedDiffuse);
+
+            renderModel.modelMatrix = model->GetModelMatrix();
+            renderModel.isHidden = isHidden;
+
+            AABB worldBox = AABB::FromBoundingBox(transformBoundingBox(renderModel.localBoundingBox, renderModel.modelMatrix));
+            renderModel.cullingProxy = m_ModelTree.CreateProxy(worldBox, m_RenderModels.size());
+
+            m_RenderModels.push_back(renderModel);
+        }
     }
 
-    return;
+    // the models get drawn once this finishes, no need to wait for it.
+    m_UploadBatcher->Submit();
+}
+
+std::unordered_map<std::string, TextureData> Renderer::DecodeModelTextures(const std::vector<Model *> &models, ThreadPool &threadPool) {
+    struct PendingTexture {
+        std::string key;
+        std::filesystem::path path;
+    };
+
+    std::vector<PendingTexture> pendingTextures;
+    std::unordered_set<std::string> pendingTextureKeys;
+
+    for (Model *model : models) {
+        for (Mesh &mesh : model->meshes) {
+            if (mesh.diffuseMapPath.empty())
+                continue;
+
+            std::filesystem::path path = GetDiffuseMapPath(mesh);
+            std::string textureKey = GetTextureKey(path);
+
+            if (pendingTextureKeys.insert(textureKey).second)
+                pendingTextures.push_back({textureKey, path});
+        }
+    }
+
+    std::vector<TextureData> pendingTextureData(pendingTextures.size());
+
+    threadPool.Dispatch(pendingTextures.size(), [&](Uint32 threadIndex, Uint32 textureIndex) {
+        pendingTextureData[textureIndex] = DecodeTextureFile(pendingTextures[textureIndex].path);
+    });
+
+    std::unordered_map<std::string, TextureData> textures;
+
+    for (size_t i = 0; i < pendingTextures.size(); i++)
+        textures[pendingTextures[i].key] = std::move(pendingTextureData[i]);
+
+    return textures;
 }
 
 void Renderer::UnloadRenderModel(RenderModel &renderModel) {
-    vkDeviceWaitIdle(m_EngineDevice);
+    RenderMesh *renderMesh = renderModel.mesh;
+
+    renderModel.mesh = nullptr;
 
-    if (renderModel.diffTextureImageView)
-        vkDestroyImageView(m_EngineDevice, renderModel.diffTextureImageView, NULL);
+    if (!renderMesh || --renderMesh->referenceCount > 0)
+        return;
+
+    if (renderMesh->diffTexture)
+        ReleaseTexture(renderMesh->diffTexture);
+
+    // frames in flight might still draw it, and the copies might not even be submitted yet.
+    m_DeletionQueue->DestroyBuffer(renderMesh->indexBuffer.buffer, renderMesh->indexBuffer.memory, renderMesh->uploadToken);
+    m_DeletionQueue->DestroyBuffer(renderMesh->vertexBuffer.buffer, renderMesh->vertexBuffer.memory, renderMesh->uploadToken);
 
-    if (renderModel.diffTexture.imageAndMemory.image) {
-        vkDestroyImage(m_EngineDevice, renderModel.diffTexture.imageAndMemory.image, NULL);
-        vkFreeMemory(m_EngineDevice, renderModel.diffTexture.imageAndMemory.memory, NULL);
+    if (!renderMesh->key.empty())
+        m_SharedRenderMeshes.erase(renderMesh->key);
+
+    for (size_t i = 0; i < m_RenderMeshes.size(); i++) {
+        if (m_RenderMeshes[i].get() != renderMesh)
+            continue;
+
+        m_RenderMeshes.erase(m_RenderMeshes.begin() + i);
+        break;
     }
+}
 
-    if (renderModel.diffTextureSampler)
-        vkDestroySampler(m_EngineDevice, renderModel.diffTextureSampler, NULL);
-    
-    vkDestroyBuffer(m_EngineDevice, renderModel.indexBuffer.buffer, NULL);
-    vkFreeMemory(m_EngineDevice, renderModel.indexBuffer.memory, NULL);
+void Renderer::ReserveInstanceBuffer(Uint32 frameIndex, Uint32 instanceCount) {
+    if (instanceCount <= m_InstanceBufferCapacities[frameIndex])
+        return;
+
+    BufferAndMemory &instanceBuffer = m_InstanceBuffers[frameIndex];
+
+    // nothing can be using it, the frame's fence was already waited on.
+    if (instanceBuffer.buffer) {
+        vkDestroyBuffer(m_EngineDevice, instanceBuffer.buffer, NULL);
+        m_Allocator->Free(instanceBuffer.memory);
+    }
+
+    Uint32 capacity = std::max<Uint32>(m_InstanceBufferCapacities[frameIndex] * 2, 64);
+    while (capacity < instanceCount)
+        capacity *= 2;
+
+    EngineSharedContext sharedContext = GetSharedContext();
+
+    AllocateBuffer(sharedContext, capacity * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffer.buffer, instanceBuffer.memory);
+
+    instanceBuffer.mappedData = instanceBuffer.memory.mappedData;
 
-    vkDestroyBuffer(m_EngineDevice, renderModel.vertexBuffer.buffer, NULL);
-    vkFreeMemory(m_EngineDevice, renderModel.vertexBuffer.memory, NULL);
+    m_InstanceBufferCapacities[frameIndex] = capacity;
+}
+
+void Renderer::ShowModels(const std::vector<Model *> &models) {
+    std::unordered_set<Model *> shownModels(models.begin(), models.end());
 
-    vkDestroyBuffer(m_EngineDevice, renderModel.matricesUBOBuffer.buffer, NULL);
-    vkFreeMemory(m_EngineDevice, renderModel.matricesUBOBuffer.memory, NULL);
+    for (RenderModel &renderModel : m_RenderModels) {
+        if (shownModels.find(renderModel.model) != shownModels.end())
+            renderModel.isHidden = false;
+    }
 }
 
 void Renderer::UnloadModel(Model *model) {
@@ -557,11 +924,101 @@ void Renderer::UnloadModel(Model *model) {
 
         m_RenderModels.erase(m_RenderModels.begin() + (i--));
 
+        if (renderModel.cullingProxy != AABB_TREE_NULL_NODE)
+            m_ModelTree.DestroyProxy(renderModel.cullingProxy);
+
         UnloadRenderModel(renderModel);
 
         // Since now, the Model object is now owned by the caller.
         // delete model; // delete the pointer to the Model object
     }
+
+    // everything after the erased models moved down.
+    for (size_t i = 0; i < m_RenderModels.size(); i++)
+        if (m_RenderModels[i].cullingProxy != AABB_TREE_NULL_NODE)
+            m_ModelTree.SetUserData(m_RenderModels[i].cullingProxy, i);
+}
+
+void Renderer::CullRenderModels(const glm::mat4 &viewProjection) {
+    for (RenderModel &renderModel : m_RenderModels) {
+        glm::mat4 modelMatrix = renderModel.model->GetModelMatrix();
+
+        if (modelMatrix == renderModel.modelMatrix)
+            continue;
+
+        renderModel.modelMatrix = modelMatrix;
+
+        m_ModelTree.MoveProxy(renderModel.cullingProxy, AABB::FromBoundingBox(transformBoundingBox(renderModel.localBoundingBox, modelMatrix)));
+    }
+
+    m_RenderModelVisibility.assign(m_RenderModels.size(), false);
+
+    m_VisibleRenderModels.clear();
+    m_ModelTree.QueryFrustum(Frustum::FromMatrix(viewProjection), m_VisibleRenderModels);
+
+    for (Uint32 renderModelIndex : m_VisibleRenderModels)
+        m_RenderModelVisibility[renderModelIndex] = !m_RenderModels[renderModelIndex].isHidden;
+}
+
+void Renderer::RecordSubpassInParallel(VkCommandBuffer primaryCommandBuffer, VkRenderPass renderPass, Uint32 subpass, VkFramebuffer framebuffer, size_t itemCount, Uint32 profilerScope, const std::function<void(VkCommandBuffer, CommandStateTracker &, size_t, size_t)> &record) {
+    // executing nothing isn't allowed, an empty subpass is fine though.
+    if (itemCount == 0)
+        return;
+
+    size_t chunkCount = std::clamp<size_t>(itemCount / RECORDING_MIN_ITEMS_PER_CHUNK, 1, m_RecordingThreadPool->GetThreadCount());
+    size_t chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+
+    // rounding up might've left the last chunk empty.
+    chunkCount = (itemCount + chunkSize - 1) / chunkSize;
+
+    m_SecondaryCommandBuffers.resize(chunkCount);
+
+    m_RecordingThreadPool->Dispatch(chunkCount, [&](Uint32 threadIndex, Uint32 chunkIndex) {
+        size_t first = chunkIndex * chunkSize;
+        size_t last = std::min(first + chunkSize, itemCount);
+
+        VkCommandBuffer commandBuffer = m_SecondaryCommandRecorder->Begin(threadIndex, renderPass, subpass, framebuffer);
+
+        // the primary buffer can't write anything inside this subpass, the chunks run in order so the first and last one do it instead.
+        if (chunkIndex == 0)
+            m_GPUProfiler->WriteBeginTimestamp(commandBuffer, profilerScope);
+
+        record(commandBuffer, m_SecondaryCommandRecorder->GetStateTracker(threadIndex), first, last);
+
+        if (chunkIndex == chunkCount - 1)
+            m_GPUProfiler->WriteEndTimestamp(commandBuffer, profilerScope);
+
+        m_SecondaryCommandRecorder->End(commandBuffer);
+
+        m_SecondaryCommandBuffers[chunkIndex] = commandBuffer;
+    });
+
+    vkCmdExecuteCommands(primaryCommandBuffer, m_SecondaryCommandBuffers.size(), m_SecondaryCommandBuffers.data());
+}
+
+void Renderer::UpdateProfilerOverlay() {
+    std::string text = fmt::format("CPU {:.2f}ms", m_CPUFrameMilliseconds);
+
+    for (GPUProfilerResult &result : m_GPUProfiler->GetResults())
+        text += fmt::format("\n{} {:.2f}ms", result.name, result.averageMilliseconds);
+
+    if (!m_ProfilerOverlay) {
+        EngineSharedContext sharedContext = GetSharedContext();
+
+        // top left corner, the label pass comes after everything else.
+        m_ProfilerOverlay = new UI::Label(sharedContext, text, m_Settings.ProfilerOverlayFont);
+        AddUILabel(m_ProfilerOverlay);
+
+        return;
+    }
+
+    m_ProfilerOverlay->SetText(text);
+}
+
+void Renderer::DefragmentMemory() {
+    // whatever was just unloaded is still sitting in the deletion queue, the pages aren't empty yet.
+    m_IsDefragmentPending = true;
+    m_DefragmentFrameNumber = m_FrameNumber;
 }
 
 void Renderer::AddUIChildren(UI::GenericElement *element) {
@@ -632,7 +1089,7 @@ void Renderer::AddUIWaypoint(UI::Waypoint *waypoint) {
 
     AllocateBuffer(sharedContext, matricesUniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, renderUIWaypoint.matricesUBOBuffer.buffer, renderUIWaypoint.matricesUBOBuffer.memory);
 
-    vkMapMemory(m_EngineDevice, renderUIWaypoint.matricesUBOBuffer.memory, 0, matricesUniformBufferSize, 0, &renderUIWaypoint.matricesUBOBuffer.mappedData);
+    renderUIWaypoint.matricesUBOBuffer.mappedData = renderUIWaypoint.matricesUBOBuffer.memory.mappedData;
 
     // waypoint UBO
     VkDeviceSize waypointUniformBufferSize = sizeof(UIWaypointUBO);
@@ -641,7 +1098,7 @@ void Renderer::AddUIWaypoint(UI::Waypoint *waypoint) {
 
     AllocateBuffer(sharedContext, waypointUniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, renderUIWaypoint.waypointUBOBuffer.buffer, renderUIWaypoint.waypointUBOBuffer.memory);
 
-    vkMapMemory(m_EngineDevice, renderUIWaypoint.waypointUBOBuffer.memory, 0, waypointUniformBufferSize, 0, &renderUIWaypoint.waypointUBOBuffer.mappedData);
+    renderUIWaypoint.waypointUBOBuffer.mappedData = renderUIWaypoint.waypointUBOBuffer.memory.mappedData;
 
     std::array<VkDescriptorSetLayout, 1> layouts = { m_UIWaypointDescriptorSetLayout };
     VkDescriptorSetAllocateInfo allocInfo = {};
@@ -691,8 +1148,6 @@ void Renderer::AddUIWaypoint(UI::Waypoint *waypoint) {
 }
 
 void Renderer::AddUIArrows(UI::Arrows *arrows) {
-    EngineSharedContext sharedContext = GetSharedContext();
-
     RenderUIArrows renderUIArrows{};
 
     renderUIArrows.arrows = arrows;
@@ -702,26 +1157,6 @@ void Renderer::AddUIArrows(UI::Arrows *arrows) {
     renderUIArrows.arrowRenderModels[1] = LoadMesh(arrows->arrowsObject->GetModelAttachments()[0]->meshes[1], arrows->arrowsObject->GetModelAttachments()[0], false);
     renderUIArrows.arrowRenderModels[2] = LoadMesh(arrows->arrowsObject->GetModelAttachments()[0]->meshes[2], arrows->arrowsObject->GetModelAttachments()[0], false);
 
-    for (auto &arrowBuffer : renderUIArrows.arrowBuffers) {
-        // matrices UBO
-        VkDeviceSize matricesUniformBufferSize = sizeof(MatricesUBO);
-
-        arrowBuffer.first.first = {glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f)};
-
-        AllocateBuffer(sharedContext, matricesUniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, arrowBuffer.second.first.buffer, arrowBuffer.second.first.memory);
-
-        vkMapMemory(m_EngineDevice, arrowBuffer.second.first.memory, 0, matricesUniformBufferSize, 0, &arrowBuffer.second.first.mappedData);
-
-        // waypoint UBO
-        VkDeviceSize arrowsUniformBufferSize = sizeof(UIArrowsUBO);
-
-        arrowBuffer.first.second = {glm::vec3(1.0f, 1.0f, 1.0f)};
-
-        AllocateBuffer(sharedContext, arrowsUniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, arrowBuffer.second.second.buffer, arrowBuffer.second.second.memory);
-
-        vkMapMemory(m_EngineDevice, arrowBuffer.second.second.memory, 0, arrowsUniformBufferSize, 0, &arrowBuffer.second.second.mappedData);
-    }
-
     m_RenderUIArrows.push_back(renderUIArrows);
 }
 
@@ -740,18 +1175,6 @@ bool Renderer::RemoveUIArrows(UI::Arrows *arrows) {
 
         m_RenderUIArrows.erase(m_RenderUIArrows.begin() + (i--));
 
-        // Before we start, wait for the device to be idle
-        // This is already called in ~Engine, but sometimes the user calls RemoveWaypoint manually.
-        vkDeviceWaitIdle(m_EngineDevice);
-
-        for (auto &arrowBuffer : renderUIArrows.arrowBuffers) {
-            vkDestroyBuffer(m_EngineDevice, arrowBuffer.second.first.buffer, NULL);
-            vkFreeMemory(m_EngineDevice, arrowBuffer.second.first.memory, NULL);
-
-            vkDestroyBuffer(m_EngineDevice, arrowBuffer.second.second.buffer, NULL);
-            vkFreeMemory(m_EngineDevice, arrowBuffer.second.second.memory, NULL);
-        }
-
         for (RenderModel &renderModel : renderUIArrows.arrowRenderModels) {
             UnloadRenderModel(renderModel);
         }
@@ -775,22 +1198,15 @@ bool Renderer::RemoveUIWaypoint(UI::Waypoint *waypoint) {
 
         m_RenderUIWaypoints.erase(m_RenderUIWaypoints.begin() + i);
 
-        // Before we start, wait for the device to be idle
-        // This is already called in ~Engine, but sometimes the user calls RemoveWaypoint manually.
-        vkDeviceWaitIdle(m_EngineDevice);
-
         // vkDestroyImageView(m_EngineDevice, renderModel.diffTextureImageView, NULL);
         // vkDestroyImage(m_EngineDevice, renderModel.diffTexture.imageAndMemory.image, NULL);
         // vkFreeMemory(m_EngineDevice, renderModel.diffTexture.imageAndMemory.memory, NULL);
         // vkDestroySampler(m_EngineDevice, renderModel.diffTextureSampler, NULL);
 
-        vkDestroyBuffer(m_EngineDevice, renderUIWaypoint.matricesUBOBuffer.buffer, NULL);
-        vkFreeMemory(m_EngineDevice, renderUIWaypoint.matricesUBOBuffer.memory, NULL);
+        m_DeletionQueue->DestroyBuffer(renderUIWaypoint.matricesUBOBuffer.buffer, renderUIWaypoint.matricesUBOBuffer.memory);
+        m_DeletionQueue->DestroyBuffer(renderUIWaypoint.waypointUBOBuffer.buffer, renderUIWaypoint.waypointUBOBuffer.memory);
 
-        vkDestroyBuffer(m_EngineDevice, renderUIWaypoint.waypointUBOBuffer.buffer, NULL);
-        vkFreeMemory(m_EngineDevice, renderUIWaypoint.waypointUBOBuffer.memory, NULL);
-
-        vkFreeDescriptorSets(m_EngineDevice, m_UIWaypointDescriptorPool, 1, &renderUIWaypoint.descriptorSet);
+        m_DeletionQueue->FreeDescriptorSet(m_UIWaypointDescriptorPool, renderUIWaypoint.descriptorSet);
     }
 
     AddUIChildren(waypoint);
@@ -802,18 +1218,11 @@ void Renderer::AddUIPanel(UI::Panel *panel) {
     RenderUIPanel renderUIPanel{};
 
     renderUIPanel.panel = panel;
-    renderUIPanel.textureView = CreateImageView(panel->texture, panel->texture.format, VK_IMAGE_ASPECT_COLOR_BIT, false);
-    renderUIPanel.textureSampler = CreateSampler(1.0f, false);
-
-    renderUIPanel.ubo.Dimensions = panel->GetDimensions();
-    renderUIPanel.ubo.Depth = panel->GetDepth();
-
-    EngineSharedContext sharedContext = GetSharedContext();
-
-    AllocateBuffer(sharedContext, sizeof(renderUIPanel.ubo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, renderUIPanel.uboBuffer.buffer, renderUIPanel.uboBuffer.memory);
-    vkMapMemory(m_EngineDevice, renderUIPanel.uboBuffer.memory, 0, sizeof(renderUIPanel.ubo), 0, &(renderUIPanel.uboBuffer.mappedData));
 
+    // nothing to create, it only becomes an instance the next time the UI is laid out.
     m_UIPanels.push_back(renderUIPanel);
+
+    m_UILayoutDirty = true;
 }
 
 bool Renderer::RemoveUIPanel(UI::Panel *panel) {
@@ -832,13 +1241,7 @@ bool Renderer::RemoveUIPanel(UI::Panel *panel) {
 
         m_UIPanels.erase(m_UIPanels.begin() + i);
 
-        vkDeviceWaitIdle(m_EngineDevice);
-
-        vkDestroySampler(m_EngineDevice, renderUIPanel.textureSampler, NULL);
-        vkDestroyImageView(m_EngineDevice, renderUIPanel.textureView, NULL);
-
-        vkDestroyBuffer(m_EngineDevice, renderUIPanel.uboBuffer.buffer, NULL);
-        vkFreeMemory(m_EngineDevice, renderUIPanel.uboBuffer.memory, NULL);
+        m_UILayoutDirty = true;
 
         break;
     }
@@ -847,70 +1250,137 @@ bool Renderer::RemoveUIPanel(UI::Panel *panel) {
 }
 
 void Renderer::AddUILabel(UI::Label *label) {
-    EngineSharedContext sharedContext = GetSharedContext();
-
     RenderUILabel renderUILabel{};
 
     renderUILabel.label = label;
 
-    for (auto &glyph : label->Glyphs) {
-        auto glyphBuffer = glyph.glyphBuffer.value();
+    /* Group the glyphs by atlas page, so each page the label uses is one draw. */
+    std::vector<const Glyph *> glyphs;
+    for (auto &glyph : label->Glyphs)
+        glyphs.push_back(&glyph);
+
+    std::stable_sort(glyphs.begin(), glyphs.end(), [](const Glyph *a, const Glyph *b) { return a->atlasRegion->page < b->atlasRegion->page; });
+
+    for (const Glyph *glyph : glyphs) {
+        if (renderUILabel.glyphInstanceRanges.empty() || renderUILabel.glyphInstanceRanges.back().page != glyph->atlasRegion->page)
+            renderUILabel.glyphInstanceRanges.push_back({glyph->atlasRegion->page, static_cast<Uint32>(renderUILabel.glyphInstances.size()), 0});
+
+        renderUILabel.glyphInstanceRanges.back().instanceCount++;
+
+        renderUILabel.glyphInstances.push_back({glm::vec4(glyph->offset, glyph->scale), glyph->atlasRegion->uvRect});
+    }
+
+    m_UILabels.push_back(renderUILabel);
+
+    m_UILayoutDirty = true;
+}
+
+bool Renderer::RemoveUILabel(UI::Label *label) {
+    RemoveUIChildren(label);
+
+    bool found = false;
+
+    for (size_t i = 0; i < m_UILabels.size(); i++) {
+        RenderUILabel renderUILabel = m_UILabels[i];
+
+        if (renderUILabel.label != label) {
+            continue;
+        }
+
+        found = true;
+
+        m_UILabels.erase(m_UILabels.begin() + i);
+
+        m_UILayoutDirty = true;
+
+        break;
+    }
+
+    return found;
+}
+
+void Renderer::UpdateUILayout() {
+    std::vector<UIInstance> instances;
+
+    /* Panels blend, so they go back to front. Instances are drawn in order, so sorting them is all it takes. */
+    m_UIPanelDrawList.Clear();
+
+    for (size_t i = 0; i < m_UIPanels.size(); i++) {
+        if (!m_UIPanels[i].panel->GetVisible()) {
+            continue;
+        }
+
+        m_UIPanelDrawList.Add(DrawList::MakeBlendedKey(0, 0, 0, m_UIPanels[i].panel->GetDepth()), i);
+    }
 
-        VkImageView textureView = CreateImageView(glyphBuffer.first, glyphBuffer.first.format, VK_IMAGE_ASPECT_COLOR_BIT, false);
-        VkSampler textureSampler = CreateSampler(1.0f, false);
+    m_UIPanelDrawList.Sort();
 
-        renderUILabel.textureShaderData.push_back(std::make_pair(glyph.character, std::make_pair(textureView, textureSampler)));
-    }
+    for (const DrawCommand &drawCommand : m_UIPanelDrawList.GetCommands()) {
+        UI::Panel *panel = m_UIPanels[drawCommand.index].panel;
 
-    renderUILabel.ubo.PositionOffset = label->GetPosition();
-    renderUILabel.ubo.PositionOffset *= 2;
+        UIInstance instance{};
+        instance.Rect = panel->GetDimensions();
 
-    renderUILabel.ubo.Depth = label->GetDepth();
+        /* Double the scales for some odd reason.. */
+        instance.Rect.z *= 2;
+        instance.Rect.w *= 2;
 
-    AllocateBuffer(sharedContext, sizeof(renderUILabel.ubo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, renderUILabel.uboBuffer.buffer, renderUILabel.uboBuffer.memory);
-    vkMapMemory(m_EngineDevice, renderUILabel.uboBuffer.memory, 0, sizeof(renderUILabel.ubo), 0, &(renderUILabel.uboBuffer.mappedData));
+        /* Convert [0, 1] to [-1, 1] */
+        instance.Rect.x = instance.Rect.x * 2 - 1;
+        instance.Rect.y = instance.Rect.y * 2 - 1;
 
-    m_UILabels.push_back(renderUILabel);
-}
+        instance.UVRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 
-bool Renderer::RemoveUILabel(UI::Label *label) {
-    RemoveUIChildren(label);
+        // panel colors are given in sRGB, the render target encodes whatever we write.
+        instance.Color = glm::vec4(glm::convertSRGBToLinear(panel->GetColor()), 1.0f);
+        instance.Depth = panel->GetDepth();
 
-    bool found = false;
+        instances.push_back(instance);
+    }
 
-    for (size_t i = 0; i < m_UILabels.size(); i++) {
-        RenderUILabel renderUILabel = m_UILabels[i];
+    m_UIPanelInstanceCount = instances.size();
 
-        if (renderUILabel.label != label) {
-            continue;
-        }
+    for (RenderUILabel &renderUILabel : m_UILabels) {
+        renderUILabel.isVisible = renderUILabel.label->GetVisible();
+        renderUILabel.firstInstance = instances.size();
 
-        found = true;
+        glm::vec2 positionOffset = renderUILabel.label->GetPosition() * 2.0f;
+        float depth = renderUILabel.label->GetDepth();
 
-        m_UILabels.erase(m_UILabels.begin() + i);
+        for (const GlyphInstance &glyphInstance : renderUILabel.glyphInstances)
+            instances.push_back({glyphInstance.Rect + glm::vec4(positionOffset, 0.0f, 0.0f), glyphInstance.UVRect, glm::vec4(1.0f), depth});
+    }
 
-        vkDeviceWaitIdle(m_EngineDevice);
+    // frames in flight keep drawing the old layout until they're done.
+    if (m_UIInstanceBuffer.buffer)
+        m_DeletionQueue->DestroyBuffer(m_UIInstanceBuffer.buffer, m_UIInstanceBuffer.memory);
 
-        for (auto shaderData : renderUILabel.textureShaderData) {
-            vkDestroyImageView(m_EngineDevice, shaderData.second.first, NULL);
-            vkDestroySampler(m_EngineDevice, shaderData.second.second, NULL);
-        }
+    m_UIInstanceBuffer = {};
 
-        renderUILabel.textureShaderData.clear();
+    if (!instances.empty()) {
+        VkDeviceSize instanceBufferSize = sizeof(UIInstance) * instances.size();
 
-        vkDestroyBuffer(m_EngineDevice, renderUILabel.uboBuffer.buffer, NULL);
-        vkFreeMemory(m_EngineDevice, renderUILabel.uboBuffer.memory, NULL);
+        AllocateBuffer(GetSharedContext(), instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_UIInstanceBuffer.buffer, m_UIInstanceBuffer.memory);
+        m_UIInstanceBuffer.mappedData = m_UIInstanceBuffer.memory.mappedData;
 
-        break;
+        SDL_memcpy(m_UIInstanceBuffer.mappedData, instances.data(), instanceBufferSize);
     }
 
-    return found;
+    m_UILayoutGeneration = UI::GenericElement::GetLayoutGeneration();
+    m_UILayoutDirty = false;
+
+    if (m_Settings.Verbose)
+        fmt::println("UI laid out again, {} panels and {} labels into {} instances.", m_UIPanels.size(), m_UILabels.size(), instances.size());
 }
 
 void Renderer::RegisterUpdateFunction(const std::function<void()> &func) {
     m_UpdateFunctions.push_back(func);
 }
 
+void Renderer::RegisterFrameReadbackListener(const std::function<void(Uint64, const Uint8 *, Uint32, Uint32)> &func) {
+    m_FrameReadbackListeners.push_back(func);
+}
+
 void Renderer::RegisterFixedUpdateFunction(const std::function<void(std::array<bool, 322>)> &func) {
     m_FixedUpdateFunctions.push_back(func);
 }
@@ -923,123 +1393,173 @@ void Renderer::RegisterSDLEventListener(const std::function<void(SDL_Event *)> &
     m_SDLEventListeners[types].push_back(func);
 }
 
-Glyph Renderer::GenerateGlyph(EngineSharedContext &sharedContext, FT_Face ftFace, char c, float &x, float &y, float depth) {
-    Glyph glyph{};
-    
-    glyph.character = c;
+void Renderer::PrepareGlyphs(FontHandle font, const std::string &text) {
+    /* A glyph that isn't in the cache yet, pixels is the coverage until it gets turned into a distance field. */
+    struct PendingGlyph {
+        Uint64 key;
+        char character;
+
+        GlyphMetrics metrics;
+
+        std::vector<Uint8> pixels;
+        Uint32 width;
+        Uint32 height;
+    };
+
+    Uint32 fontFaceID = m_FontManager->GetFaceID(font);
+    Uint32 glyphSize = GetGlyphSize(font);
 
-    glyph.fontIdentifier = fmt::format("{} {} {}", ftFace->family_name, ftFace->style_name, ftFace->height);
+    std::vector<PendingGlyph> pendingGlyphs;
 
-    if (FT_Load_Char(ftFace, c, FT_LOAD_RENDER)) {
-        throw std::runtime_error(fmt::format("Failed to load the glyph for '{}' with FreeType", c));
+    for (char c : text) {
+        if (c == '\n')
+            continue;
+
+        Uint64 glyphKey = GetGlyphKey(fontFaceID, glyphSize, static_cast<Uint8>(c));
+
+        if (m_GlyphCache.find(glyphKey) != m_GlyphCache.end())
+            continue;
+
+        if (std::any_of(pendingGlyphs.begin(), pendingGlyphs.end(), [glyphKey](const PendingGlyph &pendingGlyph) { return pendingGlyph.key == glyphKey; }))
+            continue;
+
+        pendingGlyphs.push_back({glyphKey, c, {}, {}, 0, 0});
     }
 
-    if (c == ' ') {
-        x += ftFace->glyph->advance.x >> 6;
+    if (pendingGlyphs.empty())
+        return;
+
+    FT_Face ftFace = m_FontManager->GetFace(font);
 
-        return glyph;
+    // distance fields are generated from a bigger rasterization, everything gets scaled back down to SDF_GLYPH_SIZE.
+    float rasterScale = 1.0f;
+    if (m_Settings.SDFText) {
+        FT_Set_Pixel_Sizes(ftFace, 0, SDF_GLYPH_SIZE * SDF_OVERSAMPLE);
+
+        rasterScale = 1.0f / SDF_OVERSAMPLE;
     }
 
-    if (c == '\n') {
-        x = 0;
-        y += PIXEL_HEIGHT;
+    // FreeType faces can't be used from more than one thread, so this part stays here.
+    for (PendingGlyph &pendingGlyph : pendingGlyphs) {
+        if (FT_Load_Char(ftFace, pendingGlyph.character, FT_LOAD_RENDER)) {
+            FT_Set_Pixel_Sizes(ftFace, 0, m_FontManager->GetPixelSize(font));
 
-        return glyph;
+            throw std::runtime_error(fmt::format("Failed to load the glyph for '{}' with FreeType", pendingGlyph.character));
+        }
+
+        FT_GlyphSlot ftGlyph = ftFace->glyph;
+
+        // The bitshift by 6 is required because Advance is 1/64th of a pixel.
+        pendingGlyph.metrics.advance = (ftGlyph->advance.x >> 6) * rasterScale;
+        pendingGlyph.metrics.bearingX = ftGlyph->bitmap_left * rasterScale;
+        pendingGlyph.metrics.bearingY = ftGlyph->bitmap_top * rasterScale;
+        pendingGlyph.metrics.width = ftGlyph->bitmap.width * rasterScale;
+        pendingGlyph.metrics.height = ftGlyph->bitmap.rows * rasterScale;
+
+        // spaces and anything else without a bitmap only move the pen.
+        if (pendingGlyph.character == ' ' || ftGlyph->bitmap.width == 0 || ftGlyph->bitmap.rows == 0)
+            continue;
+
+        pendingGlyph.width = ftGlyph->bitmap.width;
+        pendingGlyph.height = ftGlyph->bitmap.rows;
+
+        // the glyph slot gets overwritten by the next FT_Load_Char, keep a tightly packed copy.
+        pendingGlyph.pixels.resize(pendingGlyph.width * pendingGlyph.height);
+
+        for (Uint32 row = 0; row < pendingGlyph.height; row++) {
+            const Uint8 *source = ftGlyph->bitmap.buffer + (ftGlyph->bitmap.pitch >= 0 ? row * ftGlyph->bitmap.pitch : (pendingGlyph.height - 1 - row) * -ftGlyph->bitmap.pitch);
+
+            SDL_memcpy(pendingGlyph.pixels.data() + row * pendingGlyph.width, source, pendingGlyph.width);
+        }
     }
 
-    for (Glyph &cachedGlyph : m_GlyphCache) {
-        if (glyph.character == cachedGlyph.character && 
-            glyph.fontIdentifier == cachedGlyph.fontIdentifier) {
-                fmt::println("Found an identical glyph in the Glyph Cache!");
-                fmt::println("({} from {})", glyph.character, glyph.fontIdentifier);
+    if (m_Settings.SDFText) {
+        FT_Set_Pixel_Sizes(ftFace, 0, m_FontManager->GetPixelSize(font));
 
-                glyph = cachedGlyph;
+        m_RecordingThreadPool->Dispatch(pendingGlyphs.size(), [&](Uint32 threadIndex, Uint32 glyphIndex) {
+            PendingGlyph &pendingGlyph = pendingGlyphs[glyphIndex];
 
-                float xpos = (x + ftFace->glyph->bitmap_left)/static_cast<float>(m_Settings.DisplayWidth);
-                float ypos = (y - ftFace->glyph->bitmap_top)/static_cast<float>(m_Settings.DisplayHeight);
+            if (pendingGlyph.pixels.empty())
+                return;
 
-                float w = (ftFace->glyph->bitmap.width)/static_cast<float>(m_Settings.DisplayWidth);
-                float h = (ftFace->glyph->bitmap.rows)/static_cast<float>(m_Settings.DisplayHeight);
+            Uint32 fieldWidth, fieldHeight;
+            pendingGlyph.pixels = generateSignedDistanceField(pendingGlyph.pixels.data(), pendingGlyph.width, pendingGlyph.height, pendingGlyph.width, SDF_SPREAD, SDF_OVERSAMPLE, fieldWidth, fieldHeight);
 
-                xpos -= 1.0f;
-                ypos -= 1.0f - (PIXEL_HEIGHT_FLOAT / static_cast<float>(m_Settings.DisplayHeight));
+            pendingGlyph.width = fieldWidth;
+            pendingGlyph.height = fieldHeight;
 
-                glyph.offset.x = xpos;
-                glyph.offset.y = ypos;
+            // the field has a SDF_SPREAD border all around the glyph.
+            pendingGlyph.metrics.width = fieldWidth;
+            pendingGlyph.metrics.height = fieldHeight;
+            pendingGlyph.metrics.bearingX -= SDF_SPREAD;
+            pendingGlyph.metrics.bearingY += SDF_SPREAD;
+        });
+    }
 
-                x += ftFace->glyph->advance.x >> 6;
+    for (PendingGlyph &pendingGlyph : pendingGlyphs) {
+        if (!pendingGlyph.pixels.empty())
+            pendingGlyph.metrics.atlasRegion = m_GlyphAtlas->Add(pendingGlyph.width, pendingGlyph.height, pendingGlyph.pixels.data(), pendingGlyph.width);
 
-                glyph.scale.x = w;
-                glyph.scale.y = h;
+        m_GlyphCache.emplace(pendingGlyph.key, pendingGlyph.metrics);
+    }
 
-                AllocateBuffer(sharedContext, sizeof(glyph.glyphUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, glyph.glyphUBOBuffer.buffer, glyph.glyphUBOBuffer.memory);
-                vkMapMemory(m_EngineDevice, glyph.glyphUBOBuffer.memory, 0, sizeof(glyph.glyphUBO), 0, &(glyph.glyphUBOBuffer.mappedData));
+    if (m_Settings.Verbose)
+        fmt::println("Added {} glyph(s) at {}px to the glyph atlas{}", pendingGlyphs.size(), glyphSize, m_Settings.SDFText ? " as distance fields" : "");
+}
 
-                return glyph;
-            }
+Glyph Renderer::GenerateGlyph(FontHandle font, char c, float &x, float &y) {
+    Glyph glyph{};
+    
+    glyph.character = c;
+    glyph.fontFaceID = m_FontManager->GetFaceID(font);
+
+    if (c == '\n') {
+        x = 0;
+        y += PIXEL_HEIGHT;
+
+        return glyph;
     }
 
-    VkDeviceSize glyphBufferSize = static_cast<VkDeviceSize>(ftFace->glyph->bitmap.width * ftFace->glyph->bitmap.rows);
+    Uint32 glyphSize = GetGlyphSize(font);
+    Uint64 glyphKey = GetGlyphKey(glyph.fontFaceID, glyphSize, static_cast<Uint8>(c));
+
+    auto cachedGlyph = m_GlyphCache.find(glyphKey);
+
+    if (cachedGlyph == m_GlyphCache.end()) {
+        PrepareGlyphs(font, std::string(1, c));
 
-    TextureBufferAndMemory glyphBuffer{};
-    AllocateBuffer(sharedContext, glyphBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, glyphBuffer.bufferAndMemory.buffer, glyphBuffer.bufferAndMemory.memory);
-    glyphBuffer.width = ftFace->glyph->bitmap.width;
-    glyphBuffer.height = ftFace->glyph->bitmap.rows;
-    glyphBuffer.channels = 1;
+        cachedGlyph = m_GlyphCache.find(glyphKey);
+    }
 
-    vkMapMemory(m_EngineDevice, glyphBuffer.bufferAndMemory.memory, 0, glyphBufferSize, 0, &(glyphBuffer.bufferAndMemory.mappedData));
-    SDL_memcpy(glyphBuffer.bufferAndMemory.mappedData, ftFace->glyph->bitmap.buffer, glyphBufferSize);
+    const GlyphMetrics &metrics = cachedGlyph->second;
 
-    TextureImageAndMemory textureImageAndMemory = CreateImage(sharedContext, ftFace->glyph->bitmap.width, ftFace->glyph->bitmap.rows, VK_FORMAT_R8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // only distance fields ever get drawn at a size they weren't rasterized at.
+    float scale = m_FontManager->GetPixelSize(font) / static_cast<float>(glyphSize);
 
-    ChangeImageLayout(sharedContext, textureImageAndMemory.imageAndMemory.image, 
-                VK_FORMAT_R8_SRGB, 
-                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-            );
-    CopyBufferToImage(sharedContext, glyphBuffer, textureImageAndMemory.imageAndMemory.image);
-    ChangeImageLayout(sharedContext, textureImageAndMemory.imageAndMemory.image, 
-                VK_FORMAT_R8_SRGB, 
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-            );
+    if (!metrics.atlasRegion.has_value()) {
+        x += metrics.advance * scale;
 
-    vkDestroyBuffer(m_EngineDevice, glyphBuffer.bufferAndMemory.buffer, NULL);
-    vkFreeMemory(m_EngineDevice, glyphBuffer.bufferAndMemory.memory, NULL);
+        return glyph;
+    }
 
-    float xpos = (x + ftFace->glyph->bitmap_left)/static_cast<float>(m_Settings.DisplayWidth);
-    float ypos = (y - ftFace->glyph->bitmap_top)/static_cast<float>(m_Settings.DisplayHeight);
+    float xpos = (x + metrics.bearingX * scale)/static_cast<float>(m_Settings.DisplayWidth);
+    float ypos = (y - metrics.bearingY * scale)/static_cast<float>(m_Settings.DisplayHeight);
 
-    float w = (ftFace->glyph->bitmap.width)/static_cast<float>(m_Settings.DisplayWidth);
-    float h = (ftFace->glyph->bitmap.rows)/static_cast<float>(m_Settings.DisplayHeight);
+    float w = (metrics.width * scale)/static_cast<float>(m_Settings.DisplayWidth);
+    float h = (metrics.height * scale)/static_cast<float>(m_Settings.DisplayHeight);
 
     xpos -= 1.0f;
     ypos -= 1.0f - (PIXEL_HEIGHT_FLOAT / static_cast<float>(m_Settings.DisplayHeight));
 
-    std::vector<SimpleVertex> simpleVerts = {
-                                                {glm::vec3(0.0f, 0.0f, depth), glm::vec2(0.0f, 0.0f)},
-                                                {glm::vec3(w, h, depth), glm::vec2(1.0f, 1.0f)},
-                                                {glm::vec3(0.0f, h, depth), glm::vec2(0.0f, 1.0f)},
-                                                {glm::vec3(0.0f, 0.0f, depth), glm::vec2(0.0f, 0.0f)},
-                                                {glm::vec3(w, 0.0f, depth), glm::vec2(1.0f, 0.0f)},
-                                                {glm::vec3(w, h, depth), glm::vec2(1.0f, 1.0f)}
-                                            };
-
-    BufferAndMemory bufferAndMemory = CreateSimpleVertexBuffer(sharedContext, simpleVerts, false);
-    
     glyph.offset.x = xpos;
     glyph.offset.y = ypos;
 
     glyph.scale.x = w;
     glyph.scale.y = h;
 
-    // The bitshift by 6 is required because Advance is 1/64th of a pixel.
-    x += ftFace->glyph->advance.x >> 6;
-
-    glyph.glyphBuffer = std::make_pair(textureImageAndMemory, bufferAndMemory);
+    x += metrics.advance * scale;
 
-    AllocateBuffer(sharedContext, sizeof(glyph.glyphUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, glyph.glyphUBOBuffer.buffer, glyph.glyphUBOBuffer.memory);
-    vkMapMemory(m_EngineDevice, glyph.glyphUBOBuffer.memory, 0, sizeof(glyph.glyphUBO), 0, &(glyph.glyphUBOBuffer.mappedData));
-
-    m_GlyphCache.push_back(glyph);
+    glyph.atlasRegion = metrics.atlasRegion;
 
     return glyph;
 }
@@ -1160,6 +1680,118 @@ void Renderer::InitFramebuffers(VkRenderPass renderPass, VkImageView depthImageV
         m_SwapchainFramebuffers[i] = CreateFramebuffer(renderPass, m_SwapchainImageViews[i], {m_Settings.DisplayWidth, m_Settings.DisplayHeight}, depthImageView);
 }
 
+void Renderer::InitHeadlessTargets() {
+    EngineSharedContext sharedContext = GetSharedContext();
+
+    m_SwapchainImageFormat = HEADLESS_IMAGE_FORMAT;
+    m_SwapchainExtent = {m_Settings.DisplayWidth, m_Settings.DisplayHeight};
+
+    // one per frame in flight, a frame can't be drawn into while the one before it is still being copied out.
+    m_SwapchainImagesCount = MAX_FRAMES_IN_FLIGHT;
+    m_SwapchainImages.resize(m_SwapchainImagesCount);
+    m_SwapchainImageViews.resize(m_SwapchainImagesCount);
+
+    VkDeviceSize readbackSize = static_cast<VkDeviceSize>(m_Settings.DisplayWidth) * m_Settings.DisplayHeight * 4;
+
+    for (Uint32 i = 0; i < m_SwapchainImagesCount; i++) {
+        TextureImageAndMemory image = CreateImage(sharedContext, m_Settings.DisplayWidth, m_Settings.DisplayHeight, m_SwapchainImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        m_AllocatedImages.push_back(image.imageAndMemory.image);
+        m_AllocatedMemory.push_back(image.imageAndMemory.memory);
+
+        m_SwapchainImages[i] = image.imageAndMemory.image;
+
+        // the destructor already destroys swapchain image views.
+        m_SwapchainImageViews[i] = CreateImageView(image, m_SwapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, false);
+
+        AllocateBuffer(sharedContext, readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_ReadbackBuffers[i].buffer, m_ReadbackBuffers[i].memory);
+
+        m_ReadbackBuffers[i].mappedData = m_ReadbackBuffers[i].memory.mappedData;
+    }
+
+    m_ReadbackFrameNumbers.fill(-1);
+
+    if (m_Settings.Verbose)
+        fmt::println("Rendering headless at {}x{}", m_Settings.DisplayWidth, m_Settings.DisplayHeight);
+}
+
+void Renderer::RecordReadback(VkCommandBuffer commandBuffer, Uint32 frameIndex) {
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = m_SwapchainImages[frameIndex];
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    // tightly packed, so the buffer can be written out as it is.
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {m_Settings.DisplayWidth, m_Settings.DisplayHeight, 1};
+
+    vkCmdCopyImageToBuffer(commandBuffer, m_SwapchainImages[frameIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_ReadbackBuffers[frameIndex].buffer, 1, &region);
+
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = m_ReadbackBuffers[frameIndex].buffer;
+    bufferBarrier.offset = 0;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
+void Renderer::ProcessReadback(Uint32 frameIndex) {
+    if (m_ReadbackFrameNumbers[frameIndex] < 0)
+        return;
+
+    Uint64 frameNumber = m_ReadbackFrameNumbers[frameIndex];
+    m_ReadbackFrameNumbers[frameIndex] = -1;
+
+    const Uint8 *pixels = static_cast<const Uint8 *>(m_ReadbackBuffers[frameIndex].mappedData);
+    Uint32 width = m_Settings.DisplayWidth;
+    Uint32 height = m_Settings.DisplayHeight;
+
+    for (auto &listener : m_FrameReadbackListeners)
+        listener(frameNumber, pixels, width, height);
+
+    if (m_Settings.CaptureDirectory.empty())
+        return;
+
+    std::string path;
+    bool isWritten;
+
+    if (m_Settings.CaptureFormat == "raw") {
+        path = fmt::format("{}/frame_{:06}_{}x{}.rgba", m_Settings.CaptureDirectory, frameNumber, width, height);
+        isWritten = writeRawImage(path, pixels, static_cast<size_t>(width) * height * 4);
+    } else {
+        path = fmt::format("{}/frame_{:06}.png", m_Settings.CaptureDirectory, frameNumber);
+        isWritten = writePNG(path, pixels, width, height);
+    }
+
+    if (!isWritten)
+        throw std::runtime_error(fmt::format(engineError::FRAME_CAPTURE_FAILURE, path));
+}
+
 VkImageView Renderer::CreateDepthImage(Uint32 width, Uint32 height) {
     EngineSharedContext sharedContext = GetSharedContext();
 
@@ -1189,18 +1821,21 @@ Uint32 Renderer::FindMemoryType(Uint32 typeFilter, VkMemoryPropertyFlags propert
 }
 
 void Renderer::InitInstance() {
-    Uint32 extensionCount;
-    // Ask SDL to return a pointer to a C-string array, extensionCount will be set to the length.
-    const char * const * instanceExtensions = SDL_Vulkan_GetInstanceExtensions(&extensionCount);
-
-    if (instanceExtensions == nullptr)
-        throw std::runtime_error(engineError::FAILED_VULKAN_EXTS);
-
     // Merge instanceExtensions and requiredInstanceExtensions.
     std::vector<const char *> extensions;
-    
-    for (size_t i = 0; i < extensionCount; i++)
-        extensions.push_back(instanceExtensions[i]);
+
+    // no surface, none of SDL's extensions are needed.
+    if (!m_Settings.Headless) {
+        Uint32 extensionCount;
+        // Ask SDL to return a pointer to a C-string array, extensionCount will be set to the length.
+        const char * const * instanceExtensions = SDL_Vulkan_GetInstanceExtensions(&extensionCount);
+
+        if (instanceExtensions == nullptr)
+            throw std::runtime_error(engineError::FAILED_VULKAN_EXTS);
+
+        for (size_t i = 0; i < extensionCount; i++)
+            extensions.push_back(instanceExtensions[i]);
+    }
 
     extensions.insert(extensions.end(), requiredInstanceExtensions.begin(), requiredInstanceExtensions.end());
 
@@ -1230,12 +1865,12 @@ void Renderer::InitInstance() {
         throw std::runtime_error(engineError::INSTANCE_CREATION_FAILURE);
 }
 
-/* Creates a Vulkan graphics pipeline, shaderName will be used as a part of the path.
+/* Creates a Vulkan graphics pipeline, vertexShaderName and fragmentShaderName will be used as a part of the path.
  * Sanitization is the job of the caller.
  */
-PipelineAndLayout Renderer::CreateGraphicsPipeline(const std::string &shaderName, VkRenderPass renderPass, Uint32 subpassIndex, VkFrontFace frontFace, VkViewport viewport, VkRect2D scissor, const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts, bool isSimple, bool enableDepth) {
-    auto vertShader = readFile("shaders/" + shaderName + ".vert.spv");
-    auto fragShader = readFile("shaders/" + shaderName + ".frag.spv");
+PipelineAndLayout Renderer::CreateGraphicsPipeline(const std::string &vertexShaderName, const std::string &fragmentShaderName, VkRenderPass renderPass, Uint32 subpassIndex, VkFrontFace frontFace, VkViewport viewport, VkRect2D scissor, const std::vector<VkDescriptorSetLayout> &descriptorSetLayouts, bool isSimple, bool enableDepth, bool isInstanced, const std::vector<VkPushConstantRange> &pushConstantRanges, bool isQuantized) {
+    auto vertShader = readFile("shaders/" + vertexShaderName + ".vert.spv");
+    auto fragShader = readFile("shaders/" + fragmentShaderName + ".frag.spv");
 
     VkShaderModule vertShaderModule = CreateShaderModule(m_EngineDevice, vertShader);
     VkShaderModule fragShaderModule = CreateShaderModule(m_EngineDevice, fragShader);
@@ -1254,14 +1889,27 @@ PipelineAndLayout Renderer::CreateGraphicsPipeline(const std::string &shaderName
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
 
+    // the one shader handles both vertex formats, the constant lets the driver drop the unused path.
+    VkBool32 quantizedConstant = isQuantized;
+    VkSpecializationMapEntry quantizedEntry{0, 0, sizeof(VkBool32)};
+
+    VkSpecializationInfo vertSpecializationInfo{};
+    vertSpecializationInfo.mapEntryCount = 1;
+    vertSpecializationInfo.pMapEntries = &quantizedEntry;
+    vertSpecializationInfo.dataSize = sizeof(quantizedConstant);
+    vertSpecializationInfo.pData = &quantizedConstant;
+
+    if (isQuantized)
+        vertShaderStageInfo.pSpecializationInfo = &vertSpecializationInfo;
+
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantRanges.size(); // Optional
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data(); // Optional
 
     if (vkCreatePipelineLayout(m_EngineDevice, &pipelineLayoutInfo, nullptr, &pipelineAndLayout.layout) != VK_SUCCESS)
         throw std::runtime_error(engineError::PIPELINE_LAYOUT_CREATION_FAILURE);
@@ -1278,24 +1926,39 @@ PipelineAndLayout Renderer::CreateGraphicsPipeline(const std::string &shaderName
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
 
-
-    auto bindingDescriptionSimple = getSimpleVertexBindingDescription();
-    auto attributeDescriptionsSimple = getSimpleVertexAttributeDescriptions();
-    auto bindingDescription = getVertexBindingDescription();
-    auto attributeDescriptions = getVertexAttributeDescriptions();
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 
     if (isSimple) {
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescriptionSimple;
-        vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptionsSimple.size();
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptionsSimple.data();
+        auto attributeDescriptionsSimple = getSimpleVertexAttributeDescriptions();
+
+        bindingDescriptions.push_back(getSimpleVertexBindingDescription());
+        attributeDescriptions.insert(attributeDescriptions.end(), attributeDescriptionsSimple.begin(), attributeDescriptionsSimple.end());
+    } else if (isQuantized) {
+        auto vertexAttributeDescriptionsQuantized = getQuantizedVertexAttributeDescriptions();
+
+        bindingDescriptions.push_back(getQuantizedVertexBindingDescription());
+        attributeDescriptions.insert(attributeDescriptions.end(), vertexAttributeDescriptionsQuantized.begin(), vertexAttributeDescriptionsQuantized.end());
     } else {
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-        vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+        auto vertexAttributeDescriptions = getVertexAttributeDescriptions();
+
+        bindingDescriptions.push_back(getVertexBindingDescription());
+        attributeDescriptions.insert(attributeDescriptions.end(), vertexAttributeDescriptions.begin(), vertexAttributeDescriptions.end());
+    }
+
+    if (isInstanced) {
+        auto instanceAttributeDescriptions = getInstanceAttributeDescriptions();
+
+        bindingDescriptions.push_back(getInstanceBindingDescription());
+        attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
     }
 
+    vertexInputInfo.vertexBindingDescriptionCount = bindingDescriptions.size();
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -1382,13 +2045,18 @@ PipelineAndLayout Renderer::CreateGraphicsPipeline(const std::string &shaderName
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
 
-    if (vkCreateGraphicsPipelines(m_EngineDevice, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipelineAndLayout.pipeline) != VK_SUCCESS) {
+    std::chrono::high_resolution_clock::time_point beforePipelineTime = std::chrono::high_resolution_clock::now();
+
+    if (vkCreateGraphicsPipelines(m_EngineDevice, m_PipelineCache, 1, &pipelineInfo, NULL, &pipelineAndLayout.pipeline) != VK_SUCCESS) {
         vkDestroyShaderModule(m_EngineDevice, vertShaderModule, NULL);
         vkDestroyShaderModule(m_EngineDevice, fragShaderModule, NULL);
 
         throw std::runtime_error(engineError::PIPELINE_CREATION_FAILURE);
     }
 
+    if (m_Settings.Verbose)
+        fmt::println("Created the {} pipeline in {:.3f}ms", fragmentShaderName, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - beforePipelineTime).count());
+
     vkDestroyShaderModule(m_EngineDevice, vertShaderModule, NULL);
     vkDestroyShaderModule(m_EngineDevice, fragShaderModule, NULL);
 
@@ -1397,6 +2065,103 @@ PipelineAndLayout Renderer::CreateGraphicsPipeline(const std::string &shaderName
     return pipelineAndLayout;
 }
 
+static bool isPipelineCacheHeaderValid(const PipelineCacheHeader &header, const VkPhysicalDeviceProperties &properties, size_t fileSize) {
+    return header.magic == PIPELINE_CACHE_MAGIC &&
+           header.version == PIPELINE_CACHE_VERSION &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           header.driverVersion == properties.driverVersion &&
+           std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+           header.dataSize == fileSize - sizeof(PipelineCacheHeader);
+}
+
+void Renderer::LoadPipelineCache() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_EnginePhysicalDevice, &properties);
+
+    std::vector<char> cacheData;
+
+    std::ifstream file(m_Settings.PipelineCachePath, std::ios::ate | std::ios::binary);
+
+    if (file.is_open()) {
+        size_t fileSize = file.tellg();
+        PipelineCacheHeader header{};
+
+        file.seekg(0);
+
+        // a new driver (or a different GPU) can't use the old data, it's either ignored or it crashes the driver, so we check ourselves.
+        if (fileSize >= sizeof(header) && file.read(reinterpret_cast<char *>(&header), sizeof(header)) && isPipelineCacheHeaderValid(header, properties, fileSize)) {
+            cacheData.resize(header.dataSize);
+
+            if (!file.read(cacheData.data(), cacheData.size()) || fnv1a64::hash(cacheData.data(), cacheData.size()) != header.dataHash)
+                cacheData.clear();
+        }
+
+        if (m_Settings.Verbose) {
+            if (cacheData.empty())
+                fmt::println("Pipeline cache {} is stale or corrupted, rebuilding it.", m_Settings.PipelineCachePath);
+            else
+                fmt::println("Loaded {} bytes from pipeline cache {}", cacheData.size(), m_Settings.PipelineCachePath);
+        }
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.initialDataSize = cacheData.size();
+    pipelineCacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    if (vkCreatePipelineCache(m_EngineDevice, &pipelineCacheCreateInfo, NULL, &m_PipelineCache) != VK_SUCCESS)
+        throw std::runtime_error(engineError::PIPELINE_CACHE_CREATION_FAILURE);
+}
+
+void Renderer::SavePipelineCache() {
+    if (!m_PipelineCache)
+        return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_EnginePhysicalDevice, &properties);
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_EngineDevice, m_PipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+        return;
+
+    std::vector<char> cacheData(dataSize);
+    if (vkGetPipelineCacheData(m_EngineDevice, m_PipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+        return;
+
+    cacheData.resize(dataSize);
+
+    PipelineCacheHeader header{};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = cacheData.size();
+    header.dataHash = fnv1a64::hash(cacheData.data(), cacheData.size());
+
+    // write it somewhere else first, so a crash halfway through doesn't leave a broken cache behind.
+    std::string temporaryPath = m_Settings.PipelineCachePath + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open() || !file.write(reinterpret_cast<const char *>(&header), sizeof(header)) || !file.write(cacheData.data(), cacheData.size())) {
+            fmt::println("WARN: Failed to write the pipeline cache to {}!", temporaryPath);
+            return;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename(temporaryPath, m_Settings.PipelineCachePath, errorCode);
+
+    if (errorCode)
+        fmt::println("WARN: Failed to save the pipeline cache to {}! ({})", m_Settings.PipelineCachePath, errorCode.message());
+    else if (m_Settings.Verbose)
+        fmt::println("Saved {} bytes to pipeline cache {}", cacheData.size(), m_Settings.PipelineCachePath);
+}
+
 VkRenderPass Renderer::CreateRenderPass(VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp, size_t subpassCount, VkFormat imageFormat, VkImageLayout initialColorLayout, VkImageLayout finalColorLayout, bool shouldContainDepthImage) {
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = imageFormat;
@@ -1510,16 +2275,22 @@ bool Renderer::QuitEventCheck(SDL_Event &event) {
 }
 
 void Renderer::Init() {
-    int SDL_INIT_STATUS = SDL_Init(SDL_INIT_VIDEO);
+    // headless machines usually don't have a display to initialize, events are all we need from SDL then.
+    int SDL_INIT_STATUS = SDL_Init(m_Settings.Headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO);
     if (!SDL_INIT_STATUS)
         throw std::runtime_error(fmt::format(engineError::FAILED_SDL_INIT, SDL_INIT_STATUS));
 
-    m_EngineWindow = SDL_CreateWindow("Test!", m_Settings.DisplayWidth, m_Settings.DisplayHeight, SDL_WINDOW_VULKAN | (m_Settings.Fullscreen & SDL_WINDOW_FULLSCREEN));
+    if (!m_Settings.Headless) {
+        m_EngineWindow = SDL_CreateWindow("Test!", m_Settings.DisplayWidth, m_Settings.DisplayHeight, SDL_WINDOW_VULKAN | (m_Settings.Fullscreen & SDL_WINDOW_FULLSCREEN));
 
-    if (!m_EngineWindow)
-        throw std::runtime_error(fmt::format(engineError::FAILED_WINDOW_INIT, SDL_GetError()));
+        if (!m_EngineWindow)
+            throw std::runtime_error(fmt::format(engineError::FAILED_WINDOW_INIT, SDL_GetError()));
+    }
 
-    if (m_Settings.Fullscreen && m_Settings.IgnoreRenderResolution) {
+    if (m_Settings.Headless && m_Settings.IgnoreRenderResolution) {
+        m_Settings.RenderWidth = m_Settings.DisplayWidth;
+        m_Settings.RenderHeight = m_Settings.DisplayHeight;
+    } else if (m_Settings.Fullscreen && m_Settings.IgnoreRenderResolution) {
         SDL_DisplayMode DM = *SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(m_EngineWindow));
         m_Settings.DisplayWidth = DM.w;
         m_Settings.DisplayHeight = DM.h;
@@ -1533,10 +2304,18 @@ void Renderer::Init() {
 
     SDL_SetHint(SDL_HINT_MOUSE_RELATIVE_MODE_CENTER, "1");
 
-    // lets prepare
-    if (!SDL_Vulkan_LoadLibrary(NULL))
+    // lets prepare, headless goes straight through the Vulkan loader we link against.
+    if (!m_Settings.Headless && !SDL_Vulkan_LoadLibrary(NULL))
         throw std::runtime_error(engineError::FAILED_VULKAN_LOAD);
 
+    if (m_Settings.Headless && !m_Settings.CaptureDirectory.empty()) {
+        std::error_code errorCode;
+        std::filesystem::create_directories(m_Settings.CaptureDirectory, errorCode);
+
+        if (errorCode)
+            throw std::runtime_error(fmt::format(engineError::CAPTURE_DIRECTORY_CREATION_FAILURE, m_Settings.CaptureDirectory, errorCode.message()));
+    }
+
     // will throw an exception and everything for us
     InitInstance();
 
@@ -1546,16 +2325,21 @@ void Renderer::Init() {
     if (physicalDeviceCount == 0)
         throw std::runtime_error(engineError::NO_VULKAN_DEVICES);
     
-    if (!SDL_Vulkan_CreateSurface(m_EngineWindow, m_EngineVulkanInstance, NULL, &m_EngineSurface))
+    if (!m_Settings.Headless && !SDL_Vulkan_CreateSurface(m_EngineWindow, m_EngineVulkanInstance, NULL, &m_EngineSurface))
         throw std::runtime_error(fmt::format(engineError::SURFACE_CREATION_FAILURE, SDL_GetError()));
 
+    std::vector<const char *> deviceExtensions = requiredDeviceExtensions;
+
+    if (!m_Settings.Headless)
+        deviceExtensions.insert(deviceExtensions.end(), presentationDeviceExtensions.begin(), presentationDeviceExtensions.end());
+
     // now we can get a list of physical devices
     std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
     vkEnumeratePhysicalDevices(m_EngineVulkanInstance, &physicalDeviceCount, physicalDevices.data());
 
     // find first capable card, capable cards are cards that have all of the required Device Extensions.
     for (size_t i = 0; i < physicalDevices.size(); i++) {
-        if (checkDeviceExtensionSupport(physicalDevices[i])) {
+        if (checkDeviceExtensionSupport(physicalDevices[i], deviceExtensions)) {
             VkPhysicalDeviceFeatures deviceFeatures;
             vkGetPhysicalDeviceFeatures(physicalDevices[i], &deviceFeatures);
 
@@ -1564,9 +2348,11 @@ void Renderer::Init() {
                 continue;
 
             // can it work with swapchains? 90% likely, but we still have to check.
-            SwapChainSupportDetails swapChainDetails = QuerySwapChainSupport(physicalDevices[i], m_EngineSurface);
-            if (swapChainDetails.formats.empty() || swapChainDetails.presentModes.empty())
-                continue;
+            if (!m_Settings.Headless) {
+                SwapChainSupportDetails swapChainDetails = QuerySwapChainSupport(physicalDevices[i], m_EngineSurface);
+                if (swapChainDetails.formats.empty() || swapChainDetails.presentModes.empty())
+                    continue;
+            }
 
             m_EnginePhysicalDevice = physicalDevices[i];
             break;
@@ -1593,57 +2379,217 @@ void Renderer::Init() {
     for (VkQueueFamilyProperties queueFamily : queueFamilies) {
         if (m_GraphicsQueueIndex == UINT32_MAX && queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
             m_GraphicsQueueIndex = i;
-        if (m_PresentQueueIndex == UINT32_MAX) {
+        if (m_PresentQueueIndex == UINT32_MAX && !m_Settings.Headless) {
             vkGetPhysicalDeviceSurfaceSupportKHR(m_EnginePhysicalDevice, i, m_EngineSurface, &support);
             if(support)
                 m_PresentQueueIndex = i;
         }
+        // a family that can only copy stuff is usually backed by the DMA engines, uploads there don't get in the way of rendering.
+        if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            m_TransferQueueIndex = i;
         ++i;
     }
 
-    // ask the device we want the graphics queue to be created.
+    if (m_TransferQueueIndex == UINT32_MAX)
+        m_TransferQueueIndex = m_GraphicsQueueIndex;
+
+    // nothing gets presented, it's only there so the queue setup below doesn't need to know.
+    if (m_Settings.Headless)
+        m_PresentQueueIndex = m_GraphicsQueueIndex;
+
+    // ask the device we want the graphics queue (and the present/transfer queues, if they're somewhere else) to be created.
     float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueInfo = {
-        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, // sType
-        nullptr,                                    // pNext
-        0,                                          // flags
-        m_GraphicsQueueIndex,                         // graphicsFamilyIndex
-        1,                                          // queueCount
-        &queuePriority,                             // pQueuePriorities
-    };
+    std::set<Uint32> uniqueQueueFamilies = {m_GraphicsQueueIndex, m_PresentQueueIndex, m_TransferQueueIndex};
+    std::vector<VkDeviceQueueCreateInfo> queueInfos;
+
+    for (Uint32 queueFamily : uniqueQueueFamilies) {
+        VkDeviceQueueCreateInfo queueInfo = {
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, // sType
+            nullptr,                                    // pNext
+            0,                                          // flags
+            queueFamily,                                // queueFamilyIndex
+            1,                                          // queueCount
+            &queuePriority,                             // pQueuePriorities
+        };
+
+        queueInfos.push_back(queueInfo);
+    }
     
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // for .dds textures, desktop GPUs pretty much all have it.
+    {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_EnginePhysicalDevice, &supportedFeatures);
+
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+        if (!supportedFeatures.textureCompressionBC && m_Settings.Verbose)
+            fmt::println("BC texture compression isn't supported by this device, .dds textures won't load");
+    }
+
+    // statistics are taken around whole render passes, the subpasses inside are secondary buffers, so they have to inherit the query.
+    bool pipelineStatistics = false;
+
+    if (m_Settings.ProfileGPU && m_Settings.PipelineStatistics) {
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(m_EnginePhysicalDevice, &supportedFeatures);
+
+        pipelineStatistics = supportedFeatures.pipelineStatisticsQuery && supportedFeatures.inheritedQueries;
+
+        deviceFeatures.pipelineStatisticsQuery = pipelineStatistics;
+        deviceFeatures.inheritedQueries = pipelineStatistics;
+
+        if (!pipelineStatistics && m_Settings.Verbose)
+            fmt::println("Pipeline statistics aren't supported by this device, only timing the GPU");
+    }
+
+    // descriptor indexing is core in 1.2, the texture table needs a handful of its features.
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    if (m_Settings.BindlessTextures) {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(m_EnginePhysicalDevice, &properties);
+
+        VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+        supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+        VkPhysicalDeviceFeatures2 supportedFeatures2{};
+        supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures2.pNext = &supportedVulkan12Features;
+
+        if (properties.apiVersion >= VK_API_VERSION_1_2)
+            vkGetPhysicalDeviceFeatures2(m_EnginePhysicalDevice, &supportedFeatures2);
+
+        m_Settings.BindlessTextures = supportedVulkan12Features.runtimeDescriptorArray &&
+                                      supportedVulkan12Features.descriptorBindingPartiallyBound &&
+                                      supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+                                      supportedVulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+                                      supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+
+        vulkan12Features.runtimeDescriptorArray = m_Settings.BindlessTextures;
+        vulkan12Features.descriptorBindingPartiallyBound = m_Settings.BindlessTextures;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = m_Settings.BindlessTextures;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = m_Settings.BindlessTextures;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = m_Settings.BindlessTextures;
+
+        if (!m_Settings.BindlessTextures && m_Settings.Verbose)
+            fmt::println("Descriptor indexing isn't supported by this device, binding textures per draw");
+    }
+
     //const char* deviceExtensionNames[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
     VkDeviceCreateInfo deviceCreateInfo = {
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,   // sType
-        nullptr,                                // pNext
+        m_Settings.BindlessTextures ? &vulkan12Features : nullptr, // pNext
         0,                                      // flags
-        1,                       // queueCreateInfoCount
-        &queueInfo,                 // pQueueCreateInfos
+        (Uint32)queueInfos.size(),  // queueCreateInfoCount
+        queueInfos.data(),          // pQueueCreateInfos
         0,                          // enabledLayerCount
         nullptr,                  // ppEnabledLayerNames
-        (Uint32)requiredDeviceExtensions.size(),         // enabledExtensionCount
-        requiredDeviceExtensions.data(),           // ppEnabledExtensionNames
+        (Uint32)deviceExtensions.size(),         // enabledExtensionCount
+        deviceExtensions.data(),           // ppEnabledExtensionNames
         &deviceFeatures,             // pEnabledFeatures
     };
 
     if (vkCreateDevice(m_EnginePhysicalDevice, &deviceCreateInfo, nullptr, &m_EngineDevice) != VK_SUCCESS)
         throw std::runtime_error(engineError::CANT_CREATE_DEVICE);
 
+    m_Allocator = std::make_unique<MemoryAllocator>(m_EngineDevice, m_EnginePhysicalDevice);
+
     vkCmdPushDescriptorSet = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(vkGetDeviceProcAddr(m_EngineDevice, "vkCmdPushDescriptorSetKHR"));
 
     vkGetDeviceQueue(m_EngineDevice, m_GraphicsQueueIndex, 0, &m_GraphicsQueue);
     vkGetDeviceQueue(m_EngineDevice, m_PresentQueueIndex,  0, &m_PresentQueue );
+    vkGetDeviceQueue(m_EngineDevice, m_TransferQueueIndex, 0, &m_TransferQueue);
+
+    m_UploadBatcher = std::make_unique<UploadBatcher>(m_EngineDevice, m_Allocator.get(), m_GraphicsQueueIndex, m_GraphicsQueue, m_TransferQueueIndex, m_TransferQueue);
+    m_DeletionQueue = std::make_unique<DeletionQueue>(m_EngineDevice, m_Allocator.get(), m_UploadBatcher.get(), MAX_FRAMES_IN_FLIGHT);
+    // distances have to be sampled as they are, coverage bitmaps were always sampled as sRGB.
+    m_GlyphAtlas = std::make_unique<GlyphAtlas>(m_EngineDevice, m_Allocator.get(), m_UploadBatcher.get(), m_DeletionQueue.get(), m_Settings.SDFText ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8_SRGB);
+    m_FontManager = std::make_unique<FontManager>();
+
+    if (m_Settings.BindlessTextures) {
+        VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+        vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &vulkan12Properties;
+
+        vkGetPhysicalDeviceProperties2(m_EnginePhysicalDevice, &properties2);
+
+        Uint32 capacity = std::min({static_cast<Uint32>(TEXTURE_TABLE_SIZE), vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers, vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages, vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages});
+
+        m_TextureTable = std::make_unique<TextureTable>(m_EngineDevice, capacity, MAX_FRAMES_IN_FLIGHT);
+
+        if (m_Settings.Verbose)
+            fmt::println("Bindless textures on, room for {} textures", capacity);
+    }
+
+    {
+        EngineSharedContext sharedContext = GetSharedContext();
+
+        std::vector<SimpleVertex> glyphQuadVerts = {
+                                                    {glm::vec3(0.0f, 0.0f, 0.0f), glm::vec2(0.0f, 0.0f)},
+                                                    {glm::vec3(1.0f, 1.0f, 0.0f), glm::vec2(1.0f, 1.0f)},
+                                                    {glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.0f, 1.0f)},
+                                                    {glm::vec3(0.0f, 0.0f, 0.0f), glm::vec2(0.0f, 0.0f)},
+                                                    {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(1.0f, 0.0f)},
+                                                    {glm::vec3(1.0f, 1.0f, 0.0f), glm::vec2(1.0f, 1.0f)}
+                                                   };
+
+        m_GlyphQuadBuffer = CreateSimpleVertexBuffer(sharedContext, glyphQuadVerts);
+    }
+
+    if (m_Settings.Verbose)
+        fmt::println("Uploading through queue family {} (graphics queue family is {})", m_TransferQueueIndex, m_GraphicsQueueIndex);
+
+    Uint32 recordingThreadCount = m_Settings.RecordingThreads;
+    if (recordingThreadCount == 0)
+        recordingThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
 
-    InitSwapchain();
+    m_RecordingThreadPool = std::make_unique<ThreadPool>(recordingThreadCount);
+    m_SecondaryCommandRecorder = std::make_unique<SecondaryCommandRecorder>(m_EngineDevice, m_GraphicsQueueIndex, recordingThreadCount, MAX_FRAMES_IN_FLIGHT);
+
+    if (m_Settings.Verbose)
+        fmt::println("Recording commands on {} threads", recordingThreadCount);
+
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(m_EnginePhysicalDevice, &properties);
+
+        Uint32 timestampValidBits = m_Settings.ProfileGPU ? queueFamilies[m_GraphicsQueueIndex].timestampValidBits : 0;
+
+        if (m_Settings.ProfileGPU && timestampValidBits == 0 && m_Settings.Verbose)
+            fmt::println("The graphics queue can't write timestamps, the GPU profiler is disabled");
+
+        m_GPUProfiler = std::make_unique<GPUProfiler>(m_EngineDevice, properties.limits.timestampPeriod, timestampValidBits, MAX_FRAMES_IN_FLIGHT, pipelineStatistics);
+        m_SecondaryCommandRecorder->SetInheritedPipelineStatistics(m_GPUProfiler->GetStatisticFlags());
+
+        m_ProfilerScopes.frame = m_GPUProfiler->GetScope("Frame");
+        m_ProfilerScopes.mainPass = m_GPUProfiler->GetScope("Main pass");
+        m_ProfilerScopes.lighting = m_GPUProfiler->GetScope("  Lighting");
+        m_ProfilerScopes.waypoints = m_GPUProfiler->GetScope("  Waypoints");
+        m_ProfilerScopes.arrows = m_GPUProfiler->GetScope("  Arrows");
+        m_ProfilerScopes.rescalePass = m_GPUProfiler->GetScope("Rescale pass");
+        m_ProfilerScopes.rescale = m_GPUProfiler->GetScope("  Rescale");
+        m_ProfilerScopes.uiPanels = m_GPUProfiler->GetScope("  UI panels");
+        m_ProfilerScopes.uiLabels = m_GPUProfiler->GetScope("  UI labels");
+    }
+
+    if (m_Settings.Headless)
+        InitHeadlessTargets();
+    else
+        InitSwapchain();
 
     m_RenderImageFormat = getBestFormatFromChannels(4);
 
     m_MainRenderPass = CreateRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, 3, m_RenderImageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    m_RescaleRenderPass = CreateRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, 3, m_SwapchainImageFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // headless frames stay attachments, RecordReadback moves them over to the copy itself.
+    m_RescaleRenderPass = CreateRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE, 3, m_SwapchainImageFormat, VK_IMAGE_LAYOUT_UNDEFINED, m_Settings.Headless ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
     VkImageView depthImageView = CreateDepthImage(m_Settings.RenderWidth, m_Settings.RenderHeight);
     VkImageView rescaleDepthImageView = CreateDepthImage(m_Settings.DisplayWidth, m_Settings.DisplayHeight);
@@ -1741,13 +2687,7 @@ void Renderer::Init() {
             throw std::runtime_error(engineError::DESCRIPTOR_SET_LAYOUT_CREATION_FAILURE);
     }
     {
-        VkDescriptorSetLayoutBinding arrowInfoDescriptorSetLayoutBinding{};
-        arrowInfoDescriptorSetLayoutBinding.binding = 1;
-        arrowInfoDescriptorSetLayoutBinding.descriptorCount = 1;
-        arrowInfoDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        arrowInfoDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        arrowInfoDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
-
+        // the model matrix and color are push constants.
         VkDescriptorSetLayoutBinding uboDescriptorSetLayoutBinding{};
         uboDescriptorSetLayoutBinding.binding = 0;
         uboDescriptorSetLayoutBinding.descriptorCount = 1;
@@ -1755,7 +2695,7 @@ void Renderer::Init() {
         uboDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         uboDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboDescriptorSetLayoutBinding, arrowInfoDescriptorSetLayoutBinding};
+        std::array<VkDescriptorSetLayoutBinding, 1> bindings = {uboDescriptorSetLayoutBinding};
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
         descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1787,21 +2727,15 @@ void Renderer::Init() {
     }
 
     {
-        VkDescriptorSetLayoutBinding samplerDescriptorSetLayoutBinding{};
-        samplerDescriptorSetLayoutBinding.binding = 1;
-        samplerDescriptorSetLayoutBinding.descriptorCount = 1;
-        samplerDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        samplerDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        samplerDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding uboDescriptorSetLayoutBinding{};
-        uboDescriptorSetLayoutBinding.binding = 0;
-        uboDescriptorSetLayoutBinding.descriptorCount = 1;
-        uboDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        uboDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+        VkDescriptorSetLayoutBinding uiInstanceDescriptorSetLayoutBinding{};
+        uiInstanceDescriptorSetLayoutBinding.binding = 0;
+        uiInstanceDescriptorSetLayoutBinding.descriptorCount = 1;
+        uiInstanceDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        uiInstanceDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uiInstanceDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {samplerDescriptorSetLayoutBinding, uboDescriptorSetLayoutBinding};
+        // panels are flat colors, the instance is all they need.
+        std::array<VkDescriptorSetLayoutBinding, 1> bindings = {uiInstanceDescriptorSetLayoutBinding};
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
         descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1821,21 +2755,14 @@ void Renderer::Init() {
         samplerDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
         samplerDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
-        VkDescriptorSetLayoutBinding labelUBODescriptorSetLayoutBinding{};
-        labelUBODescriptorSetLayoutBinding.binding = 0;
-        labelUBODescriptorSetLayoutBinding.descriptorCount = 1;
-        labelUBODescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        labelUBODescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        labelUBODescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
-
-        VkDescriptorSetLayoutBinding glyphUBODescriptorSetLayoutBinding{};
-        glyphUBODescriptorSetLayoutBinding.binding = 2;
-        glyphUBODescriptorSetLayoutBinding.descriptorCount = 1;
-        glyphUBODescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        glyphUBODescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        glyphUBODescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+        VkDescriptorSetLayoutBinding uiInstanceDescriptorSetLayoutBinding{};
+        uiInstanceDescriptorSetLayoutBinding.binding = 0;
+        uiInstanceDescriptorSetLayoutBinding.descriptorCount = 1;
+        uiInstanceDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        uiInstanceDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uiInstanceDescriptorSetLayoutBinding.pImmutableSamplers = nullptr;
 
-        std::array<VkDescriptorSetLayoutBinding, 3> bindings = {labelUBODescriptorSetLayoutBinding, samplerDescriptorSetLayoutBinding, glyphUBODescriptorSetLayoutBinding};
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uiInstanceDescriptorSetLayoutBinding, samplerDescriptorSetLayoutBinding};
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
         descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1867,15 +2794,34 @@ void Renderer::Init() {
     m_DisplayViewport.minDepth = 0.0f;
     m_DisplayViewport.maxDepth = 1.0f;
 
-    m_DisplayScissor.offset = {0, 0};
-    m_DisplayScissor.extent = {m_Settings.DisplayWidth, m_Settings.DisplayHeight};
+    m_DisplayScissor.offset = {0, 0};
+    m_DisplayScissor.extent = {m_Settings.DisplayWidth, m_Settings.DisplayHeight};
+
+    LoadPipelineCache();
+
+    std::chrono::high_resolution_clock::time_point beforePipelinesTime = std::chrono::high_resolution_clock::now();
+
+    // the texture table is set 1, set 0 is still pushed.
+    // both pipelines get the quantization push constants, so their layouts stay compatible even though only one uses them.
+    std::vector<VkDescriptorSetLayout> lightingSetLayouts = {m_RenderDescriptorSetLayout};
+    std::vector<VkPushConstantRange> lightingPushConstantRanges = {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(QuantizationParameters)}};
+
+    if (m_TextureTable)
+        lightingSetLayouts.push_back(m_TextureTable->GetLayout());
+
+    // both use the same vertex shader, bindless only changes how the fragment shader finds its texture.
+    const char *lightingFragmentShaderName = m_TextureTable ? "lightingbindless" : "lighting";
+
+    m_MainGraphicsPipeline = CreateGraphicsPipeline("lighting", lightingFragmentShaderName, m_MainRenderPass, 0, VK_FRONT_FACE_COUNTER_CLOCKWISE, m_RenderViewport, m_RenderScissor, lightingSetLayouts, false, VK_TRUE, true, lightingPushConstantRanges);
+    m_QuantizedGraphicsPipeline = CreateGraphicsPipeline("lighting", lightingFragmentShaderName, m_MainRenderPass, 0, VK_FRONT_FACE_COUNTER_CLOCKWISE, m_RenderViewport, m_RenderScissor, lightingSetLayouts, false, VK_TRUE, true, lightingPushConstantRanges, true);
+    m_UIWaypointGraphicsPipeline = CreateGraphicsPipeline("uiwaypoint", "uiwaypoint", m_MainRenderPass, 1, VK_FRONT_FACE_CLOCKWISE, m_RenderViewport, m_RenderScissor, {m_UIWaypointDescriptorSetLayout}, true);
+    m_UIArrowsGraphicsPipeline = CreateGraphicsPipeline("uiarrows", "uiarrows", m_MainRenderPass, 2, VK_FRONT_FACE_CLOCKWISE, m_RenderViewport, m_RenderScissor, {m_UIArrowsDescriptorSetLayout}, false, VK_FALSE, false, {{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UIArrowsPushConstants)}});
+    m_RescaleGraphicsPipeline = CreateGraphicsPipeline("rescale", "rescale", m_RescaleRenderPass, 0, VK_FRONT_FACE_CLOCKWISE, m_DisplayViewport, m_DisplayScissor, {m_RescaleDescriptorSetLayout}, true);
+    m_UIPanelGraphicsPipeline = CreateGraphicsPipeline("uipanel", "uipanel", m_RescaleRenderPass, 1, VK_FRONT_FACE_CLOCKWISE, m_DisplayViewport, m_DisplayScissor, {m_UIPanelDescriptorSetLayout}, true);
+    m_UILabelGraphicsPipeline = CreateGraphicsPipeline("uilabel", m_Settings.SDFText ? "uilabelsdf" : "uilabel", m_RescaleRenderPass, 2, VK_FRONT_FACE_CLOCKWISE, m_DisplayViewport, m_DisplayScissor, {m_UILabelDescriptorSetLayout}, true);
 
-    m_MainGraphicsPipeline = CreateGraphicsPipeline("lighting", m_MainRenderPass, 0, VK_FRONT_FACE_COUNTER_CLOCKWISE, m_RenderViewport, m_RenderScissor, {m_RenderDescriptorSetLayout});
-    m_UIWaypointGraphicsPipeline = CreateGraphicsPipeline("uiwaypoint", m_MainRenderPass, 1, VK_FRONT_FACE_CLOCKWISE, m_RenderViewport, m_RenderScissor, {m_UIWaypointDescriptorSetLayout}, true);
-    m_UIArrowsGraphicsPipeline = CreateGraphicsPipeline("uiarrows", m_MainRenderPass, 2, VK_FRONT_FACE_CLOCKWISE, m_RenderViewport, m_RenderScissor, {m_UIArrowsDescriptorSetLayout}, false, VK_FALSE);
-    m_RescaleGraphicsPipeline = CreateGraphicsPipeline("rescale", m_RescaleRenderPass, 0, VK_FRONT_FACE_CLOCKWISE, m_DisplayViewport, m_DisplayScissor, {m_RescaleDescriptorSetLayout}, true);
-    m_UIPanelGraphicsPipeline = CreateGraphicsPipeline("uipanel", m_RescaleRenderPass, 1, VK_FRONT_FACE_CLOCKWISE, m_DisplayViewport, m_DisplayScissor, {m_UIPanelDescriptorSetLayout}, true);
-    m_UILabelGraphicsPipeline = CreateGraphicsPipeline("uilabel", m_RescaleRenderPass, 2, VK_FRONT_FACE_CLOCKWISE, m_DisplayViewport, m_DisplayScissor, {m_UILabelDescriptorSetLayout}, true);
+    if (m_Settings.Verbose)
+        fmt::println("Created {} graphics pipelines in {:.3f}ms", m_PipelineAndLayouts.size(), std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - beforePipelinesTime).count());
 
     /* RENDER DESCRIPTOR POOL INITIALIZATION */
     {
@@ -1969,6 +2915,12 @@ void Renderer::Init() {
                                                             {glm::vec3(1.0f, -1.0f, 0.0f), glm::vec2(1.0f, 0.0f)},
                                                             {glm::vec3(1.0f, 1.0f, 0.0f), glm::vec2(1.0f, 1.0f)}
                                                         });
+
+        for (BufferAndMemory &frameUBOBuffer : m_FrameUBOBuffers) {
+            AllocateBuffer(sharedContext, sizeof(FrameUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameUBOBuffer.buffer, frameUBOBuffer.memory);
+
+            frameUBOBuffer.mappedData = frameUBOBuffer.memory.mappedData;
+        }
     }
 
     // {
@@ -2052,6 +3004,10 @@ void Renderer::Start() {
 
         lastFrameTime = frameTime;
 
+        // captures have to come out the same on every run, no matter how long a frame really took.
+        if (m_Settings.Headless)
+            deltaTime = ENGINE_FIXED_UPDATE_DELTATIME;
+
         SDL_Event event;
 
         while (SDL_PollEvent(&event)) {
@@ -2084,6 +3040,9 @@ void Renderer::Start() {
             fmt::println("Time spent processing events: {:.5f}ms", (duration_cast<duration<double, std::milli>>(afterEventsTime - frameTime).count()));
 #endif
 
+        // time spent waiting on the GPU isn't CPU time, that's how GPU-bound frames can be told apart.
+        high_resolution_clock::time_point beforeWaitTime = high_resolution_clock::now();
+
         // we got (MAX_FRAMES_IN_FLIGHT) "slots" to use, we can write frames as long as the current frame slot we're using isn't occupied.
         VkResult waitForFencesResult = vkWaitForFences(m_EngineDevice, 1, &m_InFlightFences[currentFrameIndex], true, UINT64_MAX);
 
@@ -2091,34 +3050,61 @@ void Renderer::Start() {
             throw std::runtime_error(fmt::format(engineError::WAIT_FOR_FENCES_FAILED, string_VkResult(waitForFencesResult)));
         }
 
+        m_UploadBatcher->Collect();
+
+        // whatever this frame slot could've been drawing last time is free to go now.
+        m_DeletionQueue->BeginFrame(m_FrameNumber);
+
+        if (m_IsDefragmentPending && m_DeletionQueue->IsRetired(m_DefragmentFrameNumber)) {
+            m_IsDefragmentPending = false;
+
+            m_Allocator->Defragment();
+
+            if (m_Settings.Verbose)
+                m_Allocator->PrintStatistics();
+        }
+
+        if (m_TextureTable)
+            m_TextureTable->BeginFrame(m_FrameNumber);
+
+        // the copy of the frame that last used this slot is done now.
+        if (m_Settings.Headless)
+            ProcessReadback(currentFrameIndex);
+
 #ifdef LOG_FRAME
         afterFenceTime = high_resolution_clock::now();
 
         fmt::println("Time spent waiting for fences: {:.5f}ms", (duration_cast<duration<double, std::milli>>(afterFenceTime - afterEventsTime).count()));
 #endif
 
-        Uint32 imageIndex = 0;
-        VkResult acquireNextImageResult = vkAcquireNextImageKHR(m_EngineDevice, m_Swapchain, UINT64_MAX, m_ImageAvailableSemaphores[currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
+        // without a swapchain, every frame in flight has its own target.
+        Uint32 imageIndex = currentFrameIndex;
+
+        if (!m_Settings.Headless) {
+            VkResult acquireNextImageResult = vkAcquireNextImageKHR(m_EngineDevice, m_Swapchain, UINT64_MAX, m_ImageAvailableSemaphores[currentFrameIndex], VK_NULL_HANDLE, &imageIndex);
         
-        // the swapchain can become "out of date" if the user were to, say, resize the window.
-        // suboptimal means it is kind of out of date but not invalid, can still be used.
-        if (acquireNextImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
-            InitSwapchain();
+            // the swapchain can become "out of date" if the user were to, say, resize the window.
+            // suboptimal means it is kind of out of date but not invalid, can still be used.
+            if (acquireNextImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
+                InitSwapchain();
 
 
-            VkImageView rescaleDepthImageView = CreateDepthImage(m_Settings.DisplayWidth, m_Settings.DisplayHeight);
+                VkImageView rescaleDepthImageView = CreateDepthImage(m_Settings.DisplayWidth, m_Settings.DisplayHeight);
 
-            // VkImageView depthImageView = CreateDepthImage();
+                // VkImageView depthImageView = CreateDepthImage();
 
-            // TextureImageAndMemory renderImage = CreateImage(m_Settings.RenderWidth, m_Settings.RenderHeight, m_RenderImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            // VkImageView renderImageView = CreateImageView(renderImage, m_RenderImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+                // TextureImageAndMemory renderImage = CreateImage(m_Settings.RenderWidth, m_Settings.RenderHeight, m_RenderImageFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                // VkImageView renderImageView = CreateImageView(renderImage, m_RenderImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 
-            // m_RenderFramebuffer = CreateFramebuffer(m_MainRenderPass, renderImageView, {m_Settings.RenderWidth, m_Settings.RenderHeight}, depthImageView);
-            InitFramebuffers(m_RescaleRenderPass, rescaleDepthImageView);
+                // m_RenderFramebuffer = CreateFramebuffer(m_MainRenderPass, renderImageView, {m_Settings.RenderWidth, m_Settings.RenderHeight}, depthImageView);
+                InitFramebuffers(m_RescaleRenderPass, rescaleDepthImageView);
 
-            continue;
-        } else if (acquireNextImageResult != VK_SUCCESS)
-            throw std::runtime_error(engineError::CANT_ACQUIRE_NEXT_IMAGE);
+                continue;
+            } else if (acquireNextImageResult != VK_SUCCESS)
+                throw std::runtime_error(engineError::CANT_ACQUIRE_NEXT_IMAGE);
+        }
+
+        double waitMilliseconds = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - beforeWaitTime).count();
 
 #ifdef LOG_FRAME
         afterAcquireImageResultTime = high_resolution_clock::now();
@@ -2141,17 +3127,134 @@ void Renderer::Start() {
         for (auto &updateFunction : m_UpdateFunctions)
             updateFunction();
 
+        if (m_Settings.ProfilerOverlay && m_GPUProfiler->IsEnabled() && m_FrameNumber % PROFILER_OVERLAY_REFRESH_FRAMES == 0)
+            UpdateProfilerOverlay();
+
+        // glyphs added by anything above have to be on the GPU before the labels get recorded.
+        m_GlyphAtlas->Flush();
+
         #ifdef LOG_FRAME
             afterUpdateTime = high_resolution_clock::now();
 
             fmt::println("Time spent calling update functions: {:.5f}ms", (duration_cast<duration<double, std::milli>>(afterUpdateTime - afterAcquireImageResultTime).count()));
         #endif
 
+        glm::mat4 viewMatrix;
+        glm::mat4 projectionMatrix;
+
+        if (m_PrimaryCamera) {
+            viewMatrix = m_PrimaryCamera->GetViewMatrix();
+
+            if (m_PrimaryCamera->type == CAMERA_PERSPECTIVE) {
+                projectionMatrix = glm::perspective(glm::radians(m_PrimaryCamera->FOV), (float)m_Settings.RenderWidth / (float)m_Settings.RenderHeight, m_Settings.CameraNear, CAMERA_FAR);
+            } else {
+                projectionMatrix = glm::ortho(0.0f, m_PrimaryCamera->OrthographicWidth, 0.0f, m_PrimaryCamera->OrthographicWidth*m_PrimaryCamera->AspectRatio);
+            }
+
+            // the Y flip below only swaps the top and bottom planes, culling with either matrix is the same.
+            CullRenderModels(projectionMatrix * viewMatrix);
+
+            // invert Y axis, glm was meant for OpenGL which inverts the Y axis.
+            projectionMatrix[1][1] *= -1;
+
+            // the frame that last used this slot is done with it.
+            FrameUBO frameUBO{projectionMatrix * viewMatrix};
+
+            SDL_memcpy(m_FrameUBOBuffers[currentFrameIndex].mappedData, &frameUBO, sizeof(frameUBO));
+        }
+
+        #ifdef LOG_FRAME
+            fmt::println("Visible models: {}/{} (tree height {})", m_VisibleRenderModels.size(), m_RenderModels.size(), m_ModelTree.GetHeight());
+        #endif
+
+        if (m_PrimaryCamera) {
+            /* Group every model matrix by mesh, so every mesh gets drawn once with all of its instances. */
+            for (std::unique_ptr<RenderMesh> &renderMesh : m_RenderMeshes)
+                renderMesh->instanceCount = 0;
+
+            Uint32 totalInstanceCount = 0;
+
+            for (size_t i = 0; i < m_RenderModels.size(); i++) {
+                RenderModel &renderModel = m_RenderModels[i];
+
+                if (!m_RenderModelVisibility[i])
+                    continue;
+
+                // still uploading, it'll pop in once it's done.
+                if (!m_UploadBatcher->IsComplete(renderModel.mesh->uploadToken))
+                    continue;
+
+                renderModel.mesh->instanceCount++;
+                totalInstanceCount++;
+            }
+
+            ReserveInstanceBuffer(currentFrameIndex, totalInstanceCount);
+
+            Uint32 firstInstance = 0;
+
+            for (std::unique_ptr<RenderMesh> &renderMesh : m_RenderMeshes) {
+                renderMesh->firstInstance = firstInstance;
+                firstInstance += renderMesh->instanceCount;
+
+                // used as a cursor while filling the instance buffer, ends up where it started.
+                renderMesh->instanceCount = 0;
+                renderMesh->nearestDepth = CAMERA_FAR;
+            }
+
+            InstanceData *instances = static_cast<InstanceData *>(m_InstanceBuffers[currentFrameIndex].mappedData);
+
+            for (size_t i = 0; i < m_RenderModels.size(); i++) {
+                RenderModel &renderModel = m_RenderModels[i];
+                RenderMesh *renderMesh = renderModel.mesh;
+
+                if (!m_RenderModelVisibility[i] || !m_UploadBatcher->IsComplete(renderMesh->uploadToken))
+                    continue;
+
+                // CullRenderModels already fetched it this frame.
+                const glm::mat4 &modelMatrix = renderModel.modelMatrix;
+
+                InstanceData &instance = instances[renderMesh->firstInstance + renderMesh->instanceCount++];
+                instance.ModelMatrix = modelMatrix;
+                instance.TextureIndex = renderMesh->textureIndex;
+
+                // the camera looks down -Z in view space.
+                renderMesh->nearestDepth = std::min(renderMesh->nearestDepth, -(viewMatrix * modelMatrix[3]).z);
+            }
+
+            /* Sort by pipeline, texture, mesh and then front to back, so every state change we skip while recording actually gets skipped. */
+            m_MainDrawList.Clear();
+
+            for (size_t i = 0; i < m_RenderMeshes.size(); i++) {
+                RenderMesh *renderMesh = m_RenderMeshes[i].get();
+
+                if (renderMesh->instanceCount == 0)
+                    continue;
+
+                // bindless draws don't bind textures, so there's nothing to group them by.
+                Uint32 textureID = m_TextureTable ? 0 : DrawList::HandleID((Uint64)renderMesh->diffTextureImageView);
+
+                m_MainDrawList.Add(DrawList::MakeOpaqueKey(renderMesh->isQuantized ? 1 : 0, textureID, DrawList::HandleID((Uint64)renderMesh->vertexBuffer.buffer), renderMesh->nearestDepth / CAMERA_FAR), i);
+            }
+
+            m_MainDrawList.Sort();
+        } else {
+            m_MainDrawList.Clear();
+        }
+
+        /* Nothing in the UI changed, the instance buffer and the panel draw list from last time are still good. */
+        if (m_UILayoutDirty || m_UILayoutGeneration != UI::GenericElement::GetLayoutGeneration())
+            UpdateUILayout();
+
         // "ight im available, if i wasn't already"
         vkResetFences(m_EngineDevice, 1, &m_InFlightFences[currentFrameIndex]);
 
         vkResetCommandBuffer(m_CommandBuffers[currentFrameIndex], 0);
 
+        // the frame's fence was waited on, nothing's using its secondary buffers anymore.
+        m_SecondaryCommandRecorder->BeginFrame(currentFrameIndex);
+
+        m_CommandStateTracker.ResetStatistics();
+
         // begin recording my commands
         VkCommandBufferBeginInfo commandBufferBeginInfo{};
         commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -2160,6 +3263,11 @@ void Renderer::Start() {
         if (vkBeginCommandBuffer(m_CommandBuffers[currentFrameIndex], &commandBufferBeginInfo) != VK_SUCCESS)
             throw std::runtime_error(engineError::COMMAND_BUFFER_BEGIN_FAILURE);
 
+        // the frame's fence was waited on, so whatever it measured last time is ready.
+        m_GPUProfiler->BeginFrame(m_CommandBuffers[currentFrameIndex], currentFrameIndex);
+
+        m_GPUProfiler->WriteBeginTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.frame);
+
         {
             // begin a render pass, this could be for example HDR pass, SSAO pass, lighting pass.
             VkRenderPassBeginInfo renderPassBeginInfo{};
@@ -2176,56 +3284,56 @@ void Renderer::Start() {
             renderPassBeginInfo.clearValueCount = clearColors.size();
             renderPassBeginInfo.pClearValues = clearColors.data();
 
-            vkCmdBeginRenderPass(m_CommandBuffers[currentFrameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            m_GPUProfiler->WriteBeginTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.mainPass);
+            m_GPUProfiler->BeginStatistics(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.mainPass);
 
-            vkCmdBindPipeline(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainGraphicsPipeline.pipeline);
+            /* Every subpass of this render pass is recorded into secondary command buffers, in parallel. */
+            vkCmdBeginRenderPass(m_CommandBuffers[currentFrameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            vkCmdSetViewport(m_CommandBuffers[currentFrameIndex], 0, 1, &m_RenderViewport);
+            RecordSubpassInParallel(m_CommandBuffers[currentFrameIndex], m_MainRenderPass, 0, m_RenderFramebuffer, m_MainDrawList.Size(), m_ProfilerScopes.lighting, [&](VkCommandBuffer commandBuffer, CommandStateTracker &stateTracker, size_t first, size_t last) {
+                stateTracker.BindPipeline(m_MainGraphicsPipeline.pipeline);
 
-            vkCmdSetScissor(m_CommandBuffers[currentFrameIndex], 0, 1, &m_RenderScissor);
+                vkCmdSetViewport(commandBuffer, 0, 1, &m_RenderViewport);
 
-            glm::mat4 viewMatrix;
-            glm::mat4 projectionMatrix;
+                vkCmdSetScissor(commandBuffer, 0, 1, &m_RenderScissor);
 
-            if (m_PrimaryCamera) {
-                viewMatrix = m_PrimaryCamera->GetViewMatrix();
+                stateTracker.BindVertexBuffer(1, m_InstanceBuffers[currentFrameIndex].buffer);
 
-                if (m_PrimaryCamera->type == CAMERA_PERSPECTIVE) {
-                    projectionMatrix = glm::perspective(glm::radians(m_PrimaryCamera->FOV), (float)m_Settings.RenderWidth / (float)m_Settings.RenderHeight, m_Settings.CameraNear, CAMERA_FAR);
-                } else {
-                    projectionMatrix = glm::ortho(0.0f, m_PrimaryCamera->OrthographicWidth, 0.0f, m_PrimaryCamera->OrthographicWidth*m_PrimaryCamera->AspectRatio);
+                // every texture is in there, bound once and indexed by the instances.
+                if (m_TextureTable) {
+                    VkDescriptorSet textureTableDescriptorSet = m_TextureTable->GetDescriptorSet();
+
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainGraphicsPipeline.layout, 1, 1, &textureTableDescriptorSet, 0, nullptr);
                 }
 
-                // invert Y axis, glm was meant for OpenGL which inverts the Y axis.
-                projectionMatrix[1][1] *= -1;
+                // the camera is the same for every mesh, model matrices come from the instance buffer.
+                VkDescriptorBufferInfo bufferInfo{};
+                bufferInfo.buffer = m_FrameUBOBuffers[currentFrameIndex].buffer;
+                bufferInfo.offset = 0;
+                bufferInfo.range = sizeof(FrameUBO);
 
-                for (RenderModel &renderModel : m_RenderModels) {
-                    renderModel.matricesUBO.modelMatrix = renderModel.model->GetModelMatrix();
+                for (size_t i = first; i < last; i++) {
+                    RenderMesh *renderMesh = m_RenderMeshes[m_MainDrawList.GetCommands()[i].index].get();
 
-                    renderModel.matricesUBO.viewMatrix = viewMatrix;
-                    renderModel.matricesUBO.projectionMatrix = projectionMatrix;
+                    // quantized meshes are sorted after the rest, this only switches once per chunk.
+                    if (renderMesh->isQuantized) {
+                        stateTracker.BindPipeline(m_QuantizedGraphicsPipeline.pipeline);
 
-                    SDL_memcpy(renderModel.matricesUBOBuffer.mappedData, &renderModel.matricesUBO, sizeof(renderModel.matricesUBO));
+                        vkCmdPushConstants(commandBuffer, m_QuantizedGraphicsPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(QuantizationParameters), &renderMesh->quantizationParameters);
+                    } else {
+                        stateTracker.BindPipeline(m_MainGraphicsPipeline.pipeline);
+                    }
 
                     // vertex buffer binding!!
-                    VkDeviceSize mainOffsets[] = {0};
-                    vkCmdBindVertexBuffers(m_CommandBuffers[currentFrameIndex], 0, 1, &renderModel.vertexBuffer.buffer, mainOffsets);
+                    stateTracker.BindVertexBuffer(0, renderMesh->vertexBuffer.buffer);
 
-                    vkCmdBindIndexBuffer(m_CommandBuffers[currentFrameIndex], renderModel.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-                    size_t uniformBufferSize = sizeof(MatricesUBO);
-
-                    // update descriptor set with buffer
-                    VkDescriptorBufferInfo bufferInfo{};
-                    bufferInfo.buffer = renderModel.matricesUBOBuffer.buffer;
-                    bufferInfo.offset = 0;
-                    bufferInfo.range = uniformBufferSize;
+                    stateTracker.BindIndexBuffer(renderMesh->indexBuffer.buffer, renderMesh->indexType);
 
                     // update descriptor set with image
                     VkDescriptorImageInfo imageInfo{};
                     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    imageInfo.imageView = renderModel.diffTextureImageView;
-                    imageInfo.sampler = renderModel.diffTextureSampler;
+                    imageInfo.imageView = renderMesh->diffTextureImageView;
+                    imageInfo.sampler = renderMesh->diffTextureSampler;
 
                     std::array<VkWriteDescriptorSet, 2> descriptorWrites;
                     descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -2245,24 +3353,31 @@ void Renderer::Start() {
                     descriptorWrites[1].descriptorCount = 1;
                     descriptorWrites[1].pImageInfo = &imageInfo;
 
-                    vkCmdPushDescriptorSet(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainGraphicsPipeline.layout, 0, descriptorWrites.size(), descriptorWrites.data());
+                    // bindless draws only push the UBO (once per chunk), the texture comes from the table.
+                    if (m_TextureTable) {
+                        if (stateTracker.DescriptorsChanged({(Uint64)bufferInfo.buffer}))
+                            vkCmdPushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainGraphicsPipeline.layout, 0, 1, descriptorWrites.data());
+                    } else if (stateTracker.DescriptorsChanged({(Uint64)bufferInfo.buffer, (Uint64)imageInfo.imageView, (Uint64)imageInfo.sampler})) {
+                        vkCmdPushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainGraphicsPipeline.layout, 0, descriptorWrites.size(), descriptorWrites.data());
+                    }
 
-                    //vkCmdBindDescriptorSets(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_MainGraphicsPipeline.layout, 0, 1, &m_RenderDescriptorSet, 0, nullptr);
-                    vkCmdDrawIndexed(m_CommandBuffers[currentFrameIndex], renderModel.indexBufferSize, 1, 0, 0, 0);
+                    vkCmdDrawIndexed(commandBuffer, renderMesh->indexBufferSize, renderMesh->instanceCount, 0, 0, renderMesh->firstInstance);
                 }
-            }
+            });
 
             // WAYPOINT SHADER!
-            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            vkCmdBindPipeline(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIWaypointGraphicsPipeline.pipeline);
+            RecordSubpassInParallel(m_CommandBuffers[currentFrameIndex], m_MainRenderPass, 1, m_RenderFramebuffer, m_PrimaryCamera ? m_RenderUIWaypoints.size() : 0, m_ProfilerScopes.waypoints, [&](VkCommandBuffer commandBuffer, CommandStateTracker &stateTracker, size_t first, size_t last) {
+                stateTracker.BindPipeline(m_UIWaypointGraphicsPipeline.pipeline);
 
-            vkCmdSetViewport(m_CommandBuffers[currentFrameIndex], 0, 1, &m_RenderViewport);
+                vkCmdSetViewport(commandBuffer, 0, 1, &m_RenderViewport);
 
-            vkCmdSetScissor(m_CommandBuffers[currentFrameIndex], 0, 1, &m_RenderScissor);
+                vkCmdSetScissor(commandBuffer, 0, 1, &m_RenderScissor);
+
+                for (size_t i = first; i < last; i++) {
+                    RenderUIWaypoint &renderUIWaypoint = m_RenderUIWaypoints[i];
 
-            if (m_PrimaryCamera) {
-                for (RenderUIWaypoint &renderUIWaypoint : m_RenderUIWaypoints) {
                     if (!renderUIWaypoint.waypoint->GetVisible()) {
                         continue;
                     }
@@ -2278,94 +3393,66 @@ void Renderer::Start() {
                     SDL_memcpy(renderUIWaypoint.waypointUBOBuffer.mappedData, &renderUIWaypoint.waypointUBO, sizeof(renderUIWaypoint.waypointUBO));
 
                     // vertex buffer binding!!
-                    VkDeviceSize waypointVertexOffsets[] = {0};
-                    vkCmdBindVertexBuffers(m_CommandBuffers[currentFrameIndex], 0, 1, &(m_FullscreenQuadVertexBuffer.buffer), waypointVertexOffsets);
+                    stateTracker.BindVertexBuffer(0, m_FullscreenQuadVertexBuffer.buffer);
 
-                    vkCmdBindDescriptorSets(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIWaypointGraphicsPipeline.layout, 0, 1, &renderUIWaypoint.descriptorSet, 0, nullptr);
-                    vkCmdDraw(m_CommandBuffers[currentFrameIndex], 6, 1, 0, 0);
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIWaypointGraphicsPipeline.layout, 0, 1, &renderUIWaypoint.descriptorSet, 0, nullptr);
+                    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
                 }
-            }
+            });
 
             // ARROWS SHADER!
-            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            vkCmdBindPipeline(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIArrowsGraphicsPipeline.pipeline);
+            // split by arrow set, the arrows of one set share their models.
+            RecordSubpassInParallel(m_CommandBuffers[currentFrameIndex], m_MainRenderPass, 2, m_RenderFramebuffer, m_PrimaryCamera ? m_RenderUIArrows.size() : 0, m_ProfilerScopes.arrows, [&](VkCommandBuffer commandBuffer, CommandStateTracker &stateTracker, size_t first, size_t last) {
+                stateTracker.BindPipeline(m_UIArrowsGraphicsPipeline.pipeline);
 
-            vkCmdSetViewport(m_CommandBuffers[currentFrameIndex], 0, 1, &m_RenderViewport);
+                vkCmdSetViewport(commandBuffer, 0, 1, &m_RenderViewport);
 
-            vkCmdSetScissor(m_CommandBuffers[currentFrameIndex], 0, 1, &m_RenderScissor);
+                vkCmdSetScissor(commandBuffer, 0, 1, &m_RenderScissor);
 
-            if (m_PrimaryCamera) {
-                for (RenderUIArrows &renderUIArrows : m_RenderUIArrows) {
-                    if (!renderUIArrows.arrows->GetVisible()) {
-                        continue;
-                    }
+                // only the camera is in a UBO, and it's the same for every arrow.
+                VkDescriptorBufferInfo bufferInfo{};
+                bufferInfo.buffer = m_FrameUBOBuffers[currentFrameIndex].buffer;
+                bufferInfo.offset = 0;
+                bufferInfo.range = sizeof(FrameUBO);
 
-                    // index for arrowBuffers
-                    int i = 0;
+                VkWriteDescriptorSet descriptorWrite{};
+                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrite.dstSet = m_RenderDescriptorSet; // Ignored
+                descriptorWrite.dstBinding = 0;
+                descriptorWrite.dstArrayElement = 0;
+                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                descriptorWrite.descriptorCount = 1;
+                descriptorWrite.pBufferInfo = &bufferInfo;
 
-                    for (RenderModel &arrowRenderModel : renderUIArrows.arrowRenderModels) {
-                        MatricesUBO &matricesUBO = renderUIArrows.arrowBuffers[i].first.first;
-                        UIArrowsUBO &arrowsUBO = renderUIArrows.arrowBuffers[i].first.second;
+                vkCmdPushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIArrowsGraphicsPipeline.layout, 0, 1, &descriptorWrite);
 
-                        BufferAndMemory &matricesUBOBuffer = renderUIArrows.arrowBuffers[i].second.first;
-                        BufferAndMemory &arrowsUBOBuffer = renderUIArrows.arrowBuffers[i].second.second;
+                for (size_t arrowsIndex = first; arrowsIndex < last; arrowsIndex++) {
+                    RenderUIArrows &renderUIArrows = m_RenderUIArrows[arrowsIndex];
 
-                        matricesUBO.modelMatrix = arrowRenderModel.model->GetModelMatrix();
-                        matricesUBO.viewMatrix = viewMatrix;
-                        matricesUBO.projectionMatrix = projectionMatrix;
+                    if (!renderUIArrows.arrows->GetVisible()) {
+                        continue;
+                    }
 
-                        SDL_memcpy(matricesUBOBuffer.mappedData, &matricesUBO, sizeof(matricesUBO));
+                    for (RenderModel &arrowRenderModel : renderUIArrows.arrowRenderModels) {
+                        UIArrowsPushConstants pushConstants{arrowRenderModel.model->GetModelMatrix(), glm::vec4(arrowRenderModel.mesh->diffColor, 1.0f)};
 
-                        arrowsUBO.Color = arrowRenderModel.diffColor;
+                        // vertex buffer binding!!
+                        stateTracker.BindVertexBuffer(0, arrowRenderModel.mesh->vertexBuffer.buffer);
 
-                        SDL_memcpy(arrowsUBOBuffer.mappedData, &arrowsUBO, sizeof(arrowsUBO));
+                        stateTracker.BindIndexBuffer(arrowRenderModel.mesh->indexBuffer.buffer, arrowRenderModel.mesh->indexType);
 
-                        // vertex buffer binding!!
-                        VkDeviceSize arrowsVertexOffsets[] = {0};
-                        vkCmdBindVertexBuffers(m_CommandBuffers[currentFrameIndex], 0, 1, &(arrowRenderModel.vertexBuffer.buffer), arrowsVertexOffsets);
-
-                        vkCmdBindIndexBuffer(m_CommandBuffers[currentFrameIndex], arrowRenderModel.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-                        // update descriptor set with buffer
-                        VkDescriptorBufferInfo bufferInfo{};
-                        bufferInfo.buffer = matricesUBOBuffer.buffer;
-                        bufferInfo.offset = 0;
-                        bufferInfo.range = sizeof(matricesUBO);
-
-                        // update descriptor set with buffer
-                        VkDescriptorBufferInfo bufferInfo2{};
-                        bufferInfo2.buffer = arrowsUBOBuffer.buffer;
-                        bufferInfo2.offset = 0;
-                        bufferInfo2.range = sizeof(arrowsUBO);
-
-                        std::array<VkWriteDescriptorSet, 2> descriptorWrites;
-                        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                        descriptorWrites[0].pNext = nullptr;
-                        descriptorWrites[0].dstSet = m_RenderDescriptorSet; // Ignored
-                        descriptorWrites[0].dstBinding = 0;
-                        descriptorWrites[0].dstArrayElement = 0;
-                        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                        descriptorWrites[0].descriptorCount = 1;
-                        descriptorWrites[0].pBufferInfo = &bufferInfo;
-                        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                        descriptorWrites[1].pNext = nullptr;
-                        descriptorWrites[1].dstSet = m_RenderDescriptorSet; // Ignored
-                        descriptorWrites[1].dstBinding = 1;
-                        descriptorWrites[1].dstArrayElement = 0;
-                        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                        descriptorWrites[1].descriptorCount = 1;
-                        descriptorWrites[1].pBufferInfo = &bufferInfo2;
-
-                        vkCmdPushDescriptorSet(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIArrowsGraphicsPipeline.layout, 0, descriptorWrites.size(), descriptorWrites.data());
-                        vkCmdDrawIndexed(m_CommandBuffers[currentFrameIndex], arrowRenderModel.indexBufferSize, 1, 0, 0, 0);
-
-                        i++;
+                        vkCmdPushConstants(commandBuffer, m_UIArrowsGraphicsPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+                        vkCmdDrawIndexed(commandBuffer, arrowRenderModel.mesh->indexBufferSize, 1, 0, 0, 0);
                     }
                 }
-            }
+            });
 
             vkCmdEndRenderPass(m_CommandBuffers[currentFrameIndex]);
+
+            m_GPUProfiler->EndStatistics(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.mainPass);
+            m_GPUProfiler->WriteEndTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.mainPass);
         }
 
         //ChangeImageLayout(m_RenderImageAndMemory.image, m_RenderImageFormat, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
@@ -2386,220 +3473,204 @@ void Renderer::Start() {
             renderPassBeginInfo.clearValueCount = clearColors.size();
             renderPassBeginInfo.pClearValues = clearColors.data();
 
+            m_GPUProfiler->WriteBeginTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.rescalePass);
+            m_GPUProfiler->BeginStatistics(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.rescalePass);
+
+            // just one draw, not worth a secondary buffer.
             vkCmdBeginRenderPass(m_CommandBuffers[currentFrameIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-            vkCmdBindPipeline(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_RescaleGraphicsPipeline.pipeline);
+            m_GPUProfiler->WriteBeginTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.rescale);
+
+            m_CommandStateTracker.Reset(m_CommandBuffers[currentFrameIndex]);
+
+            m_CommandStateTracker.BindPipeline(m_RescaleGraphicsPipeline.pipeline);
 
             vkCmdSetViewport(m_CommandBuffers[currentFrameIndex], 0, 1, &m_DisplayViewport);
 
             vkCmdSetScissor(m_CommandBuffers[currentFrameIndex], 0, 1, &m_DisplayScissor);
 
             // vertex buffer binding!!
-            VkDeviceSize mainOffsets[] = {0};
-            vkCmdBindVertexBuffers(m_CommandBuffers[currentFrameIndex], 0, 1, &(m_FullscreenQuadVertexBuffer.buffer), mainOffsets);
+            m_CommandStateTracker.BindVertexBuffer(0, m_FullscreenQuadVertexBuffer.buffer);
 
             vkCmdBindDescriptorSets(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_RescaleGraphicsPipeline.layout, 0, 1, &m_RescaleDescriptorSet, 0, nullptr);
             vkCmdDraw(m_CommandBuffers[currentFrameIndex], 6, 1, 0, 0);
 
-            // Panel Shader
-            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_INLINE);
+            m_GPUProfiler->WriteEndTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.rescale);
 
-            vkCmdBindPipeline(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIPanelGraphicsPipeline.pipeline);
+            // Panel Shader
+            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            vkCmdSetViewport(m_CommandBuffers[currentFrameIndex], 0, 1, &m_DisplayViewport);
+            // every visible panel is one instance, already back to front, so it's a single draw and a single chunk.
+            RecordSubpassInParallel(m_CommandBuffers[currentFrameIndex], m_RescaleRenderPass, 1, m_SwapchainFramebuffers[imageIndex], m_UIPanelInstanceCount > 0 ? 1 : 0, m_ProfilerScopes.uiPanels, [&](VkCommandBuffer commandBuffer, CommandStateTracker &stateTracker, size_t, size_t) {
+                stateTracker.BindPipeline(m_UIPanelGraphicsPipeline.pipeline);
 
-            vkCmdSetScissor(m_CommandBuffers[currentFrameIndex], 0, 1, &m_DisplayScissor);
+                vkCmdSetViewport(commandBuffer, 0, 1, &m_DisplayViewport);
 
-            for (RenderUIPanel &renderUIPanel : m_UIPanels) {
-                if (!renderUIPanel.panel->GetVisible()) {
-                    continue;
-                }
+                vkCmdSetScissor(commandBuffer, 0, 1, &m_DisplayScissor);
 
                 // vertex buffer binding!!
-                VkDeviceSize panelVertexOffsets[] = {0};
-                vkCmdBindVertexBuffers(m_CommandBuffers[currentFrameIndex], 0, 1, &(m_FullscreenQuadVertexBuffer.buffer), panelVertexOffsets);
-
-                renderUIPanel.ubo.Dimensions = renderUIPanel.panel->GetDimensions();
-                
-                /* Double the scales for some odd reason.. */
-                renderUIPanel.ubo.Dimensions.z *= 2;
-                renderUIPanel.ubo.Dimensions.w *= 2;
-
-                /* Convert [0, 1] to [-1, 1] */
-                renderUIPanel.ubo.Dimensions.x *= 2;
-                renderUIPanel.ubo.Dimensions.x -= 1;
-                
-                renderUIPanel.ubo.Dimensions.y *= 2;
-                renderUIPanel.ubo.Dimensions.y -= 1;
-
-                renderUIPanel.ubo.Depth = renderUIPanel.panel->GetDepth();
-
-                SDL_memcpy(renderUIPanel.uboBuffer.mappedData, &(renderUIPanel.ubo), sizeof(renderUIPanel.ubo));
-
-                // update descriptor set with image
-                VkDescriptorImageInfo imageInfo{};
-                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                imageInfo.imageView = renderUIPanel.textureView;
-                imageInfo.sampler = renderUIPanel.textureSampler;
+                stateTracker.BindVertexBuffer(0, m_FullscreenQuadVertexBuffer.buffer);
 
-                // update descriptor set with UBO
+                // laid out already, it's all in the UI instance buffer.
                 VkDescriptorBufferInfo bufferInfo{};
-                bufferInfo.buffer = renderUIPanel.uboBuffer.buffer;
+                bufferInfo.buffer = m_UIInstanceBuffer.buffer;
                 bufferInfo.offset = 0;
-                bufferInfo.range = sizeof(renderUIPanel.ubo);
-
-                std::array<VkWriteDescriptorSet, 2> descriptorWrites;
-                descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[0].pNext = nullptr;
-                descriptorWrites[0].dstSet = m_RescaleDescriptorSet; // Ignored
-                descriptorWrites[0].dstBinding = 0;
-                descriptorWrites[0].dstArrayElement = 0;
-                descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrites[0].descriptorCount = 1;
-                descriptorWrites[0].pBufferInfo = &bufferInfo;
-                descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[1].pNext = nullptr;
-                descriptorWrites[1].dstSet = m_RescaleDescriptorSet; // Ignored
-                descriptorWrites[1].dstBinding = 1;
-                descriptorWrites[1].dstArrayElement = 0;
-                descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites[1].descriptorCount = 1;
-                descriptorWrites[1].pImageInfo = &imageInfo;
-
-                vkCmdPushDescriptorSet(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIPanelGraphicsPipeline.layout, 0, descriptorWrites.size(), descriptorWrites.data());
-                vkCmdDraw(m_CommandBuffers[currentFrameIndex], 6, 1, 0, 0);
-            }
-
-            // Label Shader
-            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_INLINE);
+                bufferInfo.range = VK_WHOLE_SIZE;
 
-            vkCmdBindPipeline(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UILabelGraphicsPipeline.pipeline);
+                VkWriteDescriptorSet descriptorWrite{};
+                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrite.dstSet = m_RescaleDescriptorSet; // Ignored
+                descriptorWrite.dstBinding = 0;
+                descriptorWrite.dstArrayElement = 0;
+                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrite.descriptorCount = 1;
+                descriptorWrite.pBufferInfo = &bufferInfo;
 
-            vkCmdSetViewport(m_CommandBuffers[currentFrameIndex], 0, 1, &m_DisplayViewport);
+                vkCmdPushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_UIPanelGraphicsPipeline.layout, 0, 1, &descriptorWrite);
+                vkCmdDraw(commandBuffer, 6, m_UIPanelInstanceCount, 0, 0);
+            });
 
-            vkCmdSetScissor(m_CommandBuffers[currentFrameIndex], 0, 1, &m_DisplayScissor);
+            // Label Shader
+            vkCmdNextSubpass(m_CommandBuffers[currentFrameIndex], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-            for (RenderUILabel &renderUILabel : m_UILabels) {
-                if (!renderUILabel.label->GetVisible()) {
-                    continue;
-                }
+            RecordSubpassInParallel(m_CommandBuffers[currentFrameIndex], m_RescaleRenderPass, 2, m_SwapchainFramebuffers[imageIndex], m_UILabels.size(), m_ProfilerScopes.uiLabels, [&](VkCommandBuffer commandBuffer, CommandStateTracker &stateTracker, size_t first, size_t last) {
+                stateTracker.BindPipeline(m_UILabelGraphicsPipeline.pipeline);
 
-                // vertex buffer binding!!
-                VkDeviceSize labelVertexOffsets[] = {0};
+                vkCmdSetViewport(commandBuffer, 0, 1, &m_DisplayViewport);
 
-                renderUILabel.ubo.PositionOffset = renderUILabel.label->GetPosition();
-                renderUILabel.ubo.PositionOffset.x *= 2;
-                renderUILabel.ubo.PositionOffset.y *= 2;
+                vkCmdSetScissor(commandBuffer, 0, 1, &m_DisplayScissor);
 
-                renderUILabel.ubo.Depth = renderUILabel.label->GetDepth();
+                // update descriptor set with the laid out glyphs
+                VkDescriptorBufferInfo bufferInfo{};
+                bufferInfo.buffer = m_UIInstanceBuffer.buffer;
+                bufferInfo.offset = 0;
+                bufferInfo.range = VK_WHOLE_SIZE;
 
-                SDL_memcpy(renderUILabel.uboBuffer.mappedData, &(renderUILabel.ubo), sizeof(renderUILabel.ubo));
+                // nothing but the atlas page changes between draws, only push when it does.
+                Uint32 boundPage = UINT32_MAX;
 
-                size_t i = 0;
-                for (auto &shaderData : renderUILabel.textureShaderData) {
-                    auto &glyph = renderUILabel.label->Glyphs[i++];
+                for (size_t labelIndex = first; labelIndex < last; labelIndex++) {
+                    RenderUILabel &renderUILabel = m_UILabels[labelIndex];
 
-                    vkCmdBindVertexBuffers(m_CommandBuffers[currentFrameIndex], 0, 1, &(glyph.glyphBuffer.value().second.buffer), labelVertexOffsets);
+                    if (!renderUILabel.isVisible || renderUILabel.glyphInstanceRanges.empty()) {
+                        continue;
+                    }
 
-                    glyph.glyphUBO.Offset = glyph.offset;
-                    
-                    SDL_memcpy(glyph.glyphUBOBuffer.mappedData, &(glyph.glyphUBO), sizeof(glyph.glyphUBO));
+                    stateTracker.BindVertexBuffer(0, m_GlyphQuadBuffer.buffer);
+
+                    // one draw per atlas page, that's almost always just one.
+                    for (GlyphInstanceRange &glyphInstanceRange : renderUILabel.glyphInstanceRanges) {
+                        if (glyphInstanceRange.page != boundPage) {
+                            // update descriptor set with the atlas page
+                            VkDescriptorImageInfo imageInfo{};
+                            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                            imageInfo.imageView = m_GlyphAtlas->GetPageView(glyphInstanceRange.page);
+                            imageInfo.sampler = m_GlyphAtlas->GetSampler();
+
+                            std::array<VkWriteDescriptorSet, 2> descriptorWrites;
+                            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                            descriptorWrites[0].pNext = nullptr;
+                            descriptorWrites[0].dstSet = m_RenderDescriptorSet; // Ignored
+                            descriptorWrites[0].dstBinding = 0;
+                            descriptorWrites[0].dstArrayElement = 0;
+                            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                            descriptorWrites[0].descriptorCount = 1;
+                            descriptorWrites[0].pBufferInfo = &bufferInfo;
+                            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                            descriptorWrites[1].pNext = nullptr;
+                            descriptorWrites[1].dstSet = m_RenderDescriptorSet; // Ignored
+                            descriptorWrites[1].dstBinding = 1;
+                            descriptorWrites[1].dstArrayElement = 0;
+                            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                            descriptorWrites[1].descriptorCount = 1;
+                            descriptorWrites[1].pImageInfo = &imageInfo;
+
+                            vkCmdPushDescriptorSet(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_UILabelGraphicsPipeline.layout, 0, descriptorWrites.size(), descriptorWrites.data());
+
+                            boundPage = glyphInstanceRange.page;
+                        }
 
-                    // update descriptor set with image
-                    VkDescriptorImageInfo imageInfo{};
-                    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    imageInfo.imageView = shaderData.second.first;
-                    imageInfo.sampler = shaderData.second.second;
-
-                    // update descriptor set with UBO
-                    VkDescriptorBufferInfo labelBufferInfo{};
-                    labelBufferInfo.offset = 0;
-                    labelBufferInfo.range = sizeof(renderUILabel.ubo);
-                    labelBufferInfo.buffer = renderUILabel.uboBuffer.buffer;
-
-                    // update descriptor set with UBO
-                    VkDescriptorBufferInfo glyphBufferInfo{};
-                    glyphBufferInfo.offset = 0;
-                    glyphBufferInfo.range = sizeof(glyph.glyphUBO);
-                    glyphBufferInfo.buffer = glyph.glyphUBOBuffer.buffer;
-
-                    std::array<VkWriteDescriptorSet, 3> descriptorWrites;
-                    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    descriptorWrites[0].pNext = nullptr;
-                    descriptorWrites[0].dstSet = m_RenderDescriptorSet; // Ignored
-                    descriptorWrites[0].dstBinding = 0;
-                    descriptorWrites[0].dstArrayElement = 0;
-                    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                    descriptorWrites[0].descriptorCount = 1;
-                    descriptorWrites[0].pBufferInfo = &labelBufferInfo;
-                    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    descriptorWrites[1].pNext = nullptr;
-                    descriptorWrites[1].dstSet = m_RenderDescriptorSet; // Ignored
-                    descriptorWrites[1].dstBinding = 1;
-                    descriptorWrites[1].dstArrayElement = 0;
-                    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                    descriptorWrites[1].descriptorCount = 1;
-                    descriptorWrites[1].pImageInfo = &imageInfo;
-                    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                    descriptorWrites[2].pNext = nullptr;
-                    descriptorWrites[2].dstSet = m_RenderDescriptorSet; // Ignored
-                    descriptorWrites[2].dstBinding = 2;
-                    descriptorWrites[2].dstArrayElement = 0;
-                    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                    descriptorWrites[2].descriptorCount = 1;
-                    descriptorWrites[2].pBufferInfo = &glyphBufferInfo;
-
-                    vkCmdPushDescriptorSet(m_CommandBuffers[currentFrameIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, m_UILabelGraphicsPipeline.layout, 0, descriptorWrites.size(), descriptorWrites.data());
-                    vkCmdDraw(m_CommandBuffers[currentFrameIndex], 6, 1, 0, 0);
+                        vkCmdDraw(commandBuffer, 6, glyphInstanceRange.instanceCount, 0, renderUILabel.firstInstance + glyphInstanceRange.firstInstance);
+                    }
                 }
-            }
+            });
 
             vkCmdEndRenderPass(m_CommandBuffers[currentFrameIndex]);
+
+            m_GPUProfiler->EndStatistics(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.rescalePass);
+            m_GPUProfiler->WriteEndTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.rescalePass);
         }
 
+        if (m_Settings.Headless)
+            RecordReadback(m_CommandBuffers[currentFrameIndex], imageIndex);
+
+        m_GPUProfiler->WriteEndTimestamp(m_CommandBuffers[currentFrameIndex], m_ProfilerScopes.frame);
+
         //ChangeImageLayout(m_RenderImageAndMemory.image, m_RenderImageFormat, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
 #ifdef LOG_FRAME
         afterRenderTime = high_resolution_clock::now();
 
         fmt::println("Time spent rendering: {:.5f}ms", (duration_cast<duration<double, std::milli>>(afterRenderTime - afterUpdateTime).count()));
+        fmt::println("Binds: {}, redundant binds skipped: {}", m_CommandStateTracker.GetBindCount() + m_SecondaryCommandRecorder->GetBindCount(), m_CommandStateTracker.GetSkippedBindCount() + m_SecondaryCommandRecorder->GetSkippedBindCount());
+
+        m_GPUProfiler->PrintResults();
 #endif
 
         if (vkEndCommandBuffer(m_CommandBuffers[currentFrameIndex]) != VK_SUCCESS)
             throw std::runtime_error(engineError::COMMAND_BUFFER_END_FAILURE);
 
+        // anything recorded during this frame (glyphs, panels...) has to reach the queue before the frame that uses it.
+        m_UploadBatcher->Submit();
+
         // we recorded all the commands, submit them.
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &m_ImageAvailableSemaphores[currentFrameIndex];
-        submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &m_CommandBuffers[currentFrameIndex];
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = &m_RenderFinishedSemaphores[currentFrameIndex];
+
+        // nothing to acquire or present when headless, the fence is enough.
+        if (!m_Settings.Headless) {
+            submitInfo.waitSemaphoreCount = 1;
+            submitInfo.pWaitSemaphores = &m_ImageAvailableSemaphores[currentFrameIndex];
+            submitInfo.pWaitDstStageMask = waitStages;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &m_RenderFinishedSemaphores[currentFrameIndex];
+        }
 
         VkResult queueSubmitResult = vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_InFlightFences[currentFrameIndex]);
         if (queueSubmitResult != VK_SUCCESS)
             throw std::runtime_error(fmt::format(engineError::QUEUE_SUBMIT_FAILURE, string_VkResult(queueSubmitResult)));
 
-        // we finished, now we should present the frame.
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        double cpuMilliseconds = duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - frameTime).count() - waitMilliseconds;
+        m_CPUFrameMilliseconds += (cpuMilliseconds - m_CPUFrameMilliseconds) / GPU_PROFILER_HISTORY;
+
+        if (m_Settings.Headless) {
+            m_ReadbackFrameNumbers[currentFrameIndex] = m_FrameNumber;
+
+            if (m_Settings.HeadlessFrameCount > 0 && m_FrameNumber + 1 >= m_Settings.HeadlessFrameCount)
+                shouldQuit = true;
+        } else {
+            // we finished, now we should present the frame.
+            VkPresentInfoKHR presentInfo{};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = &m_RenderFinishedSemaphores[currentFrameIndex];
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = &m_RenderFinishedSemaphores[currentFrameIndex];
 
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = &m_Swapchain;
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = &m_Swapchain;
 
-        presentInfo.pImageIndices = &imageIndex;
+            presentInfo.pImageIndices = &imageIndex;
 
-        presentInfo.pResults = nullptr;
+            presentInfo.pResults = nullptr;
+
+            vkQueuePresentKHR(m_GraphicsQueue, &presentInfo);
+        }
 
-        vkQueuePresentKHR(m_GraphicsQueue, &presentInfo);
+        m_FrameNumber++;
 
         currentFrameIndex = (currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -2610,10 +3681,31 @@ void Renderer::Start() {
 #endif
     }
 
+    // the last frames in flight haven't been read back yet, oldest first.
+    if (m_Settings.Headless) {
+        vkDeviceWaitIdle(m_EngineDevice);
+
+        for (Uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            ProcessReadback((currentFrameIndex + i) % MAX_FRAMES_IN_FLIGHT);
+    }
+
     //fixedUpdateThread.join();
 }
 
 Engine::~Engine() {
+    // nobody is around for the callbacks anymore, just wait for the loader threads and drop what they made.
+    for (std::shared_ptr<SceneLoad> &load : m_SceneLoads) {
+        load->Cancel();
+
+        if (load->m_Thread.joinable())
+            load->m_Thread.join();
+
+        for (size_t i = 0; i < load->m_NextModel; i++)
+            m_Renderer->UnloadModel(load->m_Models[i]);
+
+        delete load->m_RootObject;
+    }
+
     for (NetworkingThreadState &state : m_NetworkingThreadStates) {
         if (state.status != NETWORKING_THREAD_INACTIVE) {
             state.shouldQuit = true;
@@ -2635,6 +3727,7 @@ void Engine::InitRenderer(Settings &settings, Camera *primaryCamera) {
 
     m_Renderer->RegisterSDLEventListener(std::bind(&Engine::CheckButtonClicks, this, std::placeholders::_1), SDL_EVENT_MOUSE_BUTTON_UP);
     m_Renderer->RegisterUpdateFunction(std::bind(&Engine::ProcessNetworkEvents, this, &m_NetworkingEvents));
+    m_Renderer->RegisterUpdateFunction(std::bind(&Engine::ProcessSceneLoads, this));
 }
 
 void Engine::InitNetworking() {
@@ -2787,12 +3880,21 @@ void Engine::LoadUIFile(const std::string &name) {
 }
 
 void Engine::AddObject(Object *object) {
-    fmt::println("Adding Object!");
-    
+    std::vector<Model *> models;
+
+    AddObjectTree(object, models);
+
+    // the whole tree at once, so every texture in it is decoded in parallel.
     if (m_Renderer) {
-        for (Model *model : object->GetModelAttachments()) {
-            m_Renderer->LoadModel(model);
-        }
+        m_Renderer->LoadModels(models);
+    }
+}
+
+void Engine::AddObjectTree(Object *object, std::vector<Model *> &models) {
+    fmt::println("Adding Object!");
+
+    for (Model *model : object->GetModelAttachments()) {
+        models.push_back(model);
     }
 
     if (object->GetCameraAttachment()) {
@@ -2810,7 +3912,7 @@ void Engine::AddObject(Object *object) {
     }
 
     for (Object *child : object->GetChildren()) {
-        AddObject(child);
+        AddObjectTree(child, models);
     }
 
     m_Objects.push_back(object);
@@ -2872,28 +3974,190 @@ Output:
     - True if the scene was sucessfully imported.
 */
 bool Engine::ImportScene(const std::string &path) {
+    UnloadScene();
+
+    Object *rootObject = new Object();
+
+    // without a renderer there are no settings, and nothing gets cached.
+    rootObject->ImportFromFile(path, {}, m_Settings ? m_Settings->MeshCacheDirectory : "", m_Settings && m_Settings->QuantizeVertices, m_Settings && m_Settings->Verbose);
+
+    AddObject(rootObject);
+
+    m_ScenePath = path;
+
+    return true;
+}
+
+std::shared_ptr<SceneLoad> Engine::ImportSceneAsync(const std::string &path, const std::function<void(bool)> &onDone) {
+    std::shared_ptr<SceneLoad> load = std::make_shared<SceneLoad>();
+
+    load->m_Path = path;
+    load->m_Result = load->m_Promise.get_future().share();
+    load->m_OnDone = onDone;
+
+    // nothing calls ProcessSceneLoads without a renderer.
+    if (!m_Renderer) {
+        try {
+            ImportScene(path);
+        } catch (...) {
+            load->m_Exception = std::current_exception();
+        }
+
+        FinishSceneLoad(*load, !load->m_Exception);
+
+        return load;
+    }
+
+    std::string cacheDirectory = m_Settings->MeshCacheDirectory;
+    bool quantizeVertices = m_Settings->QuantizeVertices;
+    bool verbose = m_Settings->Verbose;
+
+    // the load is kept alive by the thread too, it doesn't matter if the caller drops it.
+    load->m_Thread = std::thread([this, load, cacheDirectory, quantizeVertices, verbose]() {
+        try {
+            load->m_RootObject = new Object();
+            load->m_RootObject->ImportFromFile(load->m_Path, {}, cacheDirectory, quantizeVertices, verbose);
+
+            std::vector<Object *> objects = {load->m_RootObject};
+
+            while (!objects.empty()) {
+                Object *object = objects.back();
+                objects.pop_back();
+
+                for (Model *model : object->GetModelAttachments())
+                    load->m_Models.push_back(model);
+
+                for (Object *child : object->GetChildren())
+                    objects.push_back(child);
+            }
+
+            // the recording pool belongs to the main thread, and leave it a core.
+            if (!load->m_IsCancelled) {
+                ThreadPool threadPool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+                load->m_Textures = m_Renderer->DecodeModelTextures(load->m_Models, threadPool);
+            }
+        } catch (...) {
+            load->m_Exception = std::current_exception();
+        }
+
+        load->m_IsImported = true;
+    });
+
+    m_SceneLoads.push_back(load);
+
+    return load;
+}
+
+void Engine::UnloadScene() {
+    std::unordered_set<Object *> objects(m_Objects.begin(), m_Objects.end());
+
     for (Object *object : m_Objects) {
-        for (Model *model : object->GetModelAttachments()) {
-            if (m_Renderer) {
+        if (m_Renderer) {
+            for (Model *model : object->GetModelAttachments()) {
                 m_Renderer->UnloadModel(model);
             }
+        }
 
-            delete model;
+        if (object->GetCameraAttachment()) {
+            RemoveCamera(object->GetCameraAttachment());
         }
+    }
 
-        delete object;
+    // AddObjectTree put every child in m_Objects too, ~Object deletes those (and every model) through their root.
+    for (Object *object : m_Objects) {
+        if (objects.find(object->GetParent()) == objects.end()) {
+            delete object;
+        }
     }
     m_Objects.clear();
 
-    Object *rootObject = new Object();
+    /* The old scene is about to free most of its memory, no point in holding on to the empty pages once it's gone. */
+    if (m_Renderer)
+        m_Renderer->DefragmentMemory();
+}
 
-    rootObject->ImportFromFile(path);
+void Engine::ProcessSceneLoads() {
+    using namespace std::chrono;
 
-    AddObject(rootObject);
+    steady_clock::time_point startTime = steady_clock::now();
+    duration<float, std::milli> budget(m_Settings->StreamingBudget);
 
-    m_ScenePath = path;
+    while (!m_SceneLoads.empty()) {
+        std::shared_ptr<SceneLoad> load = m_SceneLoads.front();
 
-    return true;
+        // still importing, the ones behind it have to wait anyway.
+        if (!load->m_IsImported)
+            return;
+
+        if (load->m_Thread.joinable())
+            load->m_Thread.join();
+
+        if (load->m_Exception || load->m_IsCancelled) {
+            FinishSceneLoad(*load, false);
+            m_SceneLoads.pop_front();
+
+            continue;
+        }
+
+        // a model at a time, the textures are decoded already so it's mostly creating buffers and staging copies.
+        // they stay hidden, the old scene is still the one being drawn.
+        try {
+            while (load->m_NextModel < load->m_Models.size()) {
+                if (steady_clock::now() - startTime > budget)
+                    return;
+
+                m_Renderer->LoadModels({load->m_Models[load->m_NextModel]}, &load->m_Textures, true);
+                load->m_NextModel++;
+            }
+        } catch (...) {
+            // otherwise the result never resolves, and every load behind this one waits forever.
+            load->m_Exception = std::current_exception();
+
+            FinishSceneLoad(*load, false);
+            m_SceneLoads.pop_front();
+
+            continue;
+        }
+
+        // every model is loaded, swap the scenes in one go so there's never an empty or half-loaded one on screen.
+        UnloadScene();
+
+        m_Renderer->ShowModels(load->m_Models);
+
+        // AddObjectTree only needs to do the rest.
+        std::vector<Model *> models;
+        AddObjectTree(load->m_RootObject, models);
+
+        load->m_RootObject = nullptr;
+        m_ScenePath = load->m_Path;
+
+        FinishSceneLoad(*load, true);
+        m_SceneLoads.pop_front();
+    }
+}
+
+void Engine::FinishSceneLoad(SceneLoad &load, bool succeeded) {
+    if (load.m_RootObject) {
+        // m_NextModel too, LoadModels might've thrown halfway through it.
+        for (size_t i = 0; i < load.m_NextModel + 1 && i < load.m_Models.size(); i++)
+            m_Renderer->UnloadModel(load.m_Models[i]);
+
+        // takes its children and their models with it.
+        delete load.m_RootObject;
+        load.m_RootObject = nullptr;
+    }
+
+    load.m_Models.clear();
+    load.m_Textures.clear();
+
+    if (load.m_Exception)
+        load.m_Promise.set_exception(load.m_Exception);
+    else
+        load.m_Promise.set_value(succeeded);
+
+    if (load.m_OnDone)
+        load.m_OnDone(succeeded);
 }
 
 /* TODO: Implement with assimp */
@@ -3520,7 +4784,7 @@ void Engine::ProcessNetworkEvents(std::vector<Networking_Event> *networkingEvent
 
                     UTILASSERT(absoluteSourcePath.substr(0, absoluteResourcesPath.length()).compare(absoluteResourcesPath) == 0);
 
-                    object->ImportFromFile(absoluteSourcePath);
+                    object->ImportFromFile(absoluteSourcePath, {}, m_Settings ? m_Settings->MeshCacheDirectory : "", m_Settings && m_Settings->QuantizeVertices, m_Settings && m_Settings->Verbose);
 
                     std::vector<std::pair<Networking_Object *, int>> relatedObjects = FilterRelatedNetworkingObjects(m_ObjectsFromImportedObject, &objectPacket);
 
@@ -0,0 +1,148 @@
+#include "fontmanager.hpp"
+#include "error.hpp"
+
+#include "fmt/format.h"
+
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FontManager::FontManager() {
+    if (FT_Init_FreeType(&m_FTLibrary))
+        throw std::runtime_error(engineError::FREETYPE_INIT_FAILURE);
+}
+
+FontManager::~FontManager() {
+    // faces read straight out of the mapped files, close them first.
+    for (auto &font : m_Fonts)
+        FT_Done_Face(font.second.face);
+
+    for (auto &mappedFile : m_MappedFiles)
+        munmap(mappedFile.second.data, mappedFile.second.size);
+
+    if (m_FTLibrary)
+        FT_Done_FreeType(m_FTLibrary);
+}
+
+FontHandle FontManager::Acquire(const std::filesystem::path &path, Uint32 pixelSize) {
+    std::string fontKey = fmt::format("{}:{}", path.string(), pixelSize);
+
+    auto openFont = m_OpenFonts.find(fontKey);
+
+    if (openFont != m_OpenFonts.end()) {
+        m_Fonts[openFont->second].referenceCount++;
+
+        return openFont->second;
+    }
+
+    MappedFile &mappedFile = MapFile(path.string());
+
+    Font font{};
+    font.path = path.string();
+    font.pixelSize = pixelSize;
+    font.referenceCount = 1;
+
+    if (FT_New_Memory_Face(m_FTLibrary, static_cast<const FT_Byte *>(mappedFile.data), mappedFile.size, 0, &font.face)) {
+        UnmapFile(font.path);
+
+        throw std::runtime_error(fmt::format(engineError::FONT_LOADING_FAILURE, font.path));
+    }
+
+    FT_Set_Pixel_Sizes(font.face, 0, pixelSize);
+
+    std::string faceIdentifier = fmt::format("{} {} {}", font.face->family_name, font.face->style_name, font.face->height);
+
+    auto faceID = m_FaceIDs.find(faceIdentifier);
+
+    if (faceID == m_FaceIDs.end())
+        faceID = m_FaceIDs.emplace(faceIdentifier, m_FaceIDs.size()).first;
+
+    font.faceID = faceID->second;
+
+    FontHandle handle = m_NextHandle++;
+
+    m_Fonts.emplace(handle, font);
+    m_OpenFonts.emplace(fontKey, handle);
+
+    return handle;
+}
+
+void FontManager::Release(FontHandle handle) {
+    Font &font = GetFont(handle);
+
+    if (--font.referenceCount > 0)
+        return;
+
+    FT_Done_Face(font.face);
+    UnmapFile(font.path);
+
+    m_OpenFonts.erase(fmt::format("{}:{}", font.path, font.pixelSize));
+    m_Fonts.erase(handle);
+}
+
+FT_Face FontManager::GetFace(FontHandle handle) {
+    return GetFont(handle).face;
+}
+
+Uint32 FontManager::GetFaceID(FontHandle handle) {
+    return GetFont(handle).faceID;
+}
+
+Uint32 FontManager::GetPixelSize(FontHandle handle) {
+    return GetFont(handle).pixelSize;
+}
+
+FontManager::MappedFile &FontManager::MapFile(const std::string &path) {
+    auto mappedFile = m_MappedFiles.find(path);
+
+    if (mappedFile != m_MappedFiles.end()) {
+        mappedFile->second.referenceCount++;
+
+        return mappedFile->second;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        throw std::runtime_error(fmt::format(engineError::FONT_LOADING_FAILURE, path));
+
+    struct stat fileStat;
+
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+
+        throw std::runtime_error(fmt::format(engineError::FONT_LOADING_FAILURE, path));
+    }
+
+    void *data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping stays valid after the descriptor is closed.
+    close(fd);
+
+    if (data == MAP_FAILED)
+        throw std::runtime_error(fmt::format(engineError::FONT_LOADING_FAILURE, path));
+
+    return m_MappedFiles.emplace(path, MappedFile{data, static_cast<size_t>(fileStat.st_size), 1}).first->second;
+}
+
+void FontManager::UnmapFile(const std::string &path) {
+    auto mappedFile = m_MappedFiles.find(path);
+
+    if (mappedFile == m_MappedFiles.end() || --mappedFile->second.referenceCount > 0)
+        return;
+
+    munmap(mappedFile->second.data, mappedFile->second.size);
+
+    m_MappedFiles.erase(mappedFile);
+}
+
+FontManager::Font &FontManager::GetFont(FontHandle handle) {
+    auto font = m_Fonts.find(handle);
+
+    if (font == m_Fonts.end())
+        throw std::runtime_error(fmt::format(engineError::UNKNOWN_FONT_HANDLE, handle));
+
+    return font->second;
+}
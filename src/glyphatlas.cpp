@@ -0,0 +1,187 @@
+#include "glyphatlas.hpp"
+#include "error.hpp"
+
+#include "fmt/format.h"
+
+#include <stdexcept>
+
+GlyphAtlas::GlyphAtlas(VkDevice device, MemoryAllocator *allocator, UploadBatcher *uploadBatcher, DeletionQueue *deletionQueue, VkFormat format)
+    : m_Device(device), m_Allocator(allocator), m_UploadBatcher(uploadBatcher), m_DeletionQueue(deletionQueue), m_Format(format) {
+
+    // glyphs are sampled at (roughly) their native size, no mipmaps and no anisotropy.
+    VkSamplerCreateInfo samplerCreateInfo{};
+    samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerCreateInfo.anisotropyEnable = VK_FALSE;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerCreateInfo.compareEnable = VK_FALSE;
+    samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(m_Device, &samplerCreateInfo, NULL, &m_Sampler) != VK_SUCCESS)
+        throw std::runtime_error(engineError::SAMPLER_CREATION_FAILURE);
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    for (Page &page : m_Pages)
+        DestroyPage(page, false);
+
+    if (m_Sampler)
+        vkDestroySampler(m_Device, m_Sampler, NULL);
+}
+
+GlyphAtlasRegion GlyphAtlas::Add(Uint32 width, Uint32 height, const Uint8 *pixels, Sint32 pitch) {
+    Uint32 paddedWidth = width + GLYPH_ATLAS_PADDING * 2;
+    Uint32 paddedHeight = height + GLYPH_ATLAS_PADDING * 2;
+
+    if (paddedWidth > GLYPH_ATLAS_PAGE_SIZE || paddedHeight > GLYPH_ATLAS_PAGE_SIZE)
+        throw std::runtime_error(fmt::format(engineError::GLYPH_TOO_LARGE, width, height));
+
+    Uint32 pageIndex = 0;
+    Uint32 x, y;
+
+    // earlier pages might still have a shelf with room left.
+    while (pageIndex < m_Pages.size() && !Pack(m_Pages[pageIndex], paddedWidth, paddedHeight, x, y))
+        pageIndex++;
+
+    if (pageIndex == m_Pages.size()) {
+        m_Pages.emplace_back();
+        m_Pages.back().pixels.resize(GLYPH_ATLAS_PAGE_SIZE * GLYPH_ATLAS_PAGE_SIZE);
+
+        Pack(m_Pages.back(), paddedWidth, paddedHeight, x, y);
+    }
+
+    Page &page = m_Pages[pageIndex];
+
+    x += GLYPH_ATLAS_PADDING;
+    y += GLYPH_ATLAS_PADDING;
+
+    for (Uint32 row = 0; row < height; row++) {
+        // a negative pitch means the rows are stored bottom-up.
+        const Uint8 *source = pixels + (pitch >= 0 ? row * pitch : (height - 1 - row) * -pitch);
+
+        SDL_memcpy(page.pixels.data() + (y + row) * GLYPH_ATLAS_PAGE_SIZE + x, source, width);
+    }
+
+    page.isDirty = true;
+
+    GlyphAtlasRegion region;
+    region.page = pageIndex;
+    region.uvRect = glm::vec4(x / static_cast<float>(GLYPH_ATLAS_PAGE_SIZE), y / static_cast<float>(GLYPH_ATLAS_PAGE_SIZE),
+                              (x + width) / static_cast<float>(GLYPH_ATLAS_PAGE_SIZE), (y + height) / static_cast<float>(GLYPH_ATLAS_PAGE_SIZE));
+
+    return region;
+}
+
+void GlyphAtlas::Flush() {
+    for (Page &page : m_Pages) {
+        if (!page.isDirty)
+            continue;
+
+        // whatever frame is still sampling the old image keeps it until it's done.
+        DestroyPage(page, true);
+        UploadPage(page);
+
+        page.isDirty = false;
+    }
+}
+
+bool GlyphAtlas::Pack(Page &page, Uint32 width, Uint32 height, Uint32 &x, Uint32 &y) {
+    Shelf *bestShelf = nullptr;
+
+    // the shortest shelf it fits on wastes the least space.
+    for (Shelf &shelf : page.shelves) {
+        if (shelf.height < height || shelf.x + width > GLYPH_ATLAS_PAGE_SIZE)
+            continue;
+
+        if (!bestShelf || shelf.height < bestShelf->height)
+            bestShelf = &shelf;
+    }
+
+    if (!bestShelf) {
+        if (page.nextShelfY + height > GLYPH_ATLAS_PAGE_SIZE)
+            return false;
+
+        page.shelves.push_back({page.nextShelfY, height, 0});
+        page.nextShelfY += height;
+
+        bestShelf = &page.shelves.back();
+    }
+
+    x = bestShelf->x;
+    y = bestShelf->y;
+
+    bestShelf->x += width;
+
+    return true;
+}
+
+void GlyphAtlas::UploadPage(Page &page) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = GLYPH_ATLAS_PAGE_SIZE;
+    imageInfo.extent.height = GLYPH_ATLAS_PAGE_SIZE;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = m_Format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateImage(m_Device, &imageInfo, NULL, &page.image) != VK_SUCCESS)
+        throw std::runtime_error(engineError::IMAGE_CREATION_FAILURE);
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_Device, page.image, &memRequirements);
+
+    page.memory = m_Allocator->Allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+
+    vkBindImageMemory(m_Device, page.image, page.memory.deviceMemory, page.memory.offset);
+
+    page.uploadToken = m_UploadBatcher->UploadImage(page.image, page.pixels.data(), page.pixels.size(), GLYPH_ATLAS_PAGE_SIZE, GLYPH_ATLAS_PAGE_SIZE);
+
+    VkImageViewCreateInfo imageViewCreateInfo{};
+    imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    imageViewCreateInfo.image = page.image;
+    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    imageViewCreateInfo.format = m_Format;
+    imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    imageViewCreateInfo.subresourceRange.layerCount = 1;
+    imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+    imageViewCreateInfo.subresourceRange.levelCount = 1;
+
+    if (vkCreateImageView(m_Device, &imageViewCreateInfo, NULL, &page.imageView) != VK_SUCCESS)
+        throw std::runtime_error(engineError::IMAGE_VIEW_CREATION_FAILURE);
+}
+
+void GlyphAtlas::DestroyPage(Page &page, bool deferred) {
+    if (!page.image)
+        return;
+
+    if (deferred) {
+        m_DeletionQueue->DestroyImageView(page.imageView);
+        m_DeletionQueue->DestroyImage(page.image, page.memory, page.uploadToken);
+    } else {
+        vkDestroyImageView(m_Device, page.imageView, NULL);
+        vkDestroyImage(m_Device, page.image, NULL);
+        m_Allocator->Free(page.memory);
+    }
+
+    page.image = nullptr;
+    page.imageView = nullptr;
+    page.uploadToken = 0;
+}
@@ -0,0 +1,184 @@
+#include "gpuprofiler.hpp"
+#include "error.hpp"
+
+#include "fmt/core.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+GPUProfiler::GPUProfiler(VkDevice device, float timestampPeriod, Uint32 timestampValidBits, Uint32 frameCount, bool pipelineStatistics) : m_Device(device) {
+    m_FrameQueries.resize(frameCount);
+
+    m_NanosecondsPerTick = timestampPeriod;
+    m_TimestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+
+    // the queue can't write timestamps, stay disabled.
+    if (timestampValidBits == 0)
+        return;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo{};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = frameCount * GPU_PROFILER_MAX_SCOPES * 2;
+
+    if (vkCreateQueryPool(m_Device, &queryPoolCreateInfo, NULL, &m_TimestampPool) != VK_SUCCESS)
+        throw std::runtime_error(engineError::QUERY_POOL_CREATION_FAILURE);
+
+    if (!pipelineStatistics)
+        return;
+
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolCreateInfo.queryCount = frameCount * GPU_PROFILER_MAX_SCOPES;
+    queryPoolCreateInfo.pipelineStatistics = GPU_PROFILER_STATISTIC_FLAGS;
+
+    if (vkCreateQueryPool(m_Device, &queryPoolCreateInfo, NULL, &m_StatisticsPool) != VK_SUCCESS)
+        throw std::runtime_error(engineError::QUERY_POOL_CREATION_FAILURE);
+}
+
+GPUProfiler::~GPUProfiler() {
+    if (m_TimestampPool)
+        vkDestroyQueryPool(m_Device, m_TimestampPool, NULL);
+    if (m_StatisticsPool)
+        vkDestroyQueryPool(m_Device, m_StatisticsPool, NULL);
+}
+
+void GPUProfiler::BeginFrame(VkCommandBuffer commandBuffer, Uint32 frameIndex) {
+    m_FrameIndex = frameIndex;
+
+    if (!IsEnabled())
+        return;
+
+    CollectResults(frameIndex);
+
+    m_FrameQueries[frameIndex] = FrameQueries{};
+
+    vkCmdResetQueryPool(commandBuffer, m_TimestampPool, GetTimestampQuery(frameIndex, 0), GPU_PROFILER_MAX_SCOPES * 2);
+
+    if (m_StatisticsPool)
+        vkCmdResetQueryPool(commandBuffer, m_StatisticsPool, GetStatisticsQuery(frameIndex, 0), GPU_PROFILER_MAX_SCOPES);
+}
+
+Uint32 GPUProfiler::GetScope(const std::string &name) {
+    for (Uint32 i = 0; i < m_Scopes.size(); i++)
+        if (m_Scopes[i].name == name)
+            return i;
+
+    if (m_Scopes.size() == GPU_PROFILER_MAX_SCOPES)
+        return GPU_PROFILER_NO_SCOPE;
+
+    m_Scopes.emplace_back();
+    m_Scopes.back().name = name;
+
+    return m_Scopes.size() - 1;
+}
+
+void GPUProfiler::WriteBeginTimestamp(VkCommandBuffer commandBuffer, Uint32 scope) {
+    if (!IsEnabled() || scope == GPU_PROFILER_NO_SCOPE)
+        return;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_TimestampPool, GetTimestampQuery(m_FrameIndex, scope));
+
+    m_FrameQueries[m_FrameIndex].beginWritten[scope] = true;
+}
+
+void GPUProfiler::WriteEndTimestamp(VkCommandBuffer commandBuffer, Uint32 scope) {
+    if (!IsEnabled() || scope == GPU_PROFILER_NO_SCOPE)
+        return;
+
+    // only written once everything before it is done.
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_TimestampPool, GetTimestampQuery(m_FrameIndex, scope) + 1);
+
+    m_FrameQueries[m_FrameIndex].endWritten[scope] = true;
+}
+
+void GPUProfiler::BeginStatistics(VkCommandBuffer commandBuffer, Uint32 scope) {
+    if (!m_StatisticsPool || scope == GPU_PROFILER_NO_SCOPE)
+        return;
+
+    vkCmdBeginQuery(commandBuffer, m_StatisticsPool, GetStatisticsQuery(m_FrameIndex, scope), 0);
+}
+
+void GPUProfiler::EndStatistics(VkCommandBuffer commandBuffer, Uint32 scope) {
+    if (!m_StatisticsPool || scope == GPU_PROFILER_NO_SCOPE)
+        return;
+
+    vkCmdEndQuery(commandBuffer, m_StatisticsPool, GetStatisticsQuery(m_FrameIndex, scope));
+
+    m_FrameQueries[m_FrameIndex].statisticsWritten[scope] = true;
+}
+
+void GPUProfiler::CollectResults(Uint32 frameIndex) {
+    FrameQueries &frameQueries = m_FrameQueries[frameIndex];
+
+    for (Uint32 scopeIndex = 0; scopeIndex < m_Scopes.size(); scopeIndex++) {
+        Scope &scope = m_Scopes[scopeIndex];
+
+        if (frameQueries.beginWritten[scopeIndex] && frameQueries.endWritten[scopeIndex]) {
+            // begin, availability, end, availability.
+            std::array<Uint64, 4> timestamps{};
+
+            // no WAIT bit, the frame's fence was already waited on, anything that isn't available yet is skipped instead of stalled on.
+            VkResult result = vkGetQueryPoolResults(m_Device, m_TimestampPool, GetTimestampQuery(frameIndex, scopeIndex), 2, sizeof(timestamps), timestamps.data(), sizeof(Uint64) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+            if ((result == VK_SUCCESS || result == VK_NOT_READY) && timestamps[1] && timestamps[3]) {
+                Uint64 ticks = ((timestamps[2] & m_TimestampMask) - (timestamps[0] & m_TimestampMask)) & m_TimestampMask;
+
+                scope.milliseconds[scope.nextSample] = ticks * m_NanosecondsPerTick / 1000000.0;
+                scope.nextSample = (scope.nextSample + 1) % GPU_PROFILER_HISTORY;
+                scope.sampleCount = std::min<Uint32>(scope.sampleCount + 1, GPU_PROFILER_HISTORY);
+            }
+        }
+
+        if (frameQueries.statisticsWritten[scopeIndex]) {
+            std::array<Uint64, GPU_PROFILER_STATISTIC_COUNT + 1> statistics{};
+
+            VkResult result = vkGetQueryPoolResults(m_Device, m_StatisticsPool, GetStatisticsQuery(frameIndex, scopeIndex), 1, sizeof(statistics), statistics.data(), sizeof(statistics), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+            if ((result == VK_SUCCESS || result == VK_NOT_READY) && statistics[GPU_PROFILER_STATISTIC_COUNT]) {
+                for (Uint32 i = 0; i < GPU_PROFILER_STATISTIC_COUNT; i++)
+                    scope.statistics[scope.nextStatisticsSample][i] = statistics[i];
+
+                scope.nextStatisticsSample = (scope.nextStatisticsSample + 1) % GPU_PROFILER_HISTORY;
+                scope.statisticsSampleCount = std::min<Uint32>(scope.statisticsSampleCount + 1, GPU_PROFILER_HISTORY);
+            }
+        }
+    }
+}
+
+std::vector<GPUProfilerResult> GPUProfiler::GetResults() {
+    std::vector<GPUProfilerResult> results;
+
+    for (Scope &scope : m_Scopes) {
+        if (scope.sampleCount == 0)
+            continue;
+
+        GPUProfilerResult result{};
+        result.name = scope.name;
+
+        for (Uint32 i = 0; i < scope.sampleCount; i++)
+            result.averageMilliseconds += scope.milliseconds[i];
+        result.averageMilliseconds /= scope.sampleCount;
+
+        result.lastMilliseconds = scope.milliseconds[(scope.nextSample + GPU_PROFILER_HISTORY - 1) % GPU_PROFILER_HISTORY];
+
+        result.hasStatistics = scope.statisticsSampleCount > 0;
+
+        for (Uint32 i = 0; i < scope.statisticsSampleCount; i++)
+            for (Uint32 j = 0; j < GPU_PROFILER_STATISTIC_COUNT; j++)
+                result.statistics[j] += scope.statistics[i][j] / scope.statisticsSampleCount;
+
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+void GPUProfiler::PrintResults() {
+    for (GPUProfilerResult &result : GetResults()) {
+        fmt::println("GPU {}: {:.3f}ms (last {:.3f}ms)", result.name, result.averageMilliseconds, result.lastMilliseconds);
+
+        if (result.hasStatistics)
+            fmt::println("    vertices: {:.0f}, primitives: {:.0f}, vertex invocations: {:.0f}, clipped primitives: {:.0f}, fragment invocations: {:.0f}",
+                            result.statistics[0], result.statistics[1], result.statistics[2], result.statistics[3], result.statistics[4]);
+    }
+}
@@ -0,0 +1,134 @@
+#include "imagewriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <vector>
+
+/* The biggest a stored deflate block can be. */
+#define DEFLATE_MAX_STORED_BLOCK 65535
+
+static const std::array<Uint32, 256> crcTable = []{
+    std::array<Uint32, 256> table{};
+
+    for (Uint32 i = 0; i < 256; i++) {
+        Uint32 crc = i;
+
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+
+        table[i] = crc;
+    }
+
+    return table;
+}();
+
+static Uint32 updateCRC(Uint32 crc, const Uint8 *data, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+static void appendBigEndian(std::vector<Uint8> &out, Uint32 value) {
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static void writeChunk(std::ofstream &file, const char type[4], const std::vector<Uint8> &data) {
+    std::vector<Uint8> header;
+    appendBigEndian(header, data.size());
+    header.insert(header.end(), type, type + 4);
+
+    // the CRC covers the type and the data, not the length.
+    Uint32 crc = updateCRC(0xFFFFFFFFu, header.data() + 4, 4);
+    crc = updateCRC(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+
+    std::vector<Uint8> footer;
+    appendBigEndian(footer, crc);
+
+    file.write(reinterpret_cast<const char *>(header.data()), header.size());
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+    file.write(reinterpret_cast<const char *>(footer.data()), footer.size());
+}
+
+bool writePNG(const std::string &path, const Uint8 *pixels, Uint32 width, Uint32 height) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+        return false;
+
+    static const Uint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    std::vector<Uint8> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.push_back(8); // bit depth
+    header.push_back(6); // RGBA
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+
+    writeChunk(file, "IHDR", header);
+
+    // every row starts with its filter type, 0 = none.
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<Uint8> scanlines;
+    scanlines.reserve((rowSize + 1) * height);
+
+    for (Uint32 y = 0; y < height; y++) {
+        scanlines.push_back(0);
+        scanlines.insert(scanlines.end(), pixels + y * rowSize, pixels + (y + 1) * rowSize);
+    }
+
+    /* zlib stream: header, stored deflate blocks and the Adler-32 of the uncompressed data. */
+    std::vector<Uint8> imageData;
+    imageData.reserve(scanlines.size() + scanlines.size() / DEFLATE_MAX_STORED_BLOCK * 5 + 16);
+
+    // deflate with a 32K window, no preset dictionary, fastest.
+    imageData.push_back(0x78);
+    imageData.push_back(0x01);
+
+    size_t offset = 0;
+    do {
+        size_t blockSize = std::min<size_t>(scanlines.size() - offset, DEFLATE_MAX_STORED_BLOCK);
+        bool isFinal = offset + blockSize == scanlines.size();
+
+        imageData.push_back(isFinal ? 1 : 0);
+        imageData.push_back(blockSize & 0xFF);
+        imageData.push_back(blockSize >> 8);
+        imageData.push_back(~blockSize & 0xFF);
+        imageData.push_back((~blockSize >> 8) & 0xFF);
+
+        imageData.insert(imageData.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+
+        offset += blockSize;
+    } while (offset < scanlines.size());
+
+    Uint32 a = 1, b = 0;
+    for (Uint8 byte : scanlines) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    appendBigEndian(imageData, (b << 16) | a);
+
+    writeChunk(file, "IDAT", imageData);
+    writeChunk(file, "IEND", {});
+
+    return file.good();
+}
+
+bool writeRawImage(const std::string &path, const Uint8 *pixels, size_t size) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char *>(pixels), size);
+
+    return file.good();
+}
@@ -0,0 +1,369 @@
+#include "meshcache.hpp"
+#include "switch_fnv1a.h"
+
+#include "fmt/format.h"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+#define MESH_CACHE_MAGIC 0x48534D43 // "CMSH"
+
+static_assert(std::is_trivially_copyable<Vertex>::value, "Vertex is copied into the cache as raw bytes");
+static_assert(std::is_trivially_copyable<CookedCamera>::value, "CookedCamera is copied into the cache as raw bytes");
+
+struct MeshCacheHeader {
+    Uint32 magic;
+    Uint32 version;
+
+    Uint64 sourceHash;
+
+    Uint32 meshCount;
+    Uint32 nodeCount;
+};
+
+/* The least a mesh or a node takes up in the file, when all of its arrays and strings are empty and it has no camera or rigid body. */
+#define MINIMUM_COOKED_MESH_SIZE (sizeof(Uint32) * 3 + sizeof(CookedMesh::diffuse))
+#define MINIMUM_COOKED_NODE_SIZE (sizeof(CookedNode::parent) + sizeof(CookedNode::position) + sizeof(CookedNode::rotation) + sizeof(CookedNode::scale) + sizeof(Uint32) + sizeof(Uint8) * 2)
+
+/* A read-only mapping of a whole file, unmapped when it goes out of scope. */
+class MappedFile {
+public:
+    MappedFile(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+
+        if (fd < 0)
+            return;
+
+        struct stat fileStat;
+
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+            close(fd);
+            return;
+        }
+
+        void *data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        // the mapping stays valid after the descriptor is closed.
+        close(fd);
+
+        if (data == MAP_FAILED)
+            return;
+
+        m_Data = static_cast<const Uint8 *>(data);
+        m_Size = fileStat.st_size;
+    }
+
+    ~MappedFile() {
+        if (m_Data)
+            munmap(const_cast<Uint8 *>(m_Data), m_Size);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    inline const Uint8 *GetData() { return m_Data; };
+    inline size_t GetSize() { return m_Size; };
+private:
+    const Uint8 *m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+/* Walks a mapped cache file, every Read fails instead of going past the end. */
+class MeshCacheReader {
+public:
+    MeshCacheReader(const Uint8 *data, size_t size) : m_Data(data), m_Size(size) {}
+
+    template<typename T>
+    bool Read(T &value) {
+        if (m_Size - m_Offset < sizeof(T))
+            return false;
+
+        SDL_memcpy(&value, m_Data + m_Offset, sizeof(T));
+        m_Offset += sizeof(T);
+
+        return true;
+    }
+
+    template<typename T>
+    bool ReadArray(std::vector<T> &values) {
+        Uint32 count;
+
+        if (!Read(count) || (m_Size - m_Offset) / sizeof(T) < count)
+            return false;
+
+        // straight out of the mapping, no parsing per element.
+        values.resize(count);
+        SDL_memcpy(values.data(), m_Data + m_Offset, count * sizeof(T));
+        m_Offset += count * sizeof(T);
+
+        return true;
+    }
+
+    bool ReadString(std::string &value) {
+        Uint32 length;
+
+        if (!Read(length) || m_Size - m_Offset < length)
+            return false;
+
+        value.assign(reinterpret_cast<const char *>(m_Data + m_Offset), length);
+        m_Offset += length;
+
+        return true;
+    }
+
+    inline size_t GetRemainingSize() { return m_Size - m_Offset; };
+    inline bool IsAtEnd() { return m_Offset == m_Size; };
+private:
+    const Uint8 *m_Data;
+    size_t m_Size;
+    size_t m_Offset = 0;
+};
+
+class MeshCacheWriter {
+public:
+    template<typename T>
+    void Write(const T &value) {
+        const Uint8 *bytes = reinterpret_cast<const Uint8 *>(&value);
+
+        m_Data.insert(m_Data.end(), bytes, bytes + sizeof(T));
+    }
+
+    template<typename T>
+    void WriteArray(const std::vector<T> &values) {
+        const Uint8 *bytes = reinterpret_cast<const Uint8 *>(values.data());
+
+        Write(static_cast<Uint32>(values.size()));
+        m_Data.insert(m_Data.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void WriteString(const std::string &value) {
+        Write(static_cast<Uint32>(value.size()));
+        m_Data.insert(m_Data.end(), value.begin(), value.end());
+    }
+
+    inline const std::vector<Uint8> &GetData() { return m_Data; };
+private:
+    std::vector<Uint8> m_Data;
+};
+
+Uint64 hashFileContents(const std::string &path) {
+    MappedFile file(path);
+
+    if (!file.GetData())
+        return 0;
+
+    return fnv1a64::hash(reinterpret_cast<const char *>(file.GetData()), file.GetSize());
+}
+
+std::string getMeshCachePath(const std::string &cacheDirectory, const std::string &sourcePath) {
+    std::string absoluteSourcePath = std::filesystem::absolute(sourcePath).string();
+
+    return (std::filesystem::path(cacheDirectory) / fmt::format("{:016x}.mesh", fnv1a64::hash(absoluteSourcePath))).string();
+}
+
+/* The indices go straight into index buffers and bullet, one past the end would read out of bounds there. */
+static bool areIndicesInRange(const std::vector<Uint32> &indices, size_t vertexCount) {
+    for (Uint32 index : indices) {
+        if (index >= vertexCount)
+            return false;
+    }
+
+    return true;
+}
+
+bool readMeshCache(const std::string &cachePath, const std::string &sourcePath, Uint64 sourceHash, CookedScene &scene) {
+    MappedFile file(cachePath);
+
+    if (!file.GetData())
+        return false;
+
+    MeshCacheReader reader(file.GetData(), file.GetSize());
+    MeshCacheHeader header;
+    std::string cachedSourcePath;
+
+    if (!reader.Read(header) || header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.sourceHash != sourceHash)
+        return false;
+
+    // two paths could hash to the same file name.
+    if (!reader.ReadString(cachedSourcePath) || cachedSourcePath != std::filesystem::absolute(sourcePath).string())
+        return false;
+
+    Uint32 dependencyCount;
+
+    if (!reader.Read(dependencyCount))
+        return false;
+
+    for (Uint32 i = 0; i < dependencyCount; i++) {
+        MeshCacheDependency dependency;
+
+        if (!reader.ReadString(dependency.path) || !reader.Read(dependency.hash) || hashFileContents(dependency.path) != dependency.hash)
+            return false;
+    }
+
+    // the counts come from the file, a broken one shouldn't get to allocate more than the file could possibly hold.
+    if (reader.GetRemainingSize() / MINIMUM_COOKED_MESH_SIZE < header.meshCount)
+        return false;
+
+    scene.meshes.resize(header.meshCount);
+
+    for (CookedMesh &mesh : scene.meshes) {
+        if (!reader.ReadArray(mesh.vertices) || !reader.ReadArray(mesh.indices) || !reader.ReadString(mesh.diffuseMapPath) || !reader.Read(mesh.diffuse))
+            return false;
+
+        if (!areIndicesInRange(mesh.indices, mesh.vertices.size()))
+            return false;
+    }
+
+    if (reader.GetRemainingSize() / MINIMUM_COOKED_NODE_SIZE < header.nodeCount)
+        return false;
+
+    scene.nodes.resize(header.nodeCount);
+
+    for (Uint32 i = 0; i < header.nodeCount; i++) {
+        CookedNode &node = scene.nodes[i];
+        Uint8 hasCamera, hasRigidBody;
+
+        if (!reader.Read(node.parent) || !reader.Read(node.position) || !reader.Read(node.rotation) || !reader.Read(node.scale) || !reader.ReadArray(node.meshes))
+            return false;
+
+        // the root has to come first, and every other node after its parent.
+        if ((i == 0) != (node.parent == -1) || node.parent >= static_cast<Sint32>(i))
+            return false;
+
+        for (Uint32 mesh : node.meshes) {
+            if (mesh >= header.meshCount)
+                return false;
+        }
+
+        if (!reader.Read(hasCamera))
+            return false;
+
+        if (hasCamera) {
+            CookedCamera camera;
+
+            if (!reader.Read(camera))
+                return false;
+
+            node.camera = camera;
+        }
+
+        if (!reader.Read(hasRigidBody))
+            return false;
+
+        if (hasRigidBody) {
+            glTFRigidBody rigidBody;
+            glTFColliderInfo &colliderInfo = rigidBody.colliderInfo;
+
+            if (!reader.Read(rigidBody.mass) || !reader.Read(colliderInfo.shape) || !reader.Read(colliderInfo.boxSize) ||
+                !reader.ReadArray(colliderInfo.vertices) || !reader.ReadArray(colliderInfo.indices) || !reader.Read(colliderInfo.physicsMaterial))
+                return false;
+
+            // shape was read as a raw byte, it has to be one of the enum's values before anything switches on it.
+            if (colliderInfo.shape > GLTF_COLLIDER_TRIANGLE_MESH || !areIndicesInRange(colliderInfo.indices, colliderInfo.vertices.size()))
+                return false;
+
+            node.rigidBody = std::move(rigidBody);
+        }
+    }
+
+    return reader.IsAtEnd();
+}
+
+bool writeMeshCache(const std::string &cachePath, const std::string &sourcePath, Uint64 sourceHash, const std::vector<MeshCacheDependency> &dependencies, const CookedScene &scene) {
+    MeshCacheWriter writer;
+
+    writer.Write(MeshCacheHeader{MESH_CACHE_MAGIC, MESH_CACHE_VERSION, sourceHash, static_cast<Uint32>(scene.meshes.size()), static_cast<Uint32>(scene.nodes.size())});
+    writer.WriteString(std::filesystem::absolute(sourcePath).string());
+
+    writer.Write(static_cast<Uint32>(dependencies.size()));
+
+    for (const MeshCacheDependency &dependency : dependencies) {
+        writer.WriteString(dependency.path);
+        writer.Write(dependency.hash);
+    }
+
+    for (const CookedMesh &mesh : scene.meshes) {
+        writer.WriteArray(mesh.vertices);
+        writer.WriteArray(mesh.indices);
+        writer.WriteString(mesh.diffuseMapPath);
+        writer.Write(mesh.diffuse);
+    }
+
+    for (const CookedNode &node : scene.nodes) {
+        writer.Write(node.parent);
+        writer.Write(node.position);
+        writer.Write(node.rotation);
+        writer.Write(node.scale);
+        writer.WriteArray(node.meshes);
+
+        writer.Write(static_cast<Uint8>(node.camera.has_value()));
+
+        if (node.camera.has_value())
+            writer.Write(node.camera.value());
+
+        writer.Write(static_cast<Uint8>(node.rigidBody.has_value()));
+
+        if (node.rigidBody.has_value()) {
+            const glTFRigidBody &rigidBody = node.rigidBody.value();
+            const glTFColliderInfo &colliderInfo = rigidBody.colliderInfo;
+
+            writer.Write(rigidBody.mass);
+            writer.Write(colliderInfo.shape);
+            writer.Write(colliderInfo.boxSize);
+            writer.WriteArray(colliderInfo.vertices);
+            writer.WriteArray(colliderInfo.indices);
+            writer.Write(colliderInfo.physicsMaterial);
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::path parentDirectory = std::filesystem::path(cachePath).parent_path();
+
+    if (!parentDirectory.empty())
+        std::filesystem::create_directories(parentDirectory, errorCode);
+
+    // unique per writer, two threads (or two processes) cooking the same file would otherwise write into each other's temporary file.
+    std::string temporaryPath = cachePath + ".XXXXXX";
+
+    int fd = mkstemp(temporaryPath.data());
+
+    if (fd == -1)
+        return false;
+
+    // mkstemp makes it owner-only, the cache should be as readable as it was with a plain ofstream.
+    fchmod(fd, 0644);
+
+    const Uint8 *data = writer.GetData().data();
+    size_t remainingSize = writer.GetData().size();
+
+    while (remainingSize > 0) {
+        ssize_t writtenSize = write(fd, data, remainingSize);
+
+        if (writtenSize <= 0) {
+            close(fd);
+            unlink(temporaryPath.c_str());
+
+            return false;
+        }
+
+        data += writtenSize;
+        remainingSize -= writtenSize;
+    }
+
+    close(fd);
+
+    std::filesystem::rename(temporaryPath, cachePath, errorCode);
+
+    if (errorCode) {
+        unlink(temporaryPath.c_str());
+
+        return false;
+    }
+
+    return true;
+}
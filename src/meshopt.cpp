@@ -0,0 +1,369 @@
+#include "meshopt.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+/* Forsyth's constants, straight from the paper. */
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+/* Vertices with more triangles left than this all get the same (tiny) valence boost. */
+#define FORSYTH_MAX_VALENCE 64
+
+#define INVALID_INDEX 0xFFFFFFFF
+
+static float getVertexScore(Sint32 cachePosition, Uint32 remainingTriangles) {
+    // both parts only depend on small integers, no pow per vertex.
+    static const std::array<float, FORSYTH_CACHE_SIZE> cacheScores = [] {
+        std::array<float, FORSYTH_CACHE_SIZE> table;
+
+        for (Uint32 i = 0; i < table.size(); i++) {
+            // the last triangle's vertices get a fixed score, so it doesn't matter which order they were added in.
+            if (i < 3)
+                table[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+            else
+                table[i] = std::pow(1.0f - (i - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+        }
+
+        return table;
+    }();
+
+    static const std::array<float, FORSYTH_MAX_VALENCE + 1> valenceScores = [] {
+        std::array<float, FORSYTH_MAX_VALENCE + 1> table;
+
+        table[0] = 0.0f;
+
+        for (Uint32 i = 1; i < table.size(); i++)
+            table[i] = FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -FORSYTH_VALENCE_BOOST_POWER);
+
+        return table;
+    }();
+
+    // nothing left to draw with it, it shouldn't pull anything in.
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+
+    // vertices with few triangles left get finished off first, so they don't hang around.
+    return score + valenceScores[std::min(remainingTriangles, static_cast<Uint32>(FORSYTH_MAX_VALENCE))];
+}
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<Uint32> &indices, Uint32 vertexCount, Uint32 cacheSize) {
+    VertexCacheStatistics statistics;
+
+    // a vertex is still cached if fewer than cacheSize vertices were added after it.
+    std::vector<Uint32> timestamps(vertexCount, 0);
+    Uint32 time = cacheSize + 1;
+
+    std::vector<bool> isUsed(vertexCount, false);
+    Uint32 usedVertexCount = 0;
+
+    for (Uint32 index : indices) {
+        if (time - timestamps[index] > cacheSize) {
+            timestamps[index] = time++;
+            statistics.transformedVertexCount++;
+        }
+
+        if (!isUsed[index]) {
+            isUsed[index] = true;
+            usedVertexCount++;
+        }
+    }
+
+    if (indices.size() >= 3)
+        statistics.acmr = statistics.transformedVertexCount / static_cast<float>(indices.size() / 3);
+
+    if (usedVertexCount > 0)
+        statistics.atvr = statistics.transformedVertexCount / static_cast<float>(usedVertexCount);
+
+    return statistics;
+}
+
+void optimizeVertexCache(std::vector<Uint32> &indices, Uint32 vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount == 0)
+        return;
+
+    // every vertex's triangles, packed one vertex after the other. the ones still to be drawn are always first.
+    std::vector<Uint32> triangleOffsets(vertexCount + 1, 0);
+    std::vector<Uint32> remainingTriangles(vertexCount, 0);
+
+    for (Uint32 index : indices)
+        remainingTriangles[index]++;
+
+    for (Uint32 i = 0; i < vertexCount; i++)
+        triangleOffsets[i + 1] = triangleOffsets[i] + remainingTriangles[i];
+
+    std::vector<Uint32> adjacentTriangles(indices.size());
+    std::vector<Uint32> adjacentCounts(vertexCount, 0);
+
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        for (size_t corner = 0; corner < 3; corner++) {
+            Uint32 index = indices[triangle * 3 + corner];
+
+            adjacentTriangles[triangleOffsets[index] + adjacentCounts[index]++] = triangle;
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+
+    for (Uint32 i = 0; i < vertexCount; i++)
+        vertexScores[i] = getVertexScore(-1, remainingTriangles[i]);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> isEmitted(triangleCount, false);
+
+    Uint32 bestTriangle = 0;
+
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        const Uint32 *triangleIndices = &indices[triangle * 3];
+
+        triangleScores[triangle] = vertexScores[triangleIndices[0]] + vertexScores[triangleIndices[1]] + vertexScores[triangleIndices[2]];
+
+        if (triangleScores[triangle] > triangleScores[bestTriangle])
+            bestTriangle = triangle;
+    }
+
+    std::vector<Uint32> optimizedIndices;
+    optimizedIndices.reserve(indices.size());
+
+    // 3 extra slots for the vertices pushed out by the newest triangle.
+    std::vector<Uint32> cache, newCache, evictedVertices;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    size_t inputCursor = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+        // nothing in the cache has triangles left, so start over wherever the input is at. scanning everything for the best one would be quadratic.
+        if (bestTriangle == INVALID_INDEX) {
+            while (isEmitted[inputCursor])
+                inputCursor++;
+
+            bestTriangle = inputCursor;
+        }
+
+        const Uint32 *triangleIndices = &indices[bestTriangle * 3];
+
+        isEmitted[bestTriangle] = true;
+        optimizedIndices.insert(optimizedIndices.end(), triangleIndices, triangleIndices + 3);
+
+        newCache.clear();
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            Uint32 index = triangleIndices[corner];
+
+            // swap it behind the triangles still to be drawn. a degenerate triangle is in the list once for every corner, so it's always found.
+            Uint32 *triangles = &adjacentTriangles[triangleOffsets[index]];
+            Uint32 *triangle = std::find(triangles, triangles + remainingTriangles[index], bestTriangle);
+
+            std::swap(*triangle, triangles[remainingTriangles[index] - 1]);
+            remainingTriangles[index]--;
+
+            if (std::find(newCache.begin(), newCache.end(), index) == newCache.end())
+                newCache.push_back(index);
+        }
+
+        for (Uint32 index : cache) {
+            if (std::find(triangleIndices, triangleIndices + 3, index) == triangleIndices + 3)
+                newCache.push_back(index);
+        }
+
+        evictedVertices.clear();
+
+        for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+            vertexScores[newCache[i]] = getVertexScore(-1, remainingTriangles[newCache[i]]);
+
+            evictedVertices.push_back(newCache[i]);
+        }
+
+        newCache.resize(std::min(newCache.size(), static_cast<size_t>(FORSYTH_CACHE_SIZE)));
+        std::swap(cache, newCache);
+
+        for (size_t i = 0; i < cache.size(); i++) {
+            vertexScores[cache[i]] = getVertexScore(i, remainingTriangles[cache[i]]);
+        }
+
+        // only triangles touching the cache changed score, and only they can be the next best one.
+        bestTriangle = INVALID_INDEX;
+        float bestScore = -INFINITY;
+
+        for (const std::vector<Uint32> *vertices : {&cache, &evictedVertices}) {
+            for (Uint32 index : *vertices) {
+                for (Uint32 i = 0; i < remainingTriangles[index]; i++) {
+                    Uint32 triangle = adjacentTriangles[triangleOffsets[index] + i];
+                    const Uint32 *adjacentIndices = &indices[triangle * 3];
+
+                    triangleScores[triangle] = vertexScores[adjacentIndices[0]] + vertexScores[adjacentIndices[1]] + vertexScores[adjacentIndices[2]];
+
+                    if (vertices == &cache && triangleScores[triangle] > bestScore) {
+                        bestTriangle = triangle;
+                        bestScore = triangleScores[triangle];
+                    }
+                }
+            }
+        }
+    }
+
+    indices = std::move(optimizedIndices);
+}
+
+void optimizeOverdraw(std::vector<Uint32> &indices, const std::vector<glm::vec3> &positions, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+
+    if (triangleCount < 2)
+        return;
+
+    std::vector<Uint32> timestamps(positions.size(), 0);
+    Uint32 time = VERTEX_CACHE_FIFO_SIZE + 1;
+
+    // how many vertices a triangle transforms, with whatever the triangles right before it left in the cache.
+    auto countMisses = [&](size_t triangle) {
+        Uint32 misses = 0;
+
+        for (size_t corner = 0; corner < 3; corner++) {
+            Uint32 index = indices[triangle * 3 + corner];
+
+            if (time - timestamps[index] > VERTEX_CACHE_FIFO_SIZE) {
+                timestamps[index] = time++;
+                misses++;
+            }
+        }
+
+        return misses;
+    };
+
+    // a triangle missing on every vertex starts from scratch anyway, moving it around costs almost nothing.
+    std::vector<Uint32> hardStarts;
+
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        if (countMisses(triangle) == 3 || triangle == 0)
+            hardStarts.push_back(triangle);
+    }
+
+    hardStarts.push_back(triangleCount);
+
+    std::vector<Uint32> clusterStarts;
+
+    // big clusters get split too, wherever the triangles so far are already about as cache-friendly as the whole cluster.
+    // a cluster can end up after any other one, so every one of them is measured with an empty cache.
+    for (size_t i = 0; i + 1 < hardStarts.size(); i++) {
+        Uint32 start = hardStarts[i];
+        Uint32 end = hardStarts[i + 1];
+
+        time += VERTEX_CACHE_FIFO_SIZE + 1;
+
+        Uint32 clusterMisses = 0;
+
+        for (Uint32 triangle = start; triangle < end; triangle++)
+            clusterMisses += countMisses(triangle);
+
+        float clusterACMR = clusterMisses / static_cast<float>(end - start);
+
+        while (start < end) {
+            clusterStarts.push_back(start);
+
+            time += VERTEX_CACHE_FIFO_SIZE + 1;
+
+            Uint32 misses = 0;
+            Uint32 triangle = start;
+
+            // the first triangle is always 3 misses, the ones after it bring the average down.
+            for (; triangle + 1 < end; triangle++) {
+                misses += countMisses(triangle);
+
+                if (misses <= clusterACMR * threshold * (triangle - start + 1))
+                    break;
+            }
+
+            start = triangle + 1;
+        }
+    }
+
+    size_t clusterCount = clusterStarts.size();
+    clusterStarts.push_back(triangleCount);
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        float clusterArea = 0.0f;
+
+        for (Uint32 triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++) {
+            const glm::vec3 &a = positions[indices[triangle * 3 + 0]];
+            const glm::vec3 &b = positions[indices[triangle * 3 + 1]];
+            const glm::vec3 &c = positions[indices[triangle * 3 + 2]];
+
+            // twice the area, pointing out of the front face.
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float area = glm::length(normal);
+
+            clusterCentroids[cluster] += (a + b + c) * (area / 3.0f);
+            clusterNormals[cluster] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += clusterCentroids[cluster];
+        meshArea += clusterArea;
+
+        if (clusterArea > 0.0f)
+            clusterCentroids[cluster] = clusterCentroids[cluster] * (1.0f / clusterArea);
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid = meshCentroid * (1.0f / meshArea);
+
+    // clusters far out along their normal are likely to be in front of the rest of the mesh, from wherever it's looked at.
+    std::vector<float> sortKeys(clusterCount, 0.0f);
+
+    for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+        float normalLength = glm::length(clusterNormals[cluster]);
+
+        if (normalLength > 0.0f)
+            sortKeys[cluster] = glm::dot(clusterCentroids[cluster] - meshCentroid, clusterNormals[cluster]) / normalLength;
+    }
+
+    std::vector<Uint32> clusterOrder(clusterCount);
+
+    for (size_t cluster = 0; cluster < clusterCount; cluster++)
+        clusterOrder[cluster] = cluster;
+
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](Uint32 a, Uint32 b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<Uint32> sortedIndices;
+    sortedIndices.reserve(indices.size());
+
+    for (Uint32 cluster : clusterOrder)
+        sortedIndices.insert(sortedIndices.end(), indices.begin() + clusterStarts[cluster] * 3, indices.begin() + clusterStarts[cluster + 1] * 3);
+
+    // anything past the last whole triangle stays where it was.
+    sortedIndices.insert(sortedIndices.end(), indices.begin() + triangleCount * 3, indices.end());
+
+    indices = std::move(sortedIndices);
+}
+
+std::vector<Uint32> optimizeVertexFetch(std::vector<Uint32> &indices, Uint32 vertexCount) {
+    std::vector<Uint32> remap(vertexCount, INVALID_INDEX);
+    std::vector<Uint32> vertexOrder;
+
+    vertexOrder.reserve(vertexCount);
+
+    for (Uint32 &index : indices) {
+        if (remap[index] == INVALID_INDEX) {
+            remap[index] = vertexOrder.size();
+            vertexOrder.push_back(index);
+        }
+
+        index = remap[index];
+    }
+
+    return vertexOrder;
+}
@@ -23,9 +23,16 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
     //float roughness = 0.1;
     //float metallic = 0.0;
 
+    // the bounding box is about to grow.
+    m_IsWorldBoundingBoxValid = false;
+
+    // sized up front, nothing reallocates while converting.
+    vertices.resize(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
+
     for(size_t i = 0; i < mesh->mNumVertices; i++)
     {
-        Vertex vertex;
+        Vertex &vertex = vertices[i];
         // process vertex positions, normals and texture coordinates
         glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class.
         // positions
@@ -89,8 +96,6 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
         //     vertex.Tangent = glm::vec3(0.0f, 0.0f, 1.0f);
         //     vertex.BiTangent = vertex.Tangent * vertex.Normal;
         // }
-
-        vertices.push_back(vertex);
     }
     // process indices
     for(unsigned int i = 0; i < mesh->mNumFaces; i++)
@@ -127,7 +132,7 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene)
         // textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
     }
 
-    return Mesh(*this, vertices, indices, diffuseMap/*, shininess, roughness, metallic*/, diffuse);
+    return Mesh(*this, std::move(vertices), std::move(indices), diffuseMap/*, shininess, roughness, metallic*/, diffuse);
 }
 
 glm::mat4 Model::GetModelMatrix() {
@@ -147,6 +152,18 @@ glm::mat4 Model::GetModelMatrix() {
     return m_ModelMatrix;
 }
 
+std::array<glm::vec3, 2> Model::GetBoundingBox() {
+    glm::mat4 modelMatrix = GetModelMatrix();
+
+    if (!m_IsWorldBoundingBoxValid || modelMatrix != m_WorldBoundingBoxMatrix) {
+        m_WorldBoundingBox = transformBoundingBox(m_BoundingBox, modelMatrix);
+        m_WorldBoundingBoxMatrix = modelMatrix;
+        m_IsWorldBoundingBoxValid = true;
+    }
+
+    return m_WorldBoundingBox;
+}
+
 void Model::SetObjectAttachment(Object *object) {
     m_ObjectAttachment = object;
 }
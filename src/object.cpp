@@ -8,17 +8,24 @@
 #include "LinearMath/btTransform.h"
 #include "LinearMath/btVector3.h"
 #include "camera.hpp"
+#include "meshcache.hpp"
+#include "meshopt.hpp"
+#include "threadpool.hpp"
 #include "util.hpp"
 #include <SDL3/SDL_stdinc.h>
+#include <algorithm>
+#include <assimp/DefaultIOSystem.h>
 #include <assimp/Importer.hpp>
 #include <assimp/metadata.h>
 #include <assimp/quaternion.h>
 #include <assimp/scene.h>
 #include <assimp/types.h>
 #include <assimp/vector3.h>
+#include <filesystem>
 #include <functional>
 #include <glm/trigonometric.hpp>
 #include <memory>
+#include <set>
 #include "switch_fnv1a.h"
 
 Object::~Object() {
@@ -37,14 +44,13 @@ Object::~Object() {
 
 Object::Object(glm::vec3 position, glm::quat rotation, glm::vec3 scale, int objectID) {
     if (objectID == -1) {
-        HighestObjectID++;
-        SetObjectID(HighestObjectID);
+        SetObjectID(++HighestObjectID);
     } else {
         SetObjectID(objectID);
 
-        if (objectID > HighestObjectID) {
-            HighestObjectID = objectID;
-        }
+        // another thread might be raising it at the same time.
+        int highestObjectID = HighestObjectID;
+        while (objectID > highestObjectID && !HighestObjectID.compare_exchange_weak(highestObjectID, objectID));
     }
 
     SetPosition(position);
@@ -52,21 +58,206 @@ Object::Object(glm::vec3 position, glm::quat rotation, glm::vec3 scale, int obje
     SetScale(scale);
 }
 
-void Object::ImportFromFile(const std::string &path, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput) {
-    Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(path.data(), aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_ForceGenNormals | /*aiProcess_GenSmoothNormals |*/ aiProcess_FlipUVs/* | aiProcess_CalcTangentSpace*/);
+/* Remembers every file assimp tries to open, so the mesh cache can tell when one next to the source file (an .mtl, a .bin) changes. */
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+    Assimp::IOStream *Open(const char *file, const char *mode = "rb") override {
+        m_OpenedPaths.insert(std::filesystem::absolute(file).string());
+
+        return Assimp::DefaultIOSystem::Open(file, mode);
+    }
+
+    inline const std::set<std::string> &GetOpenedPaths() { return m_OpenedPaths; };
+private:
+    std::set<std::string> m_OpenedPaths;
+};
+
+/* What cookMesh's optimization did to a mesh, so the importing thread can print it. */
+struct MeshOptimizationStatistics {
+    bool isOptimized = false;
+
+    VertexCacheStatistics source;
+    VertexCacheStatistics optimized;
+};
+
+/* Copies a source file's mesh out of assimp, the temporary Model only exists because processMesh lives on it. */
+static CookedMesh cookMesh(aiMesh *sourceMesh, const aiScene *scene, MeshOptimizationStatistics &optimizationStatistics) {
+    Model model;
+    Mesh mesh = model.processMesh(sourceMesh, scene);
+
+    CookedMesh cookedMesh;
+    cookedMesh.indices = std::move(mesh.indices);
+    cookedMesh.diffuseMapPath = mesh.diffuseMapPath.string();
+    cookedMesh.diffuse = mesh.diffuse;
+
+    // assimp hands out triangles in whatever order the file had them, cooking only happens once so it's the place to fix that.
+    if (cookedMesh.indices.empty() || cookedMesh.indices.size() % 3 != 0) {
+        cookedMesh.vertices = std::move(mesh.vertices);
+
+        return cookedMesh;
+    }
+
+    Uint32 vertexCount = mesh.vertices.size();
+    optimizationStatistics.source = analyzeVertexCache(cookedMesh.indices, vertexCount);
+
+    std::vector<glm::vec3> positions(vertexCount);
+
+    for (Uint32 i = 0; i < vertexCount; i++)
+        positions[i] = mesh.vertices[i].Position;
+
+    optimizeVertexCache(cookedMesh.indices, vertexCount);
+    optimizeOverdraw(cookedMesh.indices, positions);
+
+    std::vector<Uint32> vertexOrder = optimizeVertexFetch(cookedMesh.indices, vertexCount);
+
+    cookedMesh.vertices.resize(vertexOrder.size());
+
+    for (size_t i = 0; i < vertexOrder.size(); i++)
+        cookedMesh.vertices[i] = mesh.vertices[vertexOrder[i]];
+
+    optimizationStatistics.optimized = analyzeVertexCache(cookedMesh.indices, cookedMesh.vertices.size());
+    optimizationStatistics.isOptimized = true;
+
+    return cookedMesh;
+}
+
+/* This function is recursive, nodes are added depth-first so their index matches the source ID ImportFromFile has always given them. */
+static void cookNode(aiNode *node, const aiScene *scene, Sint32 parent, CookedScene &cookedScene) {
+    Sint32 nodeIndex = cookedScene.nodes.size();
+    cookedScene.nodes.emplace_back();
+
+    CookedNode cookedNode;
+    cookedNode.parent = parent;
+
+    aiVector3D position;
+    aiQuaternion rotation;
+    aiVector3D scale;
+
+    node->mTransformation.Decompose(scale, rotation, position);
+
+    cookedNode.position = glm::vec3(position.x, position.y, position.z);
+    cookedNode.rotation = glm::quat(rotation.w, rotation.x, rotation.y, rotation.z);
+    cookedNode.scale = glm::vec3(scale.x, scale.y, scale.z);
+
+    aiMetadata extensionsData;
+
+    if (node->mMetaData && node->mMetaData->HasKey("extensions")) {
+        node->mMetaData->Get("extensions", extensionsData);
+    }
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        throw std::runtime_error(fmt::format("Couldn't load models from assimp: {}", importer.GetErrorString()));
+    if (extensionsData.HasKey("KHR_physics_rigid_bodies") && scene->mMetaData && scene->mMetaData->HasKey("extensions")) {
+        cookedNode.rigidBody = getColliderInfoFromNode(node, scene);
+    }
+
+    /* Check if this node is/has a camera. */
+    for (Uint32 i = 0; i < scene->mNumCameras; i++) {
+        /* Found the camera! */
+        if (scene->mCameras[i]->mName == node->mName) {
+            aiCamera *sceneCam = scene->mCameras[i];
+
+            UTILASSERT((sceneCam->mOrthographicWidth > 0 || sceneCam->mHorizontalFOV > 0) && !(sceneCam->mOrthographicWidth > 0 && sceneCam->mHorizontalFOV > 0));
+
+            aiVector3D direction = aiVector3D(-node->mTransformation.a3, -node->mTransformation.b3, -node->mTransformation.c3);
+            direction.Normalize();
+
+            CookedCamera camera{};
+            camera.aspect = sceneCam->mAspect;
+            camera.up = glm::vec3(sceneCam->mUp.x, sceneCam->mUp.y, sceneCam->mUp.z);
+            camera.pitch = glm::degrees(std::atan2(direction.x, direction.y));
+            camera.yaw = glm::degrees(std::asin(direction.z));
+            camera.isOrthographic = !(sceneCam->mHorizontalFOV > 0);
+            camera.FOV = glm::degrees(sceneCam->mHorizontalFOV);
+            camera.orthographicWidth = sceneCam->mOrthographicWidth;
+
+            cookedNode.camera = camera;
+
+            break;
+        }
+    }
+
+    cookedNode.meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+    cookedScene.nodes[nodeIndex] = std::move(cookedNode);
+
+    for (Uint32 i = 0; i < node->mNumChildren; i++) {
+        cookNode(node->mChildren[i], scene, nodeIndex, cookedScene);
+    }
+}
+
+void Object::ImportFromFile(const std::string &path, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput, const std::string &cacheDirectory, bool quantizeVertices, bool verbose) {
+    CookedScene cookedScene;
+    std::string cachePath;
+    Uint64 sourceHash = 0;
+    bool isCached = false;
+
+    if (!cacheDirectory.empty()) {
+        sourceHash = hashFileContents(path);
+        cachePath = getMeshCachePath(cacheDirectory, path);
+
+        isCached = readMeshCache(cachePath, path, sourceHash, cookedScene);
+    }
+
+    if (!isCached) {
+        Assimp::Importer importer;
+
+        // the importer deletes it.
+        RecordingIOSystem *ioSystem = new RecordingIOSystem();
+        importer.SetIOHandler(ioSystem);
+
+        const aiScene *scene = importer.ReadFile(path.data(), aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_ForceGenNormals | /*aiProcess_GenSmoothNormals |*/ aiProcess_FlipUVs/* | aiProcess_CalcTangentSpace*/);
+
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            throw std::runtime_error(fmt::format("Couldn't load models from assimp: {}", importer.GetErrorString()));
+        }
+
+        std::vector<MeshCacheDependency> dependencies;
+
+        if (!cacheDirectory.empty()) {
+            std::string absoluteSourcePath = std::filesystem::absolute(path).string();
+
+            // the source file itself is already covered by sourceHash.
+            for (const std::string &openedPath : ioSystem->GetOpenedPaths()) {
+                if (openedPath != absoluteSourcePath)
+                    dependencies.push_back({openedPath, hashFileContents(openedPath)});
+            }
+        }
+
+        cookedScene = CookedScene{};
+        cookedScene.meshes.resize(scene->mNumMeshes);
+
+        // meshes don't depend on each other and assimp is done writing to the scene, every mesh goes to its own slot.
+        // a single mesh gets a pool of 1, which doesn't start any threads.
+        ThreadPool threadPool(std::clamp(std::thread::hardware_concurrency(), 1u, std::max(scene->mNumMeshes, 1u)));
+
+        std::vector<MeshOptimizationStatistics> optimizationStatistics(scene->mNumMeshes);
+
+        threadPool.Dispatch(scene->mNumMeshes, [&](Uint32 threadIndex, Uint32 meshIndex) {
+            cookedScene.meshes[meshIndex] = cookMesh(scene->mMeshes[meshIndex], scene, optimizationStatistics[meshIndex]);
+        });
+
+        if (verbose) {
+            for (Uint32 i = 0; i < scene->mNumMeshes; i++) {
+                const MeshOptimizationStatistics &statistics = optimizationStatistics[i];
+
+                if (statistics.isOptimized)
+                    fmt::println("Optimized mesh {} ({} triangles): ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", scene->mMeshes[i]->mName.C_Str(), cookedScene.meshes[i].indices.size() / 3,
+                                 statistics.source.acmr, statistics.optimized.acmr, statistics.source.atvr, statistics.optimized.atvr);
+            }
+        }
+
+        cookNode(scene->mRootNode, scene, -1, cookedScene);
+
+        // a file we couldn't hash can't be checked for changes later, don't cache it.
+        if (!cacheDirectory.empty() && sourceHash != 0 && !writeMeshCache(cachePath, path, sourceHash, dependencies, cookedScene)) {
+            fmt::println("WARN: Failed to save the mesh cache for {} to {}!", path, cachePath);
+        }
     }
 
     m_SourceFile = path;
     m_GeneratedFromFile = true;
     m_SourceID = 0;
 
-    int sourceID = 0;
-
-    ProcessNode(scene->mRootNode, scene, sourceID, nullptr, primaryCamOutput);
+    BuildFromCookedScene(cookedScene, primaryCamOutput, quantizeVertices);
 }
 
 std::string Object::GetSourceFile() {
@@ -105,87 +296,67 @@ void Object::DeleteRigidbody() {
     m_RigidBody.reset();
 }
 
-/* if parent is nullptr, that must mean this is the rootNode. */
-void Object::ProcessNode(aiNode *node, const aiScene *scene, int &sourceID, Object *parent, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput) {
-    fmt::println("Processing node!");
+void Object::BuildFromCookedScene(const CookedScene &scene, std::optional<std::reference_wrapper<Camera *>> primaryCamOutput, bool quantizeVertices) {
+    std::vector<Object *> objects(scene.nodes.size());
 
-    Object *obj = this;
-    
-    if (node != scene->mRootNode) {
-        obj = new Object();
+    for (size_t sourceID = 0; sourceID < scene.nodes.size(); sourceID++) {
+        const CookedNode &node = scene.nodes[sourceID];
+        Object *obj = this;
 
-        obj->SetParent(parent);
+        if (node.parent != -1) {
+            obj = new Object();
 
-        obj->SetIsGeneratedFromFile(true);
+            obj->SetParent(objects[node.parent]);
 
-        obj->SetSourceID(sourceID);
+            obj->SetIsGeneratedFromFile(true);
 
-        fmt::println("Node {} is a child to {} object.", fmt::ptr(node), fmt::ptr(parent));
-    }
+            obj->SetSourceID(sourceID);
+        }
 
-    fmt::println("Node {} is represented by Object {}.", fmt::ptr(node), fmt::ptr(obj));
+        objects[sourceID] = obj;
 
-    aiVector3D position;
-    aiQuaternion rotation;
-    aiVector3D scale;
+        obj->SetPosition(glm::vec3(node.position.x, node.position.z, node.position.y));
+        obj->SetRotation(node.rotation);
+        obj->SetScale(node.scale);
 
-    node->mTransformation.Decompose(scale, rotation, position);
+        if (node.rigidBody.has_value()) {
+            const glTFRigidBody &rigidBody = node.rigidBody.value();
+            const glTFColliderInfo &colliderInfo = rigidBody.colliderInfo;
 
-    obj->SetPosition(glm::vec3(position.x, position.z, position.y));
-    obj->SetRotation(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
-    obj->SetScale(glm::vec3(scale.x, scale.y, scale.z));
+            btCollisionShape *shape = createColliderShape(colliderInfo);
 
-    aiMetadata extensionsData;
+            if (shape) {
+                btVector3 localInertia(0, 0, 0);
+                if (rigidBody.mass != 0.0f) {
+                    /* TODO: looks like there's some more inertia information in `KHR_physics_rigid_bodies/motion`, Consider using that. */
+                    shape->calculateLocalInertia(rigidBody.mass, localInertia);
+                }
 
-    if (node->mMetaData && node->mMetaData->HasKey("extensions")) {
-        node->mMetaData->Get("extensions", extensionsData);
-    }
+                btTransform transform;
+                transform.setIdentity();
+                transform.setOrigin(btVector3(node.position.x, node.position.y, node.position.z));
+                transform.setRotation(btQuaternion(node.rotation.x, node.rotation.y, node.rotation.z, node.rotation.w));
 
-    if (extensionsData.HasKey("KHR_physics_rigid_bodies") && scene->mMetaData && scene->mMetaData->HasKey("extensions")) {
-        struct glTFRigidBody rigidBody = getColliderInfoFromNode(node, scene);
-        struct glTFColliderInfo &colliderInfo = rigidBody.colliderInfo;
+                btRigidBody::btRigidBodyConstructionInfo cInfo{static_cast<btScalar>(rigidBody.mass), new btDefaultMotionState(transform), shape, localInertia};
+                obj->CreateRigidbody(cInfo);
 
-        btVector3 localInertia(0, 0, 0);
-        if (rigidBody.mass != 0.0f) {
-            /* TODO: looks like there's some more inertia information in `KHR_physics_rigid_bodies/motion`, Consider using that. */
-            colliderInfo.shape->calculateLocalInertia(rigidBody.mass, localInertia);    
+                obj->GetRigidBody()->setFriction(colliderInfo.physicsMaterial.staticFriction);
+                obj->GetRigidBody()->setRollingFriction(colliderInfo.physicsMaterial.dynamicFriction);
+                obj->GetRigidBody()->setSpinningFriction(colliderInfo.physicsMaterial.dynamicFriction);
+                obj->GetRigidBody()->setRestitution(colliderInfo.physicsMaterial.restitution);
+            }
         }
 
-        btTransform transform;
-        transform.setIdentity();
-        transform.setOrigin(btVector3(position.x, position.y, position.z));
-        transform.setRotation(btQuaternion(rotation.x, rotation.y, rotation.z, rotation.w));
-
-        btRigidBody::btRigidBodyConstructionInfo cInfo{static_cast<btScalar>(rigidBody.mass), new btDefaultMotionState(transform), colliderInfo.shape, localInertia};
-        obj->CreateRigidbody(cInfo);
-
-        obj->GetRigidBody()->setFriction(colliderInfo.physicsMaterial.staticFriction);
-        obj->GetRigidBody()->setRollingFriction(colliderInfo.physicsMaterial.dynamicFriction);
-        obj->GetRigidBody()->setSpinningFriction(colliderInfo.physicsMaterial.dynamicFriction);
-        obj->GetRigidBody()->setRestitution(colliderInfo.physicsMaterial.restitution);
-    }
-
-    /* Check if this node is/has a camera. */
-    for (Uint32 i = 0; i < scene->mNumCameras; i++) {
-        /* Found the camera! */
-        if (scene->mCameras[i]->mName == node->mName) {
-            aiCamera *sceneCam = scene->mCameras[i];
-
-            UTILASSERT((sceneCam->mOrthographicWidth > 0 || sceneCam->mHorizontalFOV > 0) && !(sceneCam->mOrthographicWidth > 0 && sceneCam->mHorizontalFOV > 0));
-
-            aiVector3D direction = aiVector3D(-node->mTransformation.a3, -node->mTransformation.b3, -node->mTransformation.c3);
-            direction.Normalize();
-
-            float pitch = glm::degrees(std::atan2(direction.x, direction.y));
-            float yaw = glm::degrees(std::asin(direction.z));
+        if (node.camera.has_value()) {
+            const CookedCamera &camera = node.camera.value();
 
-            Camera *cam = new Camera(sceneCam->mAspect, glm::vec3(sceneCam->mUp.x, sceneCam->mUp.y, sceneCam->mUp.z), yaw, pitch);
+            Camera *cam = new Camera(camera.aspect, camera.up, camera.yaw, camera.pitch);
 
-            if (sceneCam->mHorizontalFOV > 0) {
-                cam->FOV = glm::degrees(sceneCam->mHorizontalFOV);
+            if (!camera.isOrthographic) {
+                cam->FOV = camera.FOV;
             } else {
                 cam->type = CAMERA_ORTHOGRAPHIC;
-                cam->OrthographicWidth = sceneCam->mOrthographicWidth;
+                cam->OrthographicWidth = camera.orthographicWidth;
             }
 
             obj->SetCameraAttachment(cam);
@@ -193,28 +364,31 @@ void Object::ProcessNode(aiNode *node, const aiScene *scene, int &sourceID, Obje
             if (primaryCamOutput.has_value() && primaryCamOutput.value().get() == nullptr) {
                 primaryCamOutput.value().get() = cam;
             }
-
-            break;
         }
-    }
 
-    if (node->mNumMeshes > 0) {
-        Model *model = new Model();
+        if (!node.meshes.empty()) {
+            Model *model = new Model();
+            std::array<glm::vec3, 2> boundingBox = model->GetRawBoundingBox();
 
-        fmt::println("Object {} has atleast 1 mesh!", fmt::ptr(obj));
+            for (Uint32 meshIndex : node.meshes) {
+                const CookedMesh &cookedMesh = scene.meshes[meshIndex];
 
-        for (Uint32 i = 0; i < node->mNumMeshes; i++) {
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+                model->meshes.push_back(Mesh(*model, cookedMesh.vertices, cookedMesh.indices, cookedMesh.diffuseMapPath, cookedMesh.diffuse));
 
-            model->meshes.push_back(model->processMesh(mesh, scene));
-        }
+                // BuildFromCookedScene always runs on the object that ImportFromFile was called on.
+                model->meshes.back().sourceFile = m_SourceFile;
+                model->meshes.back().sourceMeshIndex = meshIndex;
+                model->meshes.back().isQuantized = quantizeVertices;
 
-        obj->AddModelAttachment(model);
-    }
+                std::array<glm::vec3, 2> meshBoundingBox = model->meshes.back().GetRawBoundingBox();
+                boundingBox[0] = glm::max(boundingBox[0], meshBoundingBox[0]);
+                boundingBox[1] = glm::min(boundingBox[1], meshBoundingBox[1]);
+            }
 
-    for (Uint32 i = 0; i < node->mNumChildren; i++) {
-        sourceID++;
-        ProcessNode(node->mChildren[i], scene, sourceID, obj, primaryCamOutput);
+            model->SetBoundingBox(boundingBox);
+
+            obj->AddModelAttachment(model);
+        }
     }
 }
 
@@ -353,4 +527,4 @@ void Object::SetObjectID(int objectID) {
     m_ObjectID = objectID;
 }
 
-int Object::HighestObjectID = -1;
\ No newline at end of file
+std::atomic<int> Object::HighestObjectID{-1};
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "recorder.hpp"
+#include "error.hpp"
+
+#include <stdexcept>
+
+SecondaryCommandRecorder::SecondaryCommandRecorder(VkDevice device, Uint32 queueFamily, Uint32 threadCount, Uint32 frameCount) : m_Device(device) {
+    m_Threads.resize(threadCount);
+
+    for (ThreadContext &thread : m_Threads) {
+        thread.commandPools.resize(frameCount, nullptr);
+        thread.commandBuffers.resize(frameCount);
+        thread.usedCommandBuffers.resize(frameCount, 0);
+
+        for (VkCommandPool &commandPool : thread.commandPools) {
+            // buffers are only ever reset through their pool.
+            VkCommandPoolCreateInfo commandPoolCreateInfo{};
+            commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            commandPoolCreateInfo.queueFamilyIndex = queueFamily;
+
+            if (vkCreateCommandPool(m_Device, &commandPoolCreateInfo, NULL, &commandPool) != VK_SUCCESS)
+                throw std::runtime_error(engineError::COMMAND_POOL_CREATION_FAILURE);
+        }
+    }
+}
+
+SecondaryCommandRecorder::~SecondaryCommandRecorder() {
+    // destroying the pool frees its buffers too.
+    for (ThreadContext &thread : m_Threads)
+        for (VkCommandPool commandPool : thread.commandPools)
+            if (commandPool)
+                vkDestroyCommandPool(m_Device, commandPool, NULL);
+}
+
+void SecondaryCommandRecorder::BeginFrame(Uint32 frameIndex) {
+    m_FrameIndex = frameIndex;
+
+    for (ThreadContext &thread : m_Threads) {
+        if (thread.usedCommandBuffers[frameIndex] > 0)
+            vkResetCommandPool(m_Device, thread.commandPools[frameIndex], 0);
+
+        thread.usedCommandBuffers[frameIndex] = 0;
+        thread.stateTracker.ResetStatistics();
+    }
+}
+
+VkCommandBuffer SecondaryCommandRecorder::Begin(Uint32 threadIndex, VkRenderPass renderPass, Uint32 subpass, VkFramebuffer framebuffer) {
+    ThreadContext &thread = m_Threads[threadIndex];
+
+    std::vector<VkCommandBuffer> &commandBuffers = thread.commandBuffers[m_FrameIndex];
+    Uint32 &usedCommandBuffers = thread.usedCommandBuffers[m_FrameIndex];
+
+    if (usedCommandBuffers == commandBuffers.size()) {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo{};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+        commandBufferAllocateInfo.commandPool = thread.commandPools[m_FrameIndex];
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        VkCommandBuffer commandBuffer;
+
+        if (vkAllocateCommandBuffers(m_Device, &commandBufferAllocateInfo, &commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_BUFFER_ALLOCATION_FAILURE);
+
+        commandBuffers.push_back(commandBuffer);
+    }
+
+    VkCommandBuffer commandBuffer = commandBuffers[usedCommandBuffers++];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = subpass;
+    inheritanceInfo.framebuffer = framebuffer;
+    inheritanceInfo.pipelineStatistics = m_InheritedPipelineStatistics;
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo{};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+        throw std::runtime_error(engineError::COMMAND_BUFFER_BEGIN_FAILURE);
+
+    // nothing is inherited from the primary buffer, not even the pipeline.
+    thread.stateTracker.Reset(commandBuffer);
+
+    return commandBuffer;
+}
+
+void SecondaryCommandRecorder::End(VkCommandBuffer commandBuffer) {
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error(engineError::COMMAND_BUFFER_END_FAILURE);
+}
+
+Uint32 SecondaryCommandRecorder::GetBindCount() {
+    Uint32 bindCount = 0;
+
+    for (ThreadContext &thread : m_Threads)
+        bindCount += thread.stateTracker.GetBindCount();
+
+    return bindCount;
+}
+
+Uint32 SecondaryCommandRecorder::GetSkippedBindCount() {
+    Uint32 skippedBindCount = 0;
+
+    for (ThreadContext &thread : m_Threads)
+        skippedBindCount += thread.stateTracker.GetSkippedBindCount();
+
+    return skippedBindCount;
+}
@@ -0,0 +1,122 @@
+#include "sdf.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/* Stands in for "no edge anywhere near", squared distances never get close. */
+#define SDF_INFINITY 1e20
+
+/* Felzenszwalb and Huttenlocher's 1D squared distance transform over n values stride apart, in place.
+ * The other three are scratch space, at least n (and n + 1 for boundaries) long. */
+static void distanceTransform1D(double *grid, Uint32 n, Uint32 stride, std::vector<double> &values, std::vector<Uint32> &parabolas, std::vector<double> &boundaries) {
+    for (Uint32 q = 0; q < n; q++)
+        values[q] = grid[q * stride];
+
+    // lower envelope of the parabolas rooted at every value.
+    Uint32 k = 0;
+    parabolas[0] = 0;
+    boundaries[0] = -SDF_INFINITY;
+    boundaries[1] = SDF_INFINITY;
+
+    for (Uint32 q = 1; q < n; q++) {
+        double s;
+
+        while (true) {
+            Uint32 r = parabolas[k];
+            s = ((values[q] + static_cast<double>(q) * q) - (values[r] + static_cast<double>(r) * r)) / (2.0 * q - 2.0 * r);
+
+            if (s > boundaries[k] || k == 0)
+                break;
+
+            k--;
+        }
+
+        k++;
+        parabolas[k] = q;
+        boundaries[k] = s;
+        boundaries[k + 1] = SDF_INFINITY;
+    }
+
+    k = 0;
+    for (Uint32 q = 0; q < n; q++) {
+        while (boundaries[k + 1] < q)
+            k++;
+
+        double offset = static_cast<double>(q) - parabolas[k];
+        grid[q * stride] = offset * offset + values[parabolas[k]];
+    }
+}
+
+static void distanceTransform2D(std::vector<double> &grid, Uint32 width, Uint32 height) {
+    Uint32 longestSide = std::max(width, height);
+
+    std::vector<double> values(longestSide);
+    std::vector<Uint32> parabolas(longestSide);
+    std::vector<double> boundaries(longestSide + 1);
+
+    for (Uint32 x = 0; x < width; x++)
+        distanceTransform1D(grid.data() + x, height, width, values, parabolas, boundaries);
+
+    for (Uint32 y = 0; y < height; y++)
+        distanceTransform1D(grid.data() + y * width, width, 1, values, parabolas, boundaries);
+}
+
+std::vector<Uint8> generateSignedDistanceField(const Uint8 *coverage, Uint32 width, Uint32 height, Sint32 pitch, Uint32 spread, Uint32 oversample, Uint32 &fieldWidth, Uint32 &fieldHeight) {
+    fieldWidth = (width + oversample - 1) / oversample + spread * 2;
+    fieldHeight = (height + oversample - 1) / oversample + spread * 2;
+
+    Uint32 gridWidth = fieldWidth * oversample;
+    Uint32 gridHeight = fieldHeight * oversample;
+    Uint32 border = spread * oversample;
+
+    // squared distance to the nearest inside texel, and to the nearest outside texel.
+    std::vector<double> outside(gridWidth * gridHeight, SDF_INFINITY);
+    std::vector<double> inside(gridWidth * gridHeight, 0.0);
+
+    for (Uint32 y = 0; y < height; y++) {
+        // a negative pitch means the rows are stored bottom-up.
+        const Uint8 *row = coverage + (pitch >= 0 ? y * pitch : (height - 1 - y) * -pitch);
+
+        for (Uint32 x = 0; x < width; x++) {
+            if (row[x] < 128)
+                continue;
+
+            Uint32 index = (y + border) * gridWidth + x + border;
+
+            outside[index] = 0.0;
+            inside[index] = SDF_INFINITY;
+        }
+    }
+
+    distanceTransform2D(outside, gridWidth, gridHeight);
+    distanceTransform2D(inside, gridWidth, gridHeight);
+
+    std::vector<Uint8> field(fieldWidth * fieldHeight);
+
+    for (Uint32 fieldY = 0; fieldY < fieldHeight; fieldY++) {
+        for (Uint32 fieldX = 0; fieldX < fieldWidth; fieldX++) {
+            // average the oversampled distances that fall into this texel.
+            double distance = 0.0;
+
+            for (Uint32 y = fieldY * oversample; y < (fieldY + 1) * oversample; y++) {
+                for (Uint32 x = fieldX * oversample; x < (fieldX + 1) * oversample; x++) {
+                    Uint32 index = y * gridWidth + x;
+
+                    // the edge runs between texel centers, half a texel away from either side.
+                    if (outside[index] > 0.0)
+                        distance += std::sqrt(outside[index]) - 0.5;
+                    else
+                        distance -= std::sqrt(inside[index]) - 0.5;
+                }
+            }
+
+            distance /= static_cast<double>(oversample) * oversample * oversample;
+
+            double value = 0.5 - distance / (2.0 * spread);
+
+            field[fieldY * fieldWidth + fieldX] = static_cast<Uint8>(std::clamp(value, 0.0, 1.0) * 255.0 + 0.5);
+        }
+    }
+
+    return field;
+}
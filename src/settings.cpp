@@ -18,9 +18,25 @@ Settings::Settings(const string_view fileName) {
     IgnoreRenderResolution = GetValue("video.IgnoreRenderResolution", false);
     FieldOfView = GetValue("video.FieldOfView", FIELDOFVIEW);
     CameraNear = GetValue("video.CameraNear", CAMERA_NEAR);
+    PipelineCachePath = GetValue<std::string>("video.PipelineCachePath", "pipeline_cache.bin");
+    MeshCacheDirectory = GetValue<std::string>("video.MeshCacheDirectory", "mesh_cache");
+    QuantizeVertices = GetValue("video.QuantizeVertices", false);
+    StreamingBudget = GetValue("video.StreamingBudget", 4.0f);
+    RecordingThreads = GetValue("video.RecordingThreads", 0); // 0 = one per core
+    SDFText = GetValue("video.SDFText", false);
+    BindlessTextures = GetValue("video.BindlessTextures", false);
+
+    Headless = GetValue("headless.Enabled", false);
+    HeadlessFrameCount = GetValue("headless.FrameCount", 0);
+    CaptureDirectory = GetValue<std::string>("headless.CaptureDirectory", "");
+    CaptureFormat = GetValue<std::string>("headless.CaptureFormat", "png");
 
     ReportFPS = GetValue("profile.ReportFPS", true);
     Verbose = GetValue("profile.Verbose", true);
+    ProfileGPU = GetValue("profile.GPU", false);
+    PipelineStatistics = GetValue("profile.PipelineStatistics", false);
+    ProfilerOverlay = GetValue("profile.Overlay", false);
+    ProfilerOverlayFont = GetValue<std::string>("profile.OverlayFont", "NotoSans-Black.ttf");
 
     MouseSensitivity = GetValue("input.MouseSensitivity", 0.1f);
     Velocity = GetValue("input.Velocity", 5.0f);
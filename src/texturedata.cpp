@@ -0,0 +1,290 @@
+#include "texturedata.hpp"
+#include "error.hpp"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+/* Linear values are quantized to this many steps on the way back to sRGB, plenty for 8-bit output. */
+#define SRGB_ENCODE_STEPS 4096
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+#define DDS_FLAG_MIPMAPCOUNT 0x20000
+#define DDS_PIXELFORMAT_FOURCC 0x4
+
+#define FOURCC(a, b, c, d) (static_cast<Uint32>(a) | (static_cast<Uint32>(b) << 8) | (static_cast<Uint32>(c) << 16) | (static_cast<Uint32>(d) << 24))
+
+// only the DXGI formats we can upload as they are.
+enum DXGIFormat : Uint32 {
+    DXGI_FORMAT_BC1_UNORM = 71,
+    DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+    DXGI_FORMAT_BC3_UNORM = 77,
+    DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+    DXGI_FORMAT_BC7_UNORM = 98,
+    DXGI_FORMAT_BC7_UNORM_SRGB = 99
+};
+
+struct DDSPixelFormat {
+    Uint32 size;
+    Uint32 flags;
+    Uint32 fourCC;
+    Uint32 rgbBitCount;
+    Uint32 rBitMask;
+    Uint32 gBitMask;
+    Uint32 bBitMask;
+    Uint32 aBitMask;
+};
+
+struct DDSHeader {
+    Uint32 size;
+    Uint32 flags;
+    Uint32 height;
+    Uint32 width;
+    Uint32 pitchOrLinearSize;
+    Uint32 depth;
+    Uint32 mipMapCount;
+    Uint32 reserved1[11];
+    DDSPixelFormat pixelFormat;
+    Uint32 caps;
+    Uint32 caps2;
+    Uint32 caps3;
+    Uint32 caps4;
+    Uint32 reserved2;
+};
+
+struct DDSHeaderDX10 {
+    Uint32 dxgiFormat;
+    Uint32 resourceDimension;
+    Uint32 miscFlag;
+    Uint32 arraySize;
+    Uint32 miscFlags2;
+};
+
+static float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSRGB(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+Uint32 getMipLevelCount(Uint32 width, Uint32 height) {
+    Uint32 levelCount = 1;
+
+    while (width > 1 || height > 1) {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+
+        levelCount++;
+    }
+
+    return levelCount;
+}
+
+TextureData makeRGBA8TextureData(const Uint8 *pixels, Uint32 width, Uint32 height, VkFormat format) {
+    TextureData texture;
+    texture.format = format;
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+
+    texture.data.assign(pixels, pixels + size);
+    texture.levels.push_back({0, size, width, height});
+
+    return texture;
+}
+
+void generateMipChain(TextureData &texture) {
+    bool isSRGB = texture.format == VK_FORMAT_R8G8B8A8_SRGB;
+
+    // decoding is a lookup, encoding goes through a quantized table instead of a pow per texel.
+    static const std::array<float, 256> decodeTable = [] {
+        std::array<float, 256> table;
+
+        for (Uint32 i = 0; i < table.size(); i++)
+            table[i] = srgbToLinear(i / 255.0f);
+
+        return table;
+    }();
+
+    static const std::array<Uint8, SRGB_ENCODE_STEPS> encodeTable = [] {
+        std::array<Uint8, SRGB_ENCODE_STEPS> table;
+
+        for (Uint32 i = 0; i < table.size(); i++)
+            table[i] = static_cast<Uint8>(linearToSRGB(i / static_cast<float>(SRGB_ENCODE_STEPS - 1)) * 255.0f + 0.5f);
+
+        return table;
+    }();
+
+    TextureLevel baseLevel = texture.levels[0];
+
+    texture.levels.resize(1);
+    texture.data.resize(baseLevel.size);
+
+    // the whole chain is a bit under a third bigger than the first level.
+    texture.data.reserve(baseLevel.size + baseLevel.size / 3 + 4 * getMipLevelCount(baseLevel.width, baseLevel.height));
+
+    while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+        TextureLevel source = texture.levels.back();
+
+        TextureLevel level;
+        level.width = std::max(source.width / 2, 1u);
+        level.height = std::max(source.height / 2, 1u);
+        level.offset = texture.data.size();
+        level.size = static_cast<VkDeviceSize>(level.width) * level.height * 4;
+
+        texture.data.resize(level.offset + level.size);
+
+        const Uint8 *sourcePixels = texture.data.data() + source.offset;
+        Uint8 *pixels = texture.data.data() + level.offset;
+
+        for (Uint32 y = 0; y < level.height; y++) {
+            // odd sizes just clamp, the last row or column gets counted twice.
+            Uint32 y0 = std::min(y * 2, source.height - 1);
+            Uint32 y1 = std::min(y * 2 + 1, source.height - 1);
+
+            for (Uint32 x = 0; x < level.width; x++) {
+                Uint32 x0 = std::min(x * 2, source.width - 1);
+                Uint32 x1 = std::min(x * 2 + 1, source.width - 1);
+
+                const Uint8 *samples[4] = {
+                    sourcePixels + (y0 * source.width + x0) * 4,
+                    sourcePixels + (y0 * source.width + x1) * 4,
+                    sourcePixels + (y1 * source.width + x0) * 4,
+                    sourcePixels + (y1 * source.width + x1) * 4
+                };
+
+                Uint8 *pixel = pixels + (y * level.width + x) * 4;
+
+                for (Uint32 channel = 0; channel < 4; channel++) {
+                    // alpha is always linear.
+                    if (isSRGB && channel < 3) {
+                        float sum = 0.0f;
+
+                        for (const Uint8 *sample : samples)
+                            sum += decodeTable[sample[channel]];
+
+                        pixel[channel] = encodeTable[static_cast<Uint32>(sum * 0.25f * (SRGB_ENCODE_STEPS - 1) + 0.5f)];
+                    } else {
+                        Uint32 sum = 0;
+
+                        for (const Uint8 *sample : samples)
+                            sum += sample[channel];
+
+                        pixel[channel] = static_cast<Uint8>((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+
+        texture.levels.push_back(level);
+    }
+}
+
+TextureData loadDDS(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+    if (!file.is_open())
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "can't open file", path));
+
+    std::streamsize fileSize = file.tellg();
+    file.seekg(0);
+
+    Uint32 magic = 0;
+    DDSHeader header{};
+
+    if (!file.read(reinterpret_cast<char *>(&magic), sizeof(magic)) || magic != DDS_MAGIC)
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "not a DDS file", path));
+
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.size != sizeof(DDSHeader))
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "broken DDS header", path));
+
+    if (header.width == 0 || header.height == 0)
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "zero-sized DDS", path));
+
+    if (!(header.pixelFormat.flags & DDS_PIXELFORMAT_FOURCC))
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "uncompressed DDS files aren't supported", path));
+
+    TextureData texture;
+    VkDeviceSize blockSize;
+
+    switch (header.pixelFormat.fourCC) {
+        case FOURCC('D', 'X', 'T', '1'):
+            texture.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            blockSize = 8;
+            break;
+        case FOURCC('D', 'X', 'T', '5'):
+            texture.format = VK_FORMAT_BC3_SRGB_BLOCK;
+            blockSize = 16;
+            break;
+        case FOURCC('D', 'X', '1', '0'): {
+            DDSHeaderDX10 headerDX10{};
+
+            if (!file.read(reinterpret_cast<char *>(&headerDX10), sizeof(headerDX10)))
+                throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "broken DX10 header", path));
+
+            switch (headerDX10.dxgiFormat) {
+                case DXGI_FORMAT_BC1_UNORM:
+                    texture.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+                    blockSize = 8;
+                    break;
+                case DXGI_FORMAT_BC1_UNORM_SRGB:
+                    texture.format = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+                    blockSize = 8;
+                    break;
+                case DXGI_FORMAT_BC3_UNORM:
+                    texture.format = VK_FORMAT_BC3_UNORM_BLOCK;
+                    blockSize = 16;
+                    break;
+                case DXGI_FORMAT_BC3_UNORM_SRGB:
+                    texture.format = VK_FORMAT_BC3_SRGB_BLOCK;
+                    blockSize = 16;
+                    break;
+                case DXGI_FORMAT_BC7_UNORM:
+                    texture.format = VK_FORMAT_BC7_UNORM_BLOCK;
+                    blockSize = 16;
+                    break;
+                case DXGI_FORMAT_BC7_UNORM_SRGB:
+                    texture.format = VK_FORMAT_BC7_SRGB_BLOCK;
+                    blockSize = 16;
+                    break;
+                default:
+                    throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, fmt::format("unsupported DXGI format {}", headerDX10.dxgiFormat), path));
+            }
+
+            break;
+        }
+        default:
+            throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "unsupported DDS compression", path));
+    }
+
+    Uint32 levelCount = (header.flags & DDS_FLAG_MIPMAPCOUNT) ? std::max(header.mipMapCount, 1u) : 1;
+    levelCount = std::min(levelCount, getMipLevelCount(header.width, header.height));
+
+    Uint32 width = header.width;
+    Uint32 height = header.height;
+    VkDeviceSize offset = 0;
+
+    // blocks are 4x4 texels, levels smaller than that still take up a whole block.
+    for (Uint32 i = 0; i < levelCount; i++) {
+        VkDeviceSize size = std::max<VkDeviceSize>((width + 3) / 4, 1) * std::max<VkDeviceSize>((height + 3) / 4, 1) * blockSize;
+
+        texture.levels.push_back({offset, size, width, height});
+
+        offset += size;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+
+    // anything after the first surface (array layers, cubemap faces) is ignored.
+    if (static_cast<std::streamsize>(file.tellg()) + static_cast<std::streamsize>(offset) > fileSize)
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_LOADING_FAILURE, "file is truncated", path));
+
+    texture.data.resize(offset);
+    file.read(reinterpret_cast<char *>(texture.data.data()), offset);
+
+    return texture;
+}
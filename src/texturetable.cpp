@@ -0,0 +1,122 @@
+#include "texturetable.hpp"
+#include "error.hpp"
+
+#include "fmt/format.h"
+
+#include <stdexcept>
+#include <vulkan/vk_enum_string_helper.h>
+
+TextureTable::TextureTable(VkDevice device, Uint32 capacity, Uint32 frameCount)
+    : m_Device(device), m_Capacity(capacity), m_FrameCount(frameCount) {
+
+    VkDescriptorSetLayoutBinding texturesBinding{};
+    texturesBinding.binding = 0;
+    texturesBinding.descriptorCount = m_Capacity;
+    texturesBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    texturesBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    texturesBinding.pImmutableSamplers = nullptr;
+
+    // empty slots are never sampled, and slots change while frames that don't use them are in flight.
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsCreateInfo.bindingCount = 1;
+    bindingFlagsCreateInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutCreateInfo.bindingCount = 1;
+    layoutCreateInfo.pBindings = &texturesBinding;
+
+    if (vkCreateDescriptorSetLayout(m_Device, &layoutCreateInfo, NULL, &m_Layout) != VK_SUCCESS)
+        throw std::runtime_error(engineError::DESCRIPTOR_SET_LAYOUT_CREATION_FAILURE);
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = m_Capacity;
+
+    VkDescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+
+    if (vkCreateDescriptorPool(m_Device, &poolCreateInfo, NULL, &m_Pool) != VK_SUCCESS)
+        throw std::runtime_error(engineError::DESCRIPTOR_POOL_CREATION_FAILURE);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_Pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_Layout;
+
+    VkResult result = vkAllocateDescriptorSets(m_Device, &allocInfo, &m_DescriptorSet);
+
+    if (result != VK_SUCCESS)
+        throw std::runtime_error(fmt::format(engineError::DESCRIPTOR_SET_ALLOCATION_FAILURE, string_VkResult(result)));
+}
+
+TextureTable::~TextureTable() {
+    // the set goes away with its pool.
+    if (m_Pool)
+        vkDestroyDescriptorPool(m_Device, m_Pool, NULL);
+
+    if (m_Layout)
+        vkDestroyDescriptorSetLayout(m_Device, m_Layout, NULL);
+}
+
+Uint32 TextureTable::Add(VkImageView imageView, VkSampler sampler) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Uint32 index;
+
+    if (!m_FreeIndices.empty()) {
+        index = m_FreeIndices.back();
+        m_FreeIndices.pop_back();
+    } else if (m_NextIndex < m_Capacity) {
+        index = m_NextIndex++;
+    } else {
+        throw std::runtime_error(fmt::format(engineError::TEXTURE_TABLE_FULL, m_Capacity));
+    }
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = imageView;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = m_DescriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(m_Device, 1, &descriptorWrite, 0, nullptr);
+
+    return index;
+}
+
+void TextureTable::Remove(Uint32 index) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // the descriptor is left as it is, nothing draws with this index anymore.
+    m_RetiredIndices.emplace_back(index, m_FrameNumber);
+}
+
+void TextureTable::BeginFrame(Uint64 frameNumber) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    m_FrameNumber = frameNumber;
+
+    // the frame it was removed in (and every one before it) has finished.
+    while (!m_RetiredIndices.empty() && m_RetiredIndices.front().second + m_FrameCount <= frameNumber) {
+        m_FreeIndices.push_back(m_RetiredIndices.front().first);
+        m_RetiredIndices.pop_front();
+    }
+}
@@ -0,0 +1,114 @@
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(Uint32 threadCount) {
+    for (Uint32 i = 1; i < threadCount; i++)
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Quit = true;
+    }
+
+    m_WorkAvailable.notify_all();
+
+    for (std::thread &worker : m_Workers)
+        worker.join();
+}
+
+void ThreadPool::Dispatch(Uint32 taskCount, const ThreadPoolTask &task) {
+    if (taskCount == 0)
+        return;
+
+    // not worth waking anyone up.
+    if (m_Workers.empty() || taskCount == 1) {
+        for (Uint32 i = 0; i < taskCount; i++)
+            task(0, i);
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_Task = &task;
+        m_TaskCount = taskCount;
+        m_NextTask = 0;
+        m_Exception = nullptr;
+        m_Generation++;
+    }
+
+    m_WorkAvailable.notify_all();
+
+    RunTasks(0, task, taskCount);
+
+    std::exception_ptr exception;
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        // there's nothing left to pick up, whoever's still active is finishing a task.
+        m_WorkDone.wait(lock, [this]{ return m_ActiveWorkers == 0; });
+
+        // workers that wake up late see an empty batch.
+        m_Task = nullptr;
+        m_TaskCount = 0;
+
+        exception = m_Exception;
+        m_Exception = nullptr;
+    }
+
+    if (exception)
+        std::rethrow_exception(exception);
+}
+
+void ThreadPool::WorkerLoop(Uint32 threadIndex) {
+    Uint64 lastGeneration = 0;
+
+    while (true) {
+        const ThreadPoolTask *task;
+        Uint32 taskCount;
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+
+            m_WorkAvailable.wait(lock, [&]{ return m_Quit || m_Generation != lastGeneration; });
+
+            if (m_Quit)
+                return;
+
+            lastGeneration = m_Generation;
+
+            task = m_Task;
+            taskCount = m_TaskCount;
+
+            m_ActiveWorkers++;
+        }
+
+        if (task)
+            RunTasks(threadIndex, *task, taskCount);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (--m_ActiveWorkers == 0)
+                m_WorkDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::RunTasks(Uint32 threadIndex, const ThreadPoolTask &task, Uint32 taskCount) {
+    Uint32 taskIndex;
+
+    while ((taskIndex = m_NextTask.fetch_add(1)) < taskCount) {
+        try {
+            task(threadIndex, taskIndex);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (!m_Exception)
+                m_Exception = std::current_exception();
+        }
+    }
+}
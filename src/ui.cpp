@@ -17,6 +17,8 @@
 
 using namespace UI;
 
+static Uint64 layoutGeneration = 0;
+
 Panel::~Panel() {
     DestroyBuffers();
 };
@@ -26,9 +28,8 @@ Panel::Panel(EngineSharedContext &sharedContext, glm::vec3 color, glm::vec2 posi
 
     genericType = SCALABLE;
     type = PANEL;
-        
-    texture = CreateSinglePixelImage(sharedContext, color);
-    
+
+    SetColor(color);
     SetPosition(position);
     SetScale(scales);
     SetDepth(zDepth);
@@ -38,14 +39,28 @@ inline void Panel::SetPosition(glm::vec2 position) {
     m_Position = position;
     m_Dimensions.x = position.x;
     m_Dimensions.y = position.y;
+
+    MarkLayoutDirty();
 }
 
 inline void Panel::SetScale(glm::vec2 scales) {
     m_Dimensions.z = scales.x;
     m_Dimensions.w = scales.y;
+
+    MarkLayoutDirty();
 }
 
 glm::vec4 Panel::GetDimensions() {
+    if (m_ValidLayout & LAYOUT_DIMENSIONS)
+        return m_CachedDimensions;
+
+    m_CachedDimensions = CalculateDimensions();
+    m_ValidLayout |= LAYOUT_DIMENSIONS;
+
+    return m_CachedDimensions;
+}
+
+glm::vec4 Panel::CalculateDimensions() {
     if (m_Parent) {
         glm::vec2 parentPosition = m_Parent->GetPosition();
         glm::vec2 parentScale = (m_Parent->genericType == SCALABLE ? reinterpret_cast<Scalable *>(m_Parent)->GetUnfitScale() : glm::vec4(1.0f));
@@ -85,13 +100,29 @@ glm::vec2 Panel::GetScale() {
     return glm::vec2(dimensions.z, dimensions.w);
 }
 
+void Panel::SetColor(glm::vec3 color) {
+    m_Color = color;
+
+    // the color lives in the renderer's UI instances too.
+    MarkLayoutDirty();
+}
+
+glm::vec3 Panel::GetColor() {
+    return m_Color;
+}
+
 glm::vec2 Panel::GetUnfitScale() {
-    return glm::vec2(m_Dimensions.z, m_Dimensions.w) * (m_Parent != nullptr && m_Parent->genericType == SCALABLE ? reinterpret_cast<Scalable *>(m_Parent)->GetUnfitScale() : glm::vec3(1));
+    if (m_ValidLayout & LAYOUT_UNFIT_SCALE)
+        return m_CachedUnfitScale;
+
+    m_CachedUnfitScale = glm::vec2(m_Dimensions.z, m_Dimensions.w) * (m_Parent != nullptr && m_Parent->genericType == SCALABLE ? reinterpret_cast<Scalable *>(m_Parent)->GetUnfitScale() : glm::vec3(1));
+    m_ValidLayout |= LAYOUT_UNFIT_SCALE;
+
+    return m_CachedUnfitScale;
 }
 
 void Panel::DestroyBuffers() {
-    vkDestroyImage(m_SharedContext.engineDevice, texture.imageAndMemory.image, NULL);
-    vkFreeMemory(m_SharedContext.engineDevice, texture.imageAndMemory.memory, NULL);
+    /* A panel is just an instance in the renderer's UI instance buffer, it has nothing of its own on the GPU. */
 }
 
 Label::~Label() {
@@ -113,23 +144,26 @@ Label::Label(EngineSharedContext &sharedContext, std::string text, std::filesyst
 void Label::InitGlyphs(std::string text, std::filesystem::path fontPath) {
     Glyphs.clear();
 
-    if (FT_Init_FreeType(&m_FTLibrary)) {
-        throw std::runtime_error("Failed to initialize FreeType!");
-    }
+    /* Only a new font has to go through the FontManager, SetText keeps using the one we have. */
+    if (m_Font == INVALID_FONT_HANDLE || fontPath != m_FontPath) {
+        FontHandle font = m_SharedContext.fontManager->Acquire(fontPath, PIXEL_HEIGHT);
 
-    if (FT_New_Face(m_FTLibrary, fontPath.c_str(), 0, &m_FTFace)) {
-        throw std::runtime_error(fmt::format("Failed to locate the requested font ({}) in your system!", fontPath.string()));
+        if (m_Font != INVALID_FONT_HANDLE)
+            m_SharedContext.fontManager->Release(m_Font);
+
+        m_Font = font;
     }
 
-    FT_Set_Pixel_Sizes(m_FTFace, 0, PIXEL_HEIGHT);
+    // everything that isn't cached yet gets rasterized in one batch.
+    m_SharedContext.engine->PrepareGlyphs(m_Font, text);
 
     float x = 0.0f;
     float y = 0.0f;
 
     for (char c : text) {
-        Glyph glyph = m_SharedContext.engine->GenerateGlyph(m_SharedContext, m_FTFace, c, x, y, m_Depth);
+        Glyph glyph = m_SharedContext.engine->GenerateGlyph(m_Font, c, x, y);
 
-        if (!glyph.glyphBuffer.has_value()) {
+        if (!glyph.atlasRegion.has_value()) {
             continue;
         }
 
@@ -139,6 +173,9 @@ void Label::InitGlyphs(std::string text, std::filesystem::path fontPath) {
     m_Text = text;
     m_FontPath = fontPath;
 
+    // anything fitting itself around this label has to be laid out again.
+    MarkLayoutDirty();
+
     /* It should return true if this label was added to the Renderer */
     if (m_SharedContext.engine->RemoveUILabel(this)) {
         m_SharedContext.engine->AddUILabel(this);
@@ -167,18 +204,15 @@ glm::vec2 Label::CalculateMinimumScaleToFit() {
 void Label::DestroyBuffers() {
     // vkDeviceWaitIdle(m_SharedContext.engineDevice);
 
-    /* As of now, Glyph Buffers are now owned by the engine. */
-    // for (size_t i = 0; i < Glyphs.size(); i++) {
-    //     auto glyphBuffer = Glyphs[i].glyphBuffers.value();
+    /* Glyph bitmaps live in the engine's glyph atlas, there's nothing to free here. */
 
-    //     vkDestroyImage(m_SharedContext.engineDevice, glyphBuffer.first.imageAndMemory.image, NULL);
-    //     vkFreeMemory(m_SharedContext.engineDevice, glyphBuffer.first.imageAndMemory.memory, NULL);
+    Glyphs.clear();
 
-    //     vkDestroyBuffer(m_SharedContext.engineDevice, glyphBuffer.second.buffer, NULL);
-    //     vkFreeMemory(m_SharedContext.engineDevice, glyphBuffer.second.memory, NULL);
-    // }
+    if (m_Font != INVALID_FONT_HANDLE) {
+        m_SharedContext.fontManager->Release(m_Font);
 
-    Glyphs.clear();
+        m_Font = INVALID_FONT_HANDLE;
+    }
 }
 
 Arrows::Arrows(Object &highlightedModel) {
@@ -204,17 +238,25 @@ Button::Button(glm::vec2 position, glm::vec2 scale, Panel *panel, Label *label)
 }
 
 inline glm::vec2 GenericElement::GetPosition() {
+    if (m_ValidLayout & LAYOUT_POSITION)
+        return m_CachedPosition;
+
     glm::vec2 position = m_Position + (m_Parent == nullptr ? glm::vec2(0.0f, 0.0f) : m_Parent->GetPosition());
 
     if (genericType == SCALABLE && m_Parent != nullptr && m_Parent->genericType == SCALABLE) {
         position *= reinterpret_cast<Scalable *>(m_Parent)->GetUnfitScale();
     }
 
+    m_CachedPosition = position;
+    m_ValidLayout |= LAYOUT_POSITION;
+
     return position;
 }
 
 inline void GenericElement::SetPosition(glm::vec2 Position) {
     m_Position = Position;
+
+    MarkLayoutDirty();
 }
 
 inline float GenericElement::GetDepth() {
@@ -223,19 +265,35 @@ inline float GenericElement::GetDepth() {
 
 inline void GenericElement::SetVisible(bool visible) {
     m_Visible = visible;
+
+    MarkLayoutDirty();
 }
 
 inline bool GenericElement::GetVisible() {
-    return m_Visible && (m_Parent ? m_Parent->GetVisible() : true);
+    if (m_ValidLayout & LAYOUT_VISIBLE)
+        return m_CachedVisible;
+
+    m_CachedVisible = m_Visible && (m_Parent ? m_Parent->GetVisible() : true);
+    m_ValidLayout |= LAYOUT_VISIBLE;
+
+    return m_CachedVisible;
 }
 
 inline void GenericElement::SetDepth(float depth) {
     m_Depth = depth*0.9f;   // 0.9f to avoid conflicting with the upscaled image which has a depth of 1.0
+
+    MarkLayoutDirty();
 }
 
 inline void GenericElement::SetParent(GenericElement *parent) {
+    // the old parent might've been fitting itself around us.
+    if (m_Parent)
+        m_Parent->MarkLayoutDirty();
+
     m_Parent = parent;
 
+    MarkLayoutDirty();
+
     if (parent == nullptr) {
         return;
     }
@@ -253,6 +311,8 @@ inline GenericElement *GenericElement::GetParent() {
 
 inline void GenericElement::AddChild(GenericElement *element) {
     m_Children.push_back(element);
+
+    MarkLayoutDirty();
 }
 
 inline void GenericElement::RemoveChild(GenericElement *child) {
@@ -263,6 +323,8 @@ inline void GenericElement::RemoveChild(GenericElement *child) {
 
         m_Children.erase(std::find(m_Children.begin(), m_Children.end(), child));
     }
+
+    MarkLayoutDirty();
 }
 
 inline std::vector<GenericElement *> GenericElement::GetChildren() {
@@ -273,6 +335,27 @@ inline void GenericElement::DestroyBuffers() {
     throw std::runtime_error("You're calling DestroyBuffers on a GenericElement, this is wrong.");
 }
 
+void GenericElement::MarkLayoutDirty() {
+    InvalidateSubtree();
+
+    // parents only need their own layout redone, their other children don't depend on us.
+    for (GenericElement *element = m_Parent; element; element = element->m_Parent)
+        element->m_ValidLayout = 0;
+
+    layoutGeneration++;
+}
+
+Uint64 GenericElement::GetLayoutGeneration() {
+    return layoutGeneration;
+}
+
+void GenericElement::InvalidateSubtree() {
+    m_ValidLayout = 0;
+
+    for (GenericElement *child : m_Children)
+        child->InvalidateSubtree();
+}
+
 Scalable::Scalable() {
     type = SCALABLE;
     genericType = SCALABLE;
@@ -280,23 +363,37 @@ Scalable::Scalable() {
 
 inline void Scalable::SetScale(glm::vec2 scales) {
     m_Scale = scales;
+
+    MarkLayoutDirty();
 }
 
 inline glm::vec2 Scalable::GetScale() {
+    if (m_ValidLayout & LAYOUT_SCALE)
+        return m_CachedScale;
+
     glm::vec2 scale = m_Scale * (m_Parent != nullptr && m_Parent->genericType == SCALABLE ? reinterpret_cast<Scalable *>(m_Parent)->GetUnfitScale() : glm::vec3(1));
 
     scale = adjustScaleToFitType(this, scale);
 
+    m_CachedScale = scale;
+    m_ValidLayout |= LAYOUT_SCALE;
+
     return scale;
 }
 
 inline glm::vec2 Scalable::GetUnfitScale() {
+    if (m_ValidLayout & LAYOUT_UNFIT_SCALE)
+        return m_CachedUnfitScale;
+
     glm::vec2 scale = m_Scale * (m_Parent != nullptr && m_Parent->genericType == SCALABLE ? reinterpret_cast<Scalable *>(m_Parent)->GetUnfitScale() : glm::vec3(1));
 
     if (id == "bgPanel") {
         fmt::println("{} {} {} {}", m_Scale.x, m_Scale.y, reinterpret_cast<UI::Scalable *>(m_Parent)->GetUnfitScale().x, reinterpret_cast<UI::Scalable *>(m_Parent)->GetUnfitScale().y);
     }
 
+    m_CachedUnfitScale = scale;
+    m_ValidLayout |= LAYOUT_UNFIT_SCALE;
+
     return scale;
 }
 
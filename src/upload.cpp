@@ -0,0 +1,387 @@
+#include "upload.hpp"
+#include "error.hpp"
+
+#include "fmt/base.h"
+#include "fmt/format.h"
+
+#include <stdexcept>
+#include <vulkan/vk_enum_string_helper.h>
+
+UploadBatcher::UploadBatcher(VkDevice device, MemoryAllocator *allocator, Uint32 graphicsQueueFamily, VkQueue graphicsQueue, Uint32 transferQueueFamily, VkQueue transferQueue)
+    : m_Device(device), m_Allocator(allocator), m_GraphicsQueueFamily(graphicsQueueFamily), m_GraphicsQueue(graphicsQueue), m_TransferQueueFamily(transferQueueFamily), m_TransferQueue(transferQueue) {
+
+    VkCommandPoolCreateInfo commandPoolCreateInfo{};
+    commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = m_TransferQueueFamily;
+
+    if (vkCreateCommandPool(m_Device, &commandPoolCreateInfo, NULL, &m_TransferCommandPool) != VK_SUCCESS)
+        throw std::runtime_error(engineError::COMMAND_POOL_CREATION_FAILURE);
+
+    if (HasDedicatedTransferQueue()) {
+        commandPoolCreateInfo.queueFamilyIndex = m_GraphicsQueueFamily;
+
+        if (vkCreateCommandPool(m_Device, &commandPoolCreateInfo, NULL, &m_GraphicsCommandPool) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_POOL_CREATION_FAILURE);
+    }
+}
+
+UploadBatcher::~UploadBatcher() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    /* Whatever wasn't submitted yet never will be. */
+    if (m_IsRecording) {
+        vkEndCommandBuffer(m_RecordingBatch.transferCommandBuffer);
+        RetireBatch(m_RecordingBatch);
+
+        m_IsRecording = false;
+    }
+
+    for (UploadBatch &batch : m_InFlightBatches) {
+        vkWaitForFences(m_Device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        RetireBatch(batch);
+    }
+    m_InFlightBatches.clear();
+
+    if (m_TransferCommandPool)
+        vkDestroyCommandPool(m_Device, m_TransferCommandPool, NULL);
+    if (m_GraphicsCommandPool)
+        vkDestroyCommandPool(m_Device, m_GraphicsCommandPool, NULL);
+}
+
+UploadBatch &UploadBatcher::GetRecordingBatch() {
+    if (m_IsRecording)
+        return m_RecordingBatch;
+
+    m_RecordingBatch = UploadBatch{};
+    m_RecordingBatch.token = m_NextToken;
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = m_TransferCommandPool;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(m_Device, &allocInfo, &m_RecordingBatch.transferCommandBuffer) != VK_SUCCESS)
+        throw std::runtime_error(engineError::COMMAND_BUFFER_ALLOCATION_FAILURE);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(m_RecordingBatch.transferCommandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error(engineError::COMMAND_BUFFER_BEGIN_FAILURE);
+
+    m_IsRecording = true;
+
+    return m_RecordingBatch;
+}
+
+std::pair<VkBuffer, MemoryAllocation> UploadBatcher::CreateStagingBuffer(const void *data, VkDeviceSize size) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer stagingBuffer;
+    if (vkCreateBuffer(m_Device, &bufferInfo, NULL, &stagingBuffer) != VK_SUCCESS)
+        throw std::runtime_error(engineError::CANT_CREATE_VERTEX_BUFFER);
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(m_Device, stagingBuffer, &memoryRequirements);
+
+    MemoryAllocation stagingMemory = m_Allocator->Allocate(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    vkBindBufferMemory(m_Device, stagingBuffer, stagingMemory.deviceMemory, stagingMemory.offset);
+
+    SDL_memcpy(stagingMemory.mappedData, data, size);
+
+    return {stagingBuffer, stagingMemory};
+}
+
+UploadToken UploadBatcher::UploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkAccessFlags dstAccessMask, VkPipelineStageFlags dstStageMask, VkDeviceSize dstOffset) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    UploadBatch &batch = GetRecordingBatch();
+
+    batch.stagingBuffers.push_back(CreateStagingBuffer(data, size));
+
+    VkBufferCopy bufferCopy{};
+    bufferCopy.srcOffset = 0;
+    bufferCopy.dstOffset = dstOffset;
+    bufferCopy.size = size;
+
+    vkCmdCopyBuffer(batch.transferCommandBuffer, batch.stagingBuffers.back().first, dstBuffer, 1, &bufferCopy);
+
+    VkBufferMemoryBarrier bufferBarrier{};
+    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask = dstAccessMask;
+    bufferBarrier.srcQueueFamilyIndex = HasDedicatedTransferQueue() ? m_TransferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = HasDedicatedTransferQueue() ? m_GraphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = dstBuffer;
+    bufferBarrier.offset = dstOffset;
+    bufferBarrier.size = size;
+
+    batch.bufferBarriers.push_back(bufferBarrier);
+    batch.dstStageMask |= dstStageMask;
+
+    return batch.token;
+}
+
+UploadToken UploadBatcher::UploadImage(VkImage dstImage, const void *data, VkDeviceSize size, Uint32 width, Uint32 height) {
+    return UploadImage(dstImage, data, size, {{0, size, width, height}});
+}
+
+UploadToken UploadBatcher::UploadImage(VkImage dstImage, const void *data, VkDeviceSize size, const std::vector<TextureLevel> &levels) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    UploadBatch &batch = GetRecordingBatch();
+
+    batch.stagingBuffers.push_back(CreateStagingBuffer(data, size));
+
+    VkImageMemoryBarrier imageBarrier{};
+    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.srcAccessMask = 0;
+    imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image = dstImage;
+    imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageBarrier.subresourceRange.baseMipLevel = 0;
+    imageBarrier.subresourceRange.levelCount = levels.size();
+    imageBarrier.subresourceRange.baseArrayLayer = 0;
+    imageBarrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    // every level comes out of the same staging buffer in one copy.
+    std::vector<VkBufferImageCopy> bufferImageCopies(levels.size());
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        VkBufferImageCopy &bufferImageCopy = bufferImageCopies[i];
+        bufferImageCopy.bufferOffset = levels[i].offset;
+        bufferImageCopy.bufferRowLength = 0;
+        bufferImageCopy.bufferImageHeight = 0;
+
+        bufferImageCopy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        bufferImageCopy.imageSubresource.baseArrayLayer = 0;
+        bufferImageCopy.imageSubresource.layerCount = 1;
+        bufferImageCopy.imageSubresource.mipLevel = i;
+
+        bufferImageCopy.imageOffset = {0, 0, 0};
+        bufferImageCopy.imageExtent = {levels[i].width, levels[i].height, 1};
+    }
+
+    vkCmdCopyBufferToImage(batch.transferCommandBuffer, batch.stagingBuffers.back().first, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, bufferImageCopies.size(), bufferImageCopies.data());
+
+    /* The transition to SHADER_READ_ONLY happens with the rest of the barriers at submission. */
+    imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier.srcQueueFamilyIndex = HasDedicatedTransferQueue() ? m_TransferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex = HasDedicatedTransferQueue() ? m_GraphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+
+    batch.imageBarriers.push_back(imageBarrier);
+    batch.dstStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    return batch.token;
+}
+
+UploadToken UploadBatcher::GetRecordingToken() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return m_NextToken;
+}
+
+UploadToken UploadBatcher::SubmitRecordingBatch() {
+    UploadToken token = m_NextToken++;
+
+    if (!m_IsRecording) {
+        /* Nothing to wait for, this token is done as soon as everything before it is. */
+        if (m_InFlightBatches.empty())
+            m_CompletedToken = token;
+
+        return token;
+    }
+
+    UploadBatch &batch = m_RecordingBatch;
+
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkCreateFence(m_Device, &fenceCreateInfo, NULL, &batch.fence) != VK_SUCCESS)
+        throw std::runtime_error(engineError::SYNC_OBJECTS_CREATION_FAILURE);
+
+    VkResult queueSubmitResult;
+
+    if (HasDedicatedTransferQueue()) {
+        /* Release on the transfer queue, the dstAccessMask of a release barrier is ignored. */
+        std::vector<VkBufferMemoryBarrier> releaseBufferBarriers = batch.bufferBarriers;
+        std::vector<VkImageMemoryBarrier> releaseImageBarriers = batch.imageBarriers;
+
+        for (VkBufferMemoryBarrier &barrier : releaseBufferBarriers)
+            barrier.dstAccessMask = 0;
+        for (VkImageMemoryBarrier &barrier : releaseImageBarriers)
+            barrier.dstAccessMask = 0;
+
+        vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                0, nullptr,
+                                releaseBufferBarriers.size(), releaseBufferBarriers.data(),
+                                releaseImageBarriers.size(), releaseImageBarriers.data());
+
+        if (vkEndCommandBuffer(batch.transferCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_BUFFER_END_FAILURE);
+
+        /* Acquire on the graphics queue, same deal with srcAccessMask. */
+        for (VkBufferMemoryBarrier &barrier : batch.bufferBarriers)
+            barrier.srcAccessMask = 0;
+        for (VkImageMemoryBarrier &barrier : batch.imageBarriers)
+            barrier.srcAccessMask = 0;
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_GraphicsCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(m_Device, &allocInfo, &batch.graphicsCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_BUFFER_ALLOCATION_FAILURE);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_BUFFER_BEGIN_FAILURE);
+
+        vkCmdPipelineBarrier(batch.graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, batch.dstStageMask, 0,
+                                0, nullptr,
+                                batch.bufferBarriers.size(), batch.bufferBarriers.data(),
+                                batch.imageBarriers.size(), batch.imageBarriers.data());
+
+        if (vkEndCommandBuffer(batch.graphicsCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_BUFFER_END_FAILURE);
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo{};
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        if (vkCreateSemaphore(m_Device, &semaphoreCreateInfo, NULL, &batch.ownershipSemaphore) != VK_SUCCESS)
+            throw std::runtime_error(engineError::SYNC_OBJECTS_CREATION_FAILURE);
+
+        VkSubmitInfo transferSubmitInfo{};
+        transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmitInfo.commandBufferCount = 1;
+        transferSubmitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+        transferSubmitInfo.signalSemaphoreCount = 1;
+        transferSubmitInfo.pSignalSemaphores = &batch.ownershipSemaphore;
+
+        queueSubmitResult = vkQueueSubmit(m_TransferQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE);
+        if (queueSubmitResult != VK_SUCCESS)
+            throw std::runtime_error(fmt::format(engineError::QUEUE_SUBMIT_FAILURE, string_VkResult(queueSubmitResult)));
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+        VkSubmitInfo graphicsSubmitInfo{};
+        graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        graphicsSubmitInfo.waitSemaphoreCount = 1;
+        graphicsSubmitInfo.pWaitSemaphores = &batch.ownershipSemaphore;
+        graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+        graphicsSubmitInfo.commandBufferCount = 1;
+        graphicsSubmitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+        queueSubmitResult = vkQueueSubmit(m_GraphicsQueue, 1, &graphicsSubmitInfo, batch.fence);
+    } else {
+        vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, batch.dstStageMask, 0,
+                                0, nullptr,
+                                batch.bufferBarriers.size(), batch.bufferBarriers.data(),
+                                batch.imageBarriers.size(), batch.imageBarriers.data());
+
+        if (vkEndCommandBuffer(batch.transferCommandBuffer) != VK_SUCCESS)
+            throw std::runtime_error(engineError::COMMAND_BUFFER_END_FAILURE);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+        queueSubmitResult = vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, batch.fence);
+    }
+
+    if (queueSubmitResult != VK_SUCCESS)
+        throw std::runtime_error(fmt::format(engineError::QUEUE_SUBMIT_FAILURE, string_VkResult(queueSubmitResult)));
+
+    m_InFlightBatches.push_back(std::move(batch));
+    m_IsRecording = false;
+
+    return token;
+}
+
+UploadToken UploadBatcher::Submit() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return SubmitRecordingBatch();
+}
+
+void UploadBatcher::RetireBatch(UploadBatch &batch) {
+    for (std::pair<VkBuffer, MemoryAllocation> &stagingBuffer : batch.stagingBuffers) {
+        vkDestroyBuffer(m_Device, stagingBuffer.first, NULL);
+        m_Allocator->Free(stagingBuffer.second);
+    }
+    batch.stagingBuffers.clear();
+
+    if (batch.transferCommandBuffer)
+        vkFreeCommandBuffers(m_Device, m_TransferCommandPool, 1, &batch.transferCommandBuffer);
+    if (batch.graphicsCommandBuffer)
+        vkFreeCommandBuffers(m_Device, m_GraphicsCommandPool, 1, &batch.graphicsCommandBuffer);
+    if (batch.ownershipSemaphore)
+        vkDestroySemaphore(m_Device, batch.ownershipSemaphore, NULL);
+    if (batch.fence)
+        vkDestroyFence(m_Device, batch.fence, NULL);
+
+    batch.transferCommandBuffer = nullptr;
+    batch.graphicsCommandBuffer = nullptr;
+    batch.ownershipSemaphore = nullptr;
+    batch.fence = nullptr;
+}
+
+bool UploadBatcher::IsComplete(UploadToken token) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    return token <= m_CompletedToken;
+}
+
+void UploadBatcher::Wait(UploadToken token) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (token >= m_NextToken)
+        SubmitRecordingBatch();
+
+    while (token > m_CompletedToken && !m_InFlightBatches.empty()) {
+        UploadBatch &batch = m_InFlightBatches.front();
+
+        VkResult waitForFencesResult = vkWaitForFences(m_Device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        if (waitForFencesResult != VK_SUCCESS)
+            throw std::runtime_error(fmt::format(engineError::WAIT_FOR_FENCES_FAILED, string_VkResult(waitForFencesResult)));
+
+        RetireBatch(batch);
+        m_InFlightBatches.pop_front();
+
+        m_CompletedToken = m_InFlightBatches.empty() ? m_NextToken - 1 : m_InFlightBatches.front().token - 1;
+    }
+}
+
+void UploadBatcher::Collect() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    /* Batches finish in submission order, so we can stop at the first one that isn't done. */
+    while (!m_InFlightBatches.empty() && vkGetFenceStatus(m_Device, m_InFlightBatches.front().fence) == VK_SUCCESS) {
+        RetireBatch(m_InFlightBatches.front());
+        m_InFlightBatches.pop_front();
+    }
+
+    m_CompletedToken = m_InFlightBatches.empty() ? m_NextToken - 1 : m_InFlightBatches.front().token - 1;
+}
@@ -297,7 +297,8 @@ struct glTFRigidBody getColliderInfoFromNode(const aiNode *node, const aiScene *
                 shapeSize.Get(1, boxSize.y);
                 shapeSize.Get(2, boxSize.z);
 
-                rigidBody.colliderInfo.shape = createBoxShape(boxSize);
+                rigidBody.colliderInfo.shape = GLTF_COLLIDER_BOX;
+                rigidBody.colliderInfo.boxSize = boxSize;
             }
 
         fmt::println("Shape: {}", shapeType.C_Str());
@@ -341,10 +342,11 @@ struct glTFRigidBody getColliderInfoFromNode(const aiNode *node, const aiScene *
         UTILASSERT(targetNode->mNumMeshes > 0);
         aiMesh *mesh = scene->mMeshes[targetNode->mMeshes[0]];
 
-        btTriangleIndexVertexArray *va = new btTriangleIndexVertexArray();
+        std::vector<Uint32> &indices = rigidBody.colliderInfo.indices;
+        std::vector<glm::vec3> &vertices = rigidBody.colliderInfo.vertices;
 
-        Uint32 *indices = new Uint32[mesh->mNumFaces * 3];
-        glm::vec3 *vertices = new glm::vec3[mesh->mNumVertices];
+        indices.resize(mesh->mNumFaces * 3);
+        vertices.resize(mesh->mNumVertices);
 
         // process indices
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
@@ -360,21 +362,8 @@ struct glTFRigidBody getColliderInfoFromNode(const aiNode *node, const aiScene *
         {
             vertices[i] = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
         }
-        
-        btIndexedMesh indexedMesh;
-        indexedMesh.m_indexType = PHY_INTEGER;
-        indexedMesh.m_numTriangles = mesh->mNumFaces;
-        indexedMesh.m_triangleIndexBase = reinterpret_cast<Uint8 *>(indices);
-        indexedMesh.m_triangleIndexStride = sizeof(int)*3;
 
-        indexedMesh.m_vertexType = PHY_FLOAT;
-        indexedMesh.m_numVertices = mesh->mNumVertices;
-        indexedMesh.m_vertexBase = reinterpret_cast<Uint8 *>(vertices);
-        indexedMesh.m_vertexStride = sizeof(float) * 3;
-
-        va->addIndexedMesh(indexedMesh);
-
-        rigidBody.colliderInfo.shape = new btBvhTriangleMeshShape(va, true);
+        rigidBody.colliderInfo.shape = GLTF_COLLIDER_TRIANGLE_MESH;
     }
 
     /* Physics Material */
@@ -404,3 +393,37 @@ struct glTFRigidBody getColliderInfoFromNode(const aiNode *node, const aiScene *
 
     return rigidBody;
 }
+
+btCollisionShape *createColliderShape(const glTFColliderInfo &colliderInfo) {
+    switch (colliderInfo.shape) {
+        case GLTF_COLLIDER_BOX:
+            return createBoxShape(colliderInfo.boxSize);
+        case GLTF_COLLIDER_TRIANGLE_MESH: {
+            btTriangleIndexVertexArray *va = new btTriangleIndexVertexArray();
+
+            /* bullet doesn't copy these, they have to live as long as the shape does. */
+            Uint32 *indices = new Uint32[colliderInfo.indices.size()];
+            glm::vec3 *vertices = new glm::vec3[colliderInfo.vertices.size()];
+
+            std::copy(colliderInfo.indices.begin(), colliderInfo.indices.end(), indices);
+            std::copy(colliderInfo.vertices.begin(), colliderInfo.vertices.end(), vertices);
+
+            btIndexedMesh indexedMesh;
+            indexedMesh.m_indexType = PHY_INTEGER;
+            indexedMesh.m_numTriangles = colliderInfo.indices.size() / 3;
+            indexedMesh.m_triangleIndexBase = reinterpret_cast<Uint8 *>(indices);
+            indexedMesh.m_triangleIndexStride = sizeof(int)*3;
+
+            indexedMesh.m_vertexType = PHY_FLOAT;
+            indexedMesh.m_numVertices = colliderInfo.vertices.size();
+            indexedMesh.m_vertexBase = reinterpret_cast<Uint8 *>(vertices);
+            indexedMesh.m_vertexStride = sizeof(float) * 3;
+
+            va->addIndexedMesh(indexedMesh);
+
+            return new btBvhTriangleMeshShape(va, true);
+        }
+        default:
+            return nullptr;
+    }
+}